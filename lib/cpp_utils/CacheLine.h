@@ -0,0 +1,17 @@
+/*
+ * CacheLine.h
+ */
+
+#ifndef COMPONENTS_CPP_UTILS_CACHELINE_H_
+#define COMPONENTS_CPP_UTILS_CACHELINE_H_
+
+/**
+ * @brief Size used to keep data written by different cores apart.
+ *
+ * The ESP32 cache line is 32 bytes. Override for other targets (e.g. 64 on a host).
+ */
+#ifndef CPP_UTILS_CACHE_LINE_SIZE
+#define CPP_UTILS_CACHE_LINE_SIZE 32
+#endif
+
+#endif /* COMPONENTS_CPP_UTILS_CACHELINE_H_ */
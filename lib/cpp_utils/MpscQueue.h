@@ -0,0 +1,149 @@
+/*
+ * MpscQueue.h
+ */
+
+#ifndef COMPONENTS_CPP_UTILS_MPSCQUEUE_H_
+#define COMPONENTS_CPP_UTILS_MPSCQUEUE_H_
+#include <atomic>
+#include <cstddef>
+
+#include "CacheLine.h"
+
+/**
+ * @brief Bounded lock-free multi producer / single consumer ring queue.
+ *
+ * Any number of tasks may push concurrently, exactly one task may pop. Each slot
+ * carries a sequence number telling whether it is free, being filled or ready,
+ * so producers only contend on a single compare-and-swap of the enqueue index
+ * (D. Vyukov's bounded queue, reduced to a single consumer).
+ *
+ * Items can be filled in place:
+ *
+ * @code{.cpp}
+ * size_t ticket;
+ * Record* pRecord = queue.beginPush(ticket);
+ * if (pRecord != nullptr) {
+ *    ...
+ *    queue.endPush(ticket);
+ * }
+ * @endcode
+ */
+template <typename T, size_t Capacity>
+class MpscQueue {
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	MpscQueue() : m_enqueuePos(0), m_dequeuePos(0) {
+		for (size_t i = 0; i < Capacity; i++) {
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * @brief Claim the slot for the next item.
+	 *
+	 * @param [out] ticket Identifies the claimed slot, pass it to endPush().
+	 * @return The slot to fill or nullptr if the queue is full.
+	 */
+	T* beginPush(size_t& ticket) {
+		size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+		while (true) {
+			Cell& cell = m_cells[pos & (Capacity - 1)];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			ptrdiff_t dif = (ptrdiff_t)sequence - (ptrdiff_t)pos;
+			if (dif == 0) {
+				if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					ticket = pos;
+					return &cell.data;
+				}
+			} else if (dif < 0) {
+				return nullptr;
+			} else {
+				pos = m_enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	} // beginPush
+
+	/**
+	 * @brief Publish a slot claimed with beginPush() to the consumer.
+	 */
+	void endPush(size_t ticket) {
+		m_cells[ticket & (Capacity - 1)].sequence.store(ticket + 1, std::memory_order_release);
+	} // endPush
+
+	/**
+	 * @brief Copy an item into the queue.
+	 *
+	 * @return False if the queue is full.
+	 */
+	bool push(const T& item) {
+		size_t ticket;
+		T* pSlot = beginPush(ticket);
+		if (pSlot == nullptr) {
+			return false;
+		}
+		*pSlot = item;
+		endPush(ticket);
+		return true;
+	} // push
+
+	/**
+	 * @brief Get the oldest published item without removing it.
+	 *
+	 * Only the consumer may call this.
+	 * @return The oldest item or nullptr if the queue is empty.
+	 */
+	T* front() {
+		Cell& cell = m_cells[m_dequeuePos & (Capacity - 1)];
+		if (cell.sequence.load(std::memory_order_acquire) != m_dequeuePos + 1) {
+			return nullptr;
+		}
+		return &cell.data;
+	} // front
+
+	/**
+	 * @brief Hand the slot returned by front() back to the producers.
+	 */
+	void popFront() {
+		m_cells[m_dequeuePos & (Capacity - 1)].sequence.store(m_dequeuePos + Capacity, std::memory_order_release);
+		m_dequeuePos++;
+	} // popFront
+
+	/**
+	 * @brief Copy the oldest item out of the queue.
+	 *
+	 * @return False if the queue is empty.
+	 */
+	bool pop(T& item) {
+		T* pFront = front();
+		if (pFront == nullptr) {
+			return false;
+		}
+		item = *pFront;
+		popFront();
+		return true;
+	} // pop
+
+	/**
+	 * @brief True if no published item is waiting. Only the consumer may call this.
+	 */
+	bool empty() {
+		return front() == nullptr;
+	} // empty
+
+	static constexpr size_t capacity() {
+		return Capacity;
+	} // capacity
+
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T                   data;
+	};
+
+	alignas(CPP_UTILS_CACHE_LINE_SIZE) std::atomic<size_t> m_enqueuePos;
+	alignas(CPP_UTILS_CACHE_LINE_SIZE) size_t m_dequeuePos;
+	alignas(CPP_UTILS_CACHE_LINE_SIZE) Cell m_cells[Capacity];
+};
+
+#endif /* COMPONENTS_CPP_UTILS_MPSCQUEUE_H_ */
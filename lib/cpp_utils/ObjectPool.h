@@ -0,0 +1,80 @@
+/*
+ * ObjectPool.h
+ */
+
+#ifndef COMPONENTS_CPP_UTILS_OBJECTPOOL_H_
+#define COMPONENTS_CPP_UTILS_OBJECTPOOL_H_
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "CacheLine.h"
+
+/**
+ * @brief Fixed capacity pool of statically allocated objects.
+ *
+ * acquire() and release() are lock-free and may be called from any task. The
+ * free slots are tracked in a single 32 bit mask, so the capacity is limited
+ * to 32 objects. Objects are not constructed or destroyed by the pool; the
+ * caller initialises an object after acquiring it.
+ */
+template <typename T, size_t Capacity>
+class ObjectPool {
+	static_assert(Capacity > 0 && Capacity <= 32, "Capacity must be between 1 and 32");
+
+public:
+	ObjectPool() : m_used(0) {}
+
+	/**
+	 * @brief Take an object out of the pool.
+	 *
+	 * @return The object or nullptr if all objects are in use.
+	 */
+	T* acquire() {
+		uint32_t used = m_used.load(std::memory_order_relaxed);
+		while (true) {
+			uint32_t available = ~used & allMask();
+			if (available == 0) {
+				return nullptr;
+			}
+			uint32_t bit = available & (~available + 1);  // lowest free slot
+			if (m_used.compare_exchange_weak(used, used | bit, std::memory_order_acquire, std::memory_order_relaxed)) {
+				return &m_items[__builtin_ctz(bit)];
+			}
+		}
+	} // acquire
+
+	/**
+	 * @brief Return an object to the pool.
+	 *
+	 * @param [in] pItem An object returned by acquire() or nullptr.
+	 */
+	void release(T* pItem) {
+		if (pItem == nullptr) {
+			return;
+		}
+		size_t index = pItem - m_items;
+		m_used.fetch_and(~(1UL << index), std::memory_order_release);
+	} // release
+
+	/**
+	 * @brief Number of objects currently available.
+	 */
+	size_t available() const {
+		return Capacity - __builtin_popcount(m_used.load(std::memory_order_relaxed));
+	} // available
+
+	static constexpr size_t capacity() {
+		return Capacity;
+	} // capacity
+
+private:
+	static constexpr uint32_t allMask() {
+		return Capacity == 32 ? 0xffffffffUL : ((1UL << Capacity) - 1);
+	} // allMask
+
+	alignas(CPP_UTILS_CACHE_LINE_SIZE) std::atomic<uint32_t> m_used;
+	T m_items[Capacity];
+};
+
+#endif /* COMPONENTS_CPP_UTILS_OBJECTPOOL_H_ */
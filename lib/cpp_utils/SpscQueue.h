@@ -0,0 +1,149 @@
+/*
+ * SpscQueue.h
+ */
+
+#ifndef COMPONENTS_CPP_UTILS_SPSCQUEUE_H_
+#define COMPONENTS_CPP_UTILS_SPSCQUEUE_H_
+#include <atomic>
+#include <cstddef>
+
+#include "CacheLine.h"
+
+/**
+ * @brief Bounded lock-free single producer / single consumer ring queue.
+ *
+ * Exactly one task may push and exactly one task may pop. Neither side ever
+ * blocks or allocates. Items can be copied in and out with push() and pop(), or
+ * filled and consumed in place:
+ *
+ * @code{.cpp}
+ * SpscQueue<bme680_sensor_data_t, 8> queue;
+ *
+ * // producer
+ * bme680_sensor_data_t* pData = queue.beginPush();
+ * if (pData != nullptr) {
+ *    *pData = bme680_readSensorData();
+ *    queue.endPush();
+ * }
+ *
+ * // consumer
+ * bme680_sensor_data_t* pFront = queue.front();
+ * if (pFront != nullptr) {
+ *    ...
+ *    queue.popFront();
+ * }
+ * @endcode
+ *
+ * The producer and consumer indices live on separate cache lines, and each side
+ * keeps a cached copy of the other side's index so that it only touches the
+ * shared line when the queue looks full or empty.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue {
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	SpscQueue() : m_head(0), m_cachedTail(0), m_tail(0), m_cachedHead(0) {}
+
+	/**
+	 * @brief Get the slot for the next item without publishing it.
+	 *
+	 * @return The slot to fill or nullptr if the queue is full.
+	 */
+	T* beginPush() {
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head - m_cachedTail >= Capacity) {
+			m_cachedTail = m_tail.load(std::memory_order_acquire);
+			if (head - m_cachedTail >= Capacity) {
+				return nullptr;
+			}
+		}
+		return &m_items[head & (Capacity - 1)];
+	} // beginPush
+
+	/**
+	 * @brief Publish the slot returned by beginPush() to the consumer.
+	 */
+	void endPush() {
+		m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	} // endPush
+
+	/**
+	 * @brief Copy an item into the queue.
+	 *
+	 * @return False if the queue is full.
+	 */
+	bool push(const T& item) {
+		T* pSlot = beginPush();
+		if (pSlot == nullptr) {
+			return false;
+		}
+		*pSlot = item;
+		endPush();
+		return true;
+	} // push
+
+	/**
+	 * @brief Get the oldest item without removing it.
+	 *
+	 * @return The oldest item or nullptr if the queue is empty.
+	 */
+	T* front() {
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail == m_cachedHead) {
+			m_cachedHead = m_head.load(std::memory_order_acquire);
+			if (tail == m_cachedHead) {
+				return nullptr;
+			}
+		}
+		return &m_items[tail & (Capacity - 1)];
+	} // front
+
+	/**
+	 * @brief Release the item returned by front() back to the producer.
+	 */
+	void popFront() {
+		m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	} // popFront
+
+	/**
+	 * @brief Copy the oldest item out of the queue.
+	 *
+	 * @return False if the queue is empty.
+	 */
+	bool pop(T& item) {
+		T* pFront = front();
+		if (pFront == nullptr) {
+			return false;
+		}
+		item = *pFront;
+		popFront();
+		return true;
+	} // pop
+
+	/**
+	 * @brief Number of queued items, exact only when called by producer or consumer.
+	 */
+	size_t size() const {
+		return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+	} // size
+
+	bool empty() const {
+		return size() == 0;
+	} // empty
+
+	static constexpr size_t capacity() {
+		return Capacity;
+	} // capacity
+
+private:
+	// producer side
+	alignas(CPP_UTILS_CACHE_LINE_SIZE) std::atomic<size_t> m_head;
+	size_t m_cachedTail;
+	// consumer side
+	alignas(CPP_UTILS_CACHE_LINE_SIZE) std::atomic<size_t> m_tail;
+	size_t m_cachedHead;
+	alignas(CPP_UTILS_CACHE_LINE_SIZE) T m_items[Capacity];
+};
+
+#endif /* COMPONENTS_CPP_UTILS_SPSCQUEUE_H_ */
@@ -6,6 +6,7 @@
  */
 
 
+#include <esp_freertos_hooks.h>
 #include <esp_log.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -16,20 +17,36 @@
 
 static char tag[] = "Task";
 
+static Task*       s_tasks[TASK_MAX_REGISTERED];
+static portMUX_TYPE s_tasksMux = portMUX_INITIALIZER_UNLOCKED;
+// Ticks per core, all of them and those the idle task was running in
+static uint32_t     s_coreTicks[portNUM_PROCESSORS];
+static uint32_t     s_idleTicks[portNUM_PROCESSORS];
+static uint32_t     s_coreTicksSampled[portNUM_PROCESSORS];
+static uint32_t     s_idleTicksSampled[portNUM_PROCESSORS];
+static bool         s_tickHooksRegistered = false;
+
 
 /**
  * @brief Create an instance of the task class.
  *
  * @param [in] taskName The name of the task to create.
  * @param [in] stackSize The size of the stack.
+ * @param [in] priority The priority of the task.
+ * @param [in] coreId The core to pin the task to or tskNO_AFFINITY.
  * @return N/A.
  */
-Task::Task(std::string taskName, uint16_t stackSize, uint8_t priority) {
-	m_taskName  = taskName;
-	m_stackSize = stackSize;
-	m_priority  = priority;
-	m_taskData  = nullptr;
-	m_handle    = nullptr;
+Task::Task(std::string taskName, uint32_t stackSize, uint8_t priority, BaseType_t coreId) {
+	m_taskName    = taskName;
+	m_stackSize   = stackSize;
+	m_priority    = priority;
+	m_coreId      = coreId;
+	m_taskData    = nullptr;
+	m_handle      = nullptr;
+	m_pStack      = nullptr;
+	m_pTaskBuffer = nullptr;
+	m_ticks       = 0;
+	m_ticksSampled = 0;
 } // Task
 
 Task::~Task() {
@@ -49,15 +66,21 @@ void Task::delay(int ms) {
 /**
  * Static class member that actually runs the target task.
  *
- * The code here will run on the task thread.
+ * The code here will run on the task thread. The task stores its handle,
+ * registers and unregisters itself here so a short job that ends before
+ * start() returns cannot leave a stale handle or entry behind.
  * @param [in] pTaskInstance The task to run.
  */
 void Task::runTask(void* pTaskInstance) {
 	Task* pTask = (Task*)pTaskInstance;
+	pTask->m_handle = ::xTaskGetCurrentTaskHandle();
+	registerTask(pTask);
 	ESP_LOGD(tag, ">> runTask: taskName=%s", pTask->m_taskName.c_str());
 	pTask->run(pTask->m_taskData);
 	ESP_LOGD(tag, "<< runTask: taskName=%s", pTask->m_taskName.c_str());
-	pTask->stop();
+	unregisterTask(pTask);
+	pTask->m_handle = nullptr;
+	::vTaskDelete(nullptr);
 } // runTask
 
 /**
@@ -71,10 +94,52 @@ void Task::start(void* taskData) {
 		ESP_LOGW(tag, "Task::start - There might be a task already running!");
 	}
 	m_taskData = taskData;
-	::xTaskCreate(&runTask, m_taskName.c_str(), m_stackSize, this, m_priority, &m_handle);
+	if (!s_tickHooksRegistered) {
+		s_tickHooksRegistered = true;
+		for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++) {
+			::esp_register_freertos_tick_hook_for_cpu(&countTick, core);
+		}
+	}
+	// runTask() stores the handle, the task may already have ended when the
+	// create call returns
+#if configSUPPORT_STATIC_ALLOCATION
+	if (m_pStack != nullptr) {
+		::xTaskCreateStaticPinnedToCore(&runTask, m_taskName.c_str(), m_stackSize, this, m_priority, m_pStack, m_pTaskBuffer, m_coreId);
+	} else
+#endif
+	{
+		::xTaskCreatePinnedToCore(&runTask, m_taskName.c_str(), m_stackSize, this, m_priority, nullptr, m_coreId);
+	}
 } // start
 
 
+/**
+ * @brief Count the tick for the task running on this core.
+ *
+ * Called from the tick interrupt of every core. Sampling the running task at
+ * the tick rate gives the CPU share per task and core without FreeRTOS run
+ * time stats, which the Arduino core is built without.
+ * @return N/A.
+ */
+void IRAM_ATTR Task::countTick() {
+	BaseType_t core = ::xPortGetCoreID();
+	TaskHandle_t current = ::xTaskGetCurrentTaskHandleForCPU(core);
+	portENTER_CRITICAL_ISR(&s_tasksMux);
+	s_coreTicks[core]++;
+	if (current == ::xTaskGetIdleTaskHandleForCPU(core)) {
+		s_idleTicks[core]++;
+	} else {
+		for (size_t i = 0; i < TASK_MAX_REGISTERED; i++) {
+			if (s_tasks[i] != nullptr && s_tasks[i]->m_handle == current) {
+				s_tasks[i]->m_ticks++;
+				break;
+			}
+		}
+	}
+	portEXIT_CRITICAL_ISR(&s_tasksMux);
+} // countTick
+
+
 /**
  * @brief Stop the task.
  *
@@ -84,21 +149,165 @@ void Task::stop() {
 	if (m_handle == nullptr) {
 		return;
 	}
+	unregisterTask(this);
 	xTaskHandle temp = m_handle;
 	m_handle = nullptr;
 	::vTaskDelete(temp);
 } // stop
 
+
+/**
+ * @brief Wake up the task if it is waiting for a notification.
+ *
+ * Lightweight alternative to a semaphore or queue for signalling a single task.
+ * @return N/A.
+ */
+void Task::notify() {
+	if (m_handle != nullptr) {
+		::xTaskNotifyGive(m_handle);
+	}
+} // notify
+
+
+/**
+ * @brief Wait until the task is notified.
+ *
+ * Must be called from within run().
+ * @param [in] ms The maximum time to wait in milliseconds or -1 to wait forever.
+ * @return True if a notification was received, false on timeout.
+ */
+bool Task::waitForNotification(int ms) {
+	TickType_t ticks = ms < 0 ? portMAX_DELAY : ms / portTICK_PERIOD_MS;
+	return ::ulTaskNotifyTake(pdTRUE, ticks) > 0;
+} // waitForNotification
+
+
+/**
+ * @brief Get the minimum amount of free stack since the task was started.
+ *
+ * @return The stack high water mark in bytes or 0 if the task is not running.
+ */
+uint32_t Task::getStackHighWaterMark() {
+	if (m_handle == nullptr) {
+		return 0;
+	}
+	return ::uxTaskGetStackHighWaterMark(m_handle);
+} // getStackHighWaterMark
+
+
+/**
+ * @brief Sample the runtime statistics of all running tasks.
+ *
+ * The CPU shares are taken from the ticks counted since the previous call.
+ * @param [out] pStats Array receiving the statistics.
+ * @param [in] maxStats Number of entries in pStats.
+ * @param [out] pCoreLoad Optional array receiving the load in percent of each of the portNUM_PROCESSORS cores.
+ * @return The number of entries written.
+ */
+size_t Task::sampleRuntimeStats(TaskRuntimeStats* pStats, size_t maxStats, uint8_t* pCoreLoad) {
+	size_t count = 0;
+	uint32_t elapsed[portNUM_PROCESSORS];
+	portENTER_CRITICAL(&s_tasksMux);
+	for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++) {
+		elapsed[core] = s_coreTicks[core] - s_coreTicksSampled[core];
+		uint32_t idle = s_idleTicks[core] - s_idleTicksSampled[core];
+		s_coreTicksSampled[core] = s_coreTicks[core];
+		s_idleTicksSampled[core] = s_idleTicks[core];
+		if (pCoreLoad != nullptr) {
+			pCoreLoad[core] = elapsed[core] > 0 ? 100 - idle * 100 / elapsed[core] : 0;
+		}
+	}
+	for (size_t i = 0; i < TASK_MAX_REGISTERED && count < maxStats; i++) {
+		Task* pTask = s_tasks[i];
+		if (pTask == nullptr || pTask->m_handle == nullptr) {
+			continue;
+		}
+		// Every core ticks at the same rate
+		uint32_t ticks = pTask->m_ticks - pTask->m_ticksSampled;
+		pTask->m_ticksSampled = pTask->m_ticks;
+		TaskRuntimeStats& stats = pStats[count++];
+		stats.name           = pTask->m_taskName.c_str();
+		stats.coreId         = pTask->m_coreId;
+		stats.priority       = pTask->m_priority;
+		stats.cpuPercent     = elapsed[0] > 0 ? ticks * 100 / elapsed[0] : 0;
+		stats.stackHighWater = ::uxTaskGetStackHighWaterMark(pTask->m_handle);
+	}
+	portEXIT_CRITICAL(&s_tasksMux);
+	return count;
+} // sampleRuntimeStats
+
+
+/**
+ * @brief Add a running task to the list used for runtime statistics.
+ *
+ * @param [in] pTask The task to add.
+ * @return N/A.
+ */
+void Task::registerTask(Task* pTask) {
+	portENTER_CRITICAL(&s_tasksMux);
+	for (size_t i = 0; i < TASK_MAX_REGISTERED; i++) {
+		if (s_tasks[i] == nullptr || s_tasks[i] == pTask) {
+			s_tasks[i] = pTask;
+			break;
+		}
+	}
+	portEXIT_CRITICAL(&s_tasksMux);
+} // registerTask
+
+
+/**
+ * @brief Remove a stopped task from the list used for runtime statistics.
+ *
+ * @param [in] pTask The task to remove.
+ * @return N/A.
+ */
+void Task::unregisterTask(Task* pTask) {
+	portENTER_CRITICAL(&s_tasksMux);
+	for (size_t i = 0; i < TASK_MAX_REGISTERED; i++) {
+		if (s_tasks[i] == pTask) {
+			s_tasks[i] = nullptr;
+		}
+	}
+	portEXIT_CRITICAL(&s_tasksMux);
+} // unregisterTask
+
 /**
  * @brief Set the stack size of the task.
  *
  * @param [in] stackSize The size of the stack for the task.
  * @return N/A.
  */
-void Task::setStackSize(uint16_t stackSize) {
+void Task::setStackSize(uint32_t stackSize) {
 	m_stackSize = stackSize;
 } // setStackSize
 
+
+/**
+ * @brief Run the task on a caller provided stack instead of a heap allocated one.
+ *
+ * Both buffers must stay valid while the task is running.
+ * @param [in] pStack The stack memory for the task.
+ * @param [in] stackSize The size of pStack.
+ * @param [in] pTaskBuffer The memory holding the task control block.
+ * @return N/A.
+ */
+void Task::setStaticStack(StackType_t* pStack, uint32_t stackSize, StaticTask_t* pTaskBuffer) {
+	m_pStack      = pStack;
+	m_stackSize   = stackSize;
+	m_pTaskBuffer = pTaskBuffer;
+} // setStaticStack
+
+
+/**
+ * @brief Pin the task to a core.
+ *
+ * @param [in] coreId The core to run the task on or tskNO_AFFINITY.
+ * @return N/A.
+ */
+void Task::setCore(BaseType_t coreId) {
+	m_coreId = coreId;
+} // setCore
+
 /**
  * @brief Set the priority of the task.
  *
@@ -10,6 +10,20 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <string>
+
+#define TASK_MAX_REGISTERED   16
+
+/**
+ * @brief Runtime statistics of a started task.
+ */
+struct TaskRuntimeStats {
+	const char* name;
+	BaseType_t  coreId;            // tskNO_AFFINITY if the task is not pinned
+	uint8_t     priority;
+	uint8_t     cpuPercent;        // share of a core since the previous sample
+	uint32_t    stackHighWater;    // minimum free stack since start (bytes)
+};
+
 /**
  * @brief Encapsulate a runnable task.
  *
@@ -30,16 +44,25 @@
  * @endcode
  *
  * implemented.
+ *
+ * A task can be pinned to a core with setCore() and can run on a caller
+ * provided stack with setStaticStack() instead of a heap allocated one.
  */
 class Task {
 public:
-	Task(std::string taskName="Task", uint16_t stackSize=10000, uint8_t priority=5);
+	Task(std::string taskName="Task", uint32_t stackSize=10000, uint8_t priority=5, BaseType_t coreId=tskNO_AFFINITY);
 	virtual ~Task();
-	void setStackSize(uint16_t stackSize);
+	void setStackSize(uint32_t stackSize);
 	void setPriority(uint8_t priority);
 	void setName(std::string name);
+	void setCore(BaseType_t coreId);
+	void setStaticStack(StackType_t* pStack, uint32_t stackSize, StaticTask_t* pTaskBuffer);
 	void start(void* taskData=nullptr);
 	void stop();
+	void notify();
+	bool waitForNotification(int ms=-1);
+	uint32_t getStackHighWaterMark();
+	static size_t sampleRuntimeStats(TaskRuntimeStats* pStats, size_t maxStats, uint8_t* pCoreLoad=nullptr);
 	/**
 	 * @brief Body of the task to execute.
 	 *
@@ -53,12 +76,20 @@ public:
 	void delay(int ms);
 
 private:
-	xTaskHandle m_handle;
-	void*       m_taskData;
+	xTaskHandle   m_handle;
+	void*         m_taskData;
+	volatile uint32_t m_ticks;        // ticks the task was running in
+	uint32_t      m_ticksSampled;
 	static void runTask(void *data);
-	std::string m_taskName;
-	uint16_t    m_stackSize;
-	uint8_t     m_priority;
+	static void registerTask(Task* pTask);
+	static void unregisterTask(Task* pTask);
+	static void countTick();
+	std::string   m_taskName;
+	uint32_t      m_stackSize;
+	uint8_t       m_priority;
+	BaseType_t    m_coreId;
+	StackType_t*  m_pStack;
+	StaticTask_t* m_pTaskBuffer;
 };
 
 #endif /* COMPONENTS_CPP_UTILS_TASK_H_ */
@@ -0,0 +1,87 @@
+#include "adaptive_sampling.h"
+#include "eprobe.h"
+
+#include <cmath>
+
+// Change that is worth a sample and change that is noise, per channel
+static const float significantSteps[ROLLING_CHANNEL_COUNT] = {0.2f, 1.0f,
+                                                              0.2f, 0.05f};
+static const float noiseSteps[ROLLING_CHANNEL_COUNT] = {0.05f, 0.2f, 0.05f,
+                                                        0.01f};
+
+static void adaptivesampling_values(const bme680_sensor_data_t &sample,
+                                    float *values) {
+  values[ROLLING_CHANNEL_TEMPERATURE] = sample.temperature;
+  values[ROLLING_CHANNEL_HUMIDITY] = sample.humidity;
+  values[ROLLING_CHANNEL_PRESSURE] = sample.pressure / 100.0f;
+  // Gas resistance spans decades, relative change is what matters. It is
+  // only measured every few cycles.
+  values[ROLLING_CHANNEL_AIRQUALITY] =
+      (sample.flags & SAMPLE_FLAG_GAS_FRESH) && sample.airquality > 0
+          ? logf(sample.airquality)
+          : NAN;
+}
+
+uint32_t adaptivesampling_intervalMs(const adaptive_sampling_state_t &state) {
+  return state.intervalMs != 0 ? state.intervalMs
+                               : ADAPTIVE_SAMPLING_DEFAULT_S * 1000;
+}
+
+void adaptivesampling_expedite(adaptive_sampling_state_t *state) {
+  state->intervalMs = ADAPTIVE_SAMPLING_MIN_S * 1000;
+}
+
+uint32_t adaptivesampling_update(adaptive_sampling_state_t *state,
+                                 const bme680_sensor_data_t &sample) {
+  float values[ROLLING_CHANNEL_COUNT];
+  adaptivesampling_values(sample, values);
+  uint32_t time = (uint32_t)sample.acquiringTime;
+
+  if (!state->started || time <= state->time) {
+    // First sample or a clock step, start over from the current values
+    for (int c = 0; c < ROLLING_CHANNEL_COUNT; c++) {
+      state->values[c] = values[c];
+      state->times[c] = time;
+    }
+    state->time = time;
+    state->started = true;
+    return adaptivesampling_intervalMs(*state);
+  }
+
+  float interval = ADAPTIVE_SAMPLING_MAX_S;
+  for (int c = 0; c < ROLLING_CHANNEL_COUNT; c++) {
+    if (!std::isnan(values[c])) {
+      if (!std::isnan(state->values[c]) && time > state->times[c]) {
+        float seconds = time - state->times[c];
+        float change = fabsf(values[c] - state->values[c]) - noiseSteps[c];
+        float rate = change > 0 ? change / seconds : 0.0f;
+        if (rate > state->rates[c]) {
+          state->rates[c] = rate;
+        } else {
+          state->rates[c] +=
+              (rate - state->rates[c]) * ADAPTIVE_SAMPLING_DECAY;
+        }
+      }
+      state->values[c] = values[c];
+      state->times[c] = time;
+    }
+
+    if (state->rates[c] > 0 &&
+        significantSteps[c] / state->rates[c] < interval) {
+      interval = significantSteps[c] / state->rates[c];
+    }
+  }
+  state->time = time;
+
+  float previous = adaptivesampling_intervalMs(*state) / 1000.0f;
+  if (interval > previous * ADAPTIVE_SAMPLING_GROWTH) {
+    interval = previous * ADAPTIVE_SAMPLING_GROWTH;
+  }
+  if (interval < ADAPTIVE_SAMPLING_MIN_S) {
+    interval = ADAPTIVE_SAMPLING_MIN_S;
+  } else if (interval > ADAPTIVE_SAMPLING_MAX_S) {
+    interval = ADAPTIVE_SAMPLING_MAX_S;
+  }
+  state->intervalMs = (uint32_t)(interval * 1000);
+  return state->intervalMs;
+}
\ No newline at end of file
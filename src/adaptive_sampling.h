@@ -0,0 +1,53 @@
+#ifndef ADAPTIVE_SAMPLING_H
+#define ADAPTIVE_SAMPLING_H
+
+#include <cstdint>
+
+#include "rolling_stats.h"
+#include "sync_measure.h"
+
+// Bounds of the sampling interval, override with build flags. Setting both
+// to the same value gives a fixed rate.
+#ifndef ADAPTIVE_SAMPLING_MIN_S
+#define ADAPTIVE_SAMPLING_MIN_S 5
+#endif
+#ifndef ADAPTIVE_SAMPLING_MAX_S
+#define ADAPTIVE_SAMPLING_MAX_S 300
+#endif
+#define ADAPTIVE_SAMPLING_DEFAULT_S 30
+// The interval grows by at most this factor per cycle
+#define ADAPTIVE_SAMPLING_GROWTH 1.5f
+// Weight of a new rate estimate while the rate is falling
+#define ADAPTIVE_SAMPLING_DECAY 0.3f
+
+/*
+ Change driven sampling interval.
+
+ Per channel it tracks how fast the readings move, after subtracting a noise
+ allowance from every step. A rising rate is taken over at once, a falling
+ one decays slowly. The next interval is the time the fastest channel needs
+ to move by its significant step (0.2 C, 1 %RH, 0.2 hPa, 5 % gas
+ resistance), clamped to the bounds. It shrinks immediately but stretches
+ gradually, so a quiet room ends up at the maximum and an opened window
+ brings it down to a few seconds within one cycle.
+
+ The state is plain data so it can live in RTC memory across deep sleep.
+*/
+typedef struct {
+  float values[ROLLING_CHANNEL_COUNT];  // last sample, gas as ln(ohm)
+  float rates[ROLLING_CHANNEL_COUNT];   // change per second
+  uint32_t times[ROLLING_CHANNEL_COUNT];
+  uint32_t time;
+  uint32_t intervalMs;
+  bool started;
+} adaptive_sampling_state_t;
+
+// Returns the interval until the next sample in milliseconds
+uint32_t adaptivesampling_update(adaptive_sampling_state_t *state,
+                                 const bme680_sensor_data_t &sample);
+// Samples at the minimum interval next, it then stretches again gradually
+void adaptivesampling_expedite(adaptive_sampling_state_t *state);
+// The current interval, the default one before the first sample
+uint32_t adaptivesampling_intervalMs(const adaptive_sampling_state_t &state);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "alert.h"
+#include "eprobe.h"
+
+#include <cmath>
+#include <cstdio>
+
+static const char *kindFormats[] = {"%s: %.2f above %.2f",
+                                    "%s: %.2f below %.2f",
+                                    "%s: rising %.2f/min, limit %.2f",
+                                    "%s: falling %.2f/min, limit %.2f",
+                                    "%s: dropped %.0f%%, limit %.0f%%"};
+
+static void alert_values(const bme680_sensor_data_t &sample, float *values) {
+  values[ROLLING_CHANNEL_TEMPERATURE] = sample.temperature;
+  values[ROLLING_CHANNEL_HUMIDITY] = sample.humidity;
+  values[ROLLING_CHANNEL_PRESSURE] = sample.pressure / 100.0f;
+  values[ROLLING_CHANNEL_AIRQUALITY] = sample.flags & SAMPLE_FLAG_GAS_FRESH
+                                           ? sample.airquality / 1000.0f
+                                           : NAN;
+}
+
+// The quantity the rule compares against its threshold, NaN if unknown
+static float alert_measure(const alert_state_t &state,
+                           const alert_rule_t &rule, float value,
+                           uint32_t time) {
+  float previous = state.values[rule.channel];
+  uint32_t previousTime = state.times[rule.channel];
+  uint32_t seconds = time - previousTime;
+  bool comparable = previousTime != 0 && time > previousTime;
+
+  switch (rule.kind) {
+    case ALERT_ABOVE:
+    case ALERT_BELOW:
+      return value;
+    case ALERT_RISE:
+      return comparable ? (value - previous) * 60 / seconds : NAN;
+    case ALERT_FALL:
+      return comparable ? (previous - value) * 60 / seconds : NAN;
+    case ALERT_DROP:
+      return comparable && previous > 0 ? (previous - value) / previous : NAN;
+  }
+  return NAN;
+}
+
+size_t alert_evaluate(alert_state_t *state, const alert_rule_t *rules,
+                      size_t count, const bme680_sensor_data_t &sample) {
+  float values[ROLLING_CHANNEL_COUNT];
+  alert_values(sample, values);
+  uint32_t time = (uint32_t)sample.acquiringTime;
+  size_t fired = 0;
+
+  for (size_t i = 0; i < count && i < ALERT_MAX_RULES; i++) {
+    const alert_rule_t &rule = rules[i];
+    float value = values[rule.channel];
+    if (std::isnan(value)) {
+      continue;
+    }
+    float measure = alert_measure(*state, rule, value, time);
+    if (std::isnan(measure)) {
+      continue;
+    }
+
+    bool holds =
+        rule.kind == ALERT_BELOW ? measure < rule.threshold
+                                 : measure > rule.threshold;
+    uint16_t bit = 1 << i;
+    if (!holds) {
+      state->active &= ~bit;
+      continue;
+    }
+    bool rising = !(state->active & bit);
+    state->active |= bit;
+    bool cooling = state->firedTimes[i] != 0 &&
+                   time - state->firedTimes[i] < rule.cooldown;
+    if (rising && !cooling) {
+      // A rule firing again before it went out is sent with the new reading
+      state->pending |= bit;
+      state->pendingValues[i] = measure;
+      state->pendingTimes[i] = time;
+      fired++;
+    }
+  }
+
+  for (int c = 0; c < ROLLING_CHANNEL_COUNT; c++) {
+    if (!std::isnan(values[c])) {
+      state->values[c] = values[c];
+      state->times[c] = time;
+    }
+  }
+  return fired;
+}
+
+size_t alert_pending(const alert_state_t &state, const alert_rule_t *rules,
+                     size_t count, alert_event_t *events, size_t maxEvents) {
+  size_t n = 0;
+  for (size_t i = 0; i < count && i < ALERT_MAX_RULES && n < maxEvents; i++) {
+    if (state.pending & (1 << i)) {
+      events[n].rule = &rules[i];
+      events[n].value = state.pendingValues[i];
+      events[n].time = state.pendingTimes[i];
+      events[n].index = i;
+      n++;
+    }
+  }
+  return n;
+}
+
+void alert_acknowledge(alert_state_t *state, const alert_event_t &event,
+                       uint32_t time) {
+  state->pending &= ~(1 << event.index);
+  state->firedTimes[event.index] = time;
+}
+
+void alert_formatMessage(const alert_event_t &event, char *message,
+                         size_t len) {
+  const alert_rule_t &rule = *event.rule;
+  float scale = rule.kind == ALERT_DROP ? 100.0f : 1.0f;
+  snprintf(message, len, kindFormats[rule.kind], rule.name,
+           event.value * scale, rule.threshold * scale);
+}
\ No newline at end of file
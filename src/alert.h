@@ -0,0 +1,73 @@
+#ifndef ALERT_H
+#define ALERT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "rolling_stats.h"
+#include "sync_measure.h"
+
+#define ALERT_MAX_RULES 16
+#define ALERT_MESSAGE_LEN 96
+
+/*
+ Threshold and rate of change rules evaluated on every sample.
+
+ Values are in the units of rolling_stats.h (hPa, kOhm). Rates are per
+ minute against the previous reading of the channel; ALERT_DROP compares
+ the relative fall between two readings, which suits the gas resistance
+ that spans decades. A rule fires when its condition becomes true and is
+ re-armed once the condition is false again. A fired rule stays pending
+ until alert_acknowledge() confirms the broker received it and is offered
+ again by alert_pending() until then, so an alert is not lost while the
+ network is down. The cooldown starts at the acknowledgement; a rule fires
+ at most once per cooldown. Stale gas readings are not evaluated.
+
+ The state is plain data so it can live in RTC memory across deep sleep.
+*/
+typedef enum {
+  ALERT_ABOVE,  // value > threshold
+  ALERT_BELOW,  // value < threshold
+  ALERT_RISE,   // rise per minute > threshold
+  ALERT_FALL,   // fall per minute > threshold
+  ALERT_DROP    // fall relative to the previous reading > threshold
+} alert_kind_t;
+
+typedef struct {
+  const char *name;
+  rolling_channel_t channel;
+  alert_kind_t kind;
+  float threshold;
+  uint32_t cooldown;  // seconds
+} alert_rule_t;
+
+typedef struct {
+  float values[ROLLING_CHANNEL_COUNT];
+  uint32_t times[ROLLING_CHANNEL_COUNT];
+  uint32_t firedTimes[ALERT_MAX_RULES];  // last acknowledged
+  float pendingValues[ALERT_MAX_RULES];
+  uint32_t pendingTimes[ALERT_MAX_RULES];  // sample that fired the rule
+  uint16_t active;   // bit per rule whose condition holds
+  uint16_t pending;  // bit per rule fired but not acknowledged
+} alert_state_t;
+
+typedef struct {
+  const alert_rule_t *rule;
+  float value;    // the value or rate that triggered the rule
+  uint32_t time;  // of the sample that triggered the rule
+  uint8_t index;  // of the rule
+} alert_event_t;
+
+// Returns the number of rules that fired with this sample
+size_t alert_evaluate(alert_state_t *state, const alert_rule_t *rules,
+                      size_t count, const bme680_sensor_data_t &sample);
+// Returns the pending alerts, oldest rule first, at most maxEvents
+size_t alert_pending(const alert_state_t &state, const alert_rule_t *rules,
+                     size_t count, alert_event_t *events, size_t maxEvents);
+// The broker received the alert, its cooldown starts at time
+void alert_acknowledge(alert_state_t *state, const alert_event_t &event,
+                       uint32_t time);
+void alert_formatMessage(const alert_event_t &event, char *message,
+                         size_t len);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "burst_filter.h"
+#include "eprobe.h"
+
+#include <cmath>
+
+// Consistency constant of the MAD for normally distributed noise
+#define BURST_FILTER_MAD_SCALE 1.4826f
+
+static void burstfilter_sort(float *values, size_t count) {
+  for (size_t i = 1; i < count; i++) {
+    float value = values[i];
+    size_t j = i;
+    while (j > 0 && values[j - 1] > value) {
+      values[j] = values[j - 1];
+      j--;
+    }
+    values[j] = value;
+  }
+}
+
+static float burstfilter_median(float *values, size_t count) {
+  burstfilter_sort(values, count);
+  return count % 2 ? values[count / 2]
+                   : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+float burstfilter_combine(const float *readings, size_t count,
+                          size_t *rejected) {
+  float values[BURST_FILTER_MAX_READINGS];
+  size_t n = 0;
+  for (size_t i = 0; i < count && n < BURST_FILTER_MAX_READINGS; i++) {
+    if (!std::isnan(readings[i])) {
+      values[n++] = readings[i];
+    }
+  }
+  if (n == 0) {
+    return NAN;
+  }
+
+  float median = burstfilter_median(values, n);
+  float deviations[BURST_FILTER_MAX_READINGS];
+  for (size_t i = 0; i < n; i++) {
+    deviations[i] = fabsf(values[i] - median);
+  }
+  float limit = BURST_FILTER_HAMPEL_THRESHOLD * BURST_FILTER_MAD_SCALE *
+                burstfilter_median(deviations, n);
+
+  float sum = 0;
+  size_t used = 0;
+  for (size_t i = 0; i < n; i++) {
+    // A MAD of 0 keeps the readings equal to the median
+    if (fabsf(values[i] - median) <= limit) {
+      sum += values[i];
+      used++;
+    }
+  }
+  *rejected += n - used;
+  return sum / used;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef BURST_FILTER_H
+#define BURST_FILTER_H
+
+#include <cstddef>
+
+#define BURST_FILTER_MAX_READINGS 16
+// Readings further than this many scaled MADs from the median are outliers
+#define BURST_FILTER_HAMPEL_THRESHOLD 3.0f
+
+/*
+ Combines a burst of readings of one channel into a single value with a
+ Hampel filter: readings further from the median than
+ BURST_FILTER_HAMPEL_THRESHOLD times the scaled median absolute deviation
+ are rejected and the rest are averaged. NaN readings are skipped. Returns
+ NaN if no reading is left, the number of rejected readings is added to
+ rejected.
+*/
+float burstfilter_combine(const float *readings, size_t count,
+                          size_t *rejected);
+
+#endif
\ No newline at end of file
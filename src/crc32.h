@@ -0,0 +1,11 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32 (IEEE 802.3, as used by zlib and gzip). Start with crc = 0 and
+// feed the previous result back in to checksum data in pieces.
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,547 @@
+#include "datalog.h"
+#include "eprobe.h"
+
+#include <Arduino.h>
+#include <cstdlib>
+#include <cstring>
+
+#include "crc32.h"
+
+#define DATALOG_MARKER 0xA5
+#define DATALOG_SEGMENT_MAGIC 0x31474c45  // "ELG1"
+#define DATALOG_FILL_CHUNK 512
+
+static const char *LOG_TAG = "Datalog";
+
+// Guards the header of an open log, the HTTP server copies it from its task
+static portMUX_TYPE headerMux = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t recordBuf[DATALOG_MAX_RECORD_LEN];
+static const uint8_t zeros[DATALOG_FILL_CHUNK] = {0};
+
+static size_t datalog_encode(uint8_t *buf, uint8_t type, uint32_t sequence,
+                             uint32_t time, const void *payload,
+                             uint16_t length) {
+  buf[0] = DATALOG_MARKER;
+  buf[1] = type;
+  memcpy(buf + 2, &length, sizeof(length));
+  memcpy(buf + 4, &sequence, sizeof(sequence));
+  memcpy(buf + 8, &time, sizeof(time));
+  memcpy(buf + DATALOG_HEADER_LEN, payload, length);
+
+  uint32_t crc = crc32_update(0, buf + 1, DATALOG_HEADER_LEN - 1 + length);
+  memcpy(buf + DATALOG_HEADER_LEN + length, &crc, sizeof(crc));
+  return DATALOG_HEADER_LEN + length + DATALOG_CRC_LEN;
+}
+
+bool datalog_readRecord(fs::File &file, uint32_t offset,
+                        datalog_record_t *record, uint8_t *payload) {
+  uint8_t header[DATALOG_HEADER_LEN];
+
+  if (!file.seek(offset) ||
+      file.read(header, DATALOG_HEADER_LEN) != DATALOG_HEADER_LEN ||
+      header[0] != DATALOG_MARKER) {
+    return false;
+  }
+
+  record->type = header[1];
+  memcpy(&record->length, header + 2, sizeof(record->length));
+  memcpy(&record->sequence, header + 4, sizeof(record->sequence));
+  memcpy(&record->time, header + 8, sizeof(record->time));
+  if (record->length > DATALOG_MAX_PAYLOAD) {
+    return false;
+  }
+
+  uint32_t storedCrc;
+  if (file.read(payload, record->length) != record->length ||
+      file.read((uint8_t *)&storedCrc, sizeof(storedCrc)) !=
+          sizeof(storedCrc)) {
+    return false;
+  }
+
+  uint32_t crc = crc32_update(0, header + 1, DATALOG_HEADER_LEN - 1);
+  crc = crc32_update(crc, payload, record->length);
+  return crc == storedCrc;
+}
+
+bool datalog_readSegmentHeader(fs::File &file,
+                               datalog_segment_header_t *header) {
+  if (!file.seek(0) ||
+      file.read((uint8_t *)header, sizeof(*header)) != sizeof(*header)) {
+    return false;
+  }
+  return header->magic == DATALOG_SEGMENT_MAGIC &&
+         header->size == file.size() &&
+         header->end >= DATALOG_SEGMENT_HEADER_LEN &&
+         header->end <= header->size;
+}
+
+void datalog_segmentPath(const datalog_t *log, uint32_t segment, char *path,
+                         size_t len) {
+  snprintf(path, len, "%s/%08u.log", log->dir, (unsigned)segment);
+}
+
+void datalog_forEachSegment(datalog_t *log, datalog_segment_visitor_t visitor,
+                            void *context) {
+  File dir = log->fs->open(log->dir);
+  if (!dir || !dir.isDirectory()) {
+    return;
+  }
+
+  File entry = dir.openNextFile();
+  while (entry) {
+    // Depending on the core version name() is either the path or the base name
+    const char *name = strrchr(entry.name(), '/');
+    name = name ? name + 1 : entry.name();
+
+    char *suffix;
+    uint32_t segment = strtoul(name, &suffix, 10);
+    bool isSegment = suffix != name && strcmp(suffix, ".log") == 0;
+    entry.close();
+    if (isSegment && !visitor(segment, context)) {
+      break;
+    }
+    entry = dir.openNextFile();
+  }
+  dir.close();
+}
+
+bool datalog_segmentHeader(datalog_t *log, uint32_t segment,
+                           datalog_segment_header_t *header) {
+  // The header of the open segment on the card lags behind
+  portENTER_CRITICAL(&headerMux);
+  bool open = log->mounted && segment == log->header.segment;
+  if (open) {
+    *header = log->header;
+  }
+  portEXIT_CRITICAL(&headerMux);
+  if (open) {
+    return true;
+  }
+
+  char path[DATALOG_PATH_LEN];
+  datalog_segmentPath(log, segment, path, sizeof(path));
+  File file = log->fs->open(path, FILE_READ);
+  if (!file) {
+    return false;
+  }
+  bool valid = datalog_readSegmentHeader(file, header);
+  file.close();
+  return valid;
+}
+
+typedef struct {
+  datalog_t *log;
+  uint32_t from;
+  uint32_t to;
+  uint32_t segments[DATALOG_MAX_REMOVE];
+  size_t count;
+} datalog_remove_t;
+
+static bool datalog_removeVisitor(uint32_t segment, void *context) {
+  datalog_remove_t *remove = (datalog_remove_t *)context;
+  datalog_segment_header_t header;
+
+  if (segment == remove->log->header.segment ||
+      !datalog_segmentHeader(remove->log, segment, &header) ||
+      header.firstTime == 0 || header.firstTime < remove->from ||
+      header.lastTime >= remove->to) {
+    return true;
+  }
+  remove->segments[remove->count++] = segment;
+  return remove->count < DATALOG_MAX_REMOVE;
+}
+
+size_t datalog_removeSegments(datalog_t *log, uint32_t from, uint32_t to) {
+  if (!log->mounted) {
+    return 0;
+  }
+
+  // Collect first, the directory must not change while it is listed
+  datalog_remove_t remove = {log, from, to, {}, 0};
+  datalog_forEachSegment(log, datalog_removeVisitor, &remove);
+
+  char path[DATALOG_PATH_LEN];
+  for (size_t i = 0; i < remove.count; i++) {
+    datalog_segmentPath(log, remove.segments[i], path, sizeof(path));
+    if (log->fs->remove(path)) {
+      ESP_LOGI(LOG_TAG, "Removed segment %s", path);
+    } else {
+      ESP_LOGW(LOG_TAG, "Failed to remove %s", path);
+    }
+  }
+  return remove.count;
+}
+
+typedef struct {
+  uint32_t below;
+  uint32_t last;
+} datalog_find_last_t;
+
+static bool datalog_findLastVisitor(uint32_t segment, void *context) {
+  datalog_find_last_t *find = (datalog_find_last_t *)context;
+  if (segment < find->below && segment > find->last) {
+    find->last = segment;
+  }
+  return true;
+}
+
+// The highest segment number below the given one, 0 if there is none
+static uint32_t datalog_findLastSegment(datalog_t *log,
+                                        uint32_t below = UINT32_MAX) {
+  datalog_find_last_t find = {below, 0};
+  datalog_forEachSegment(log, datalog_findLastVisitor, &find);
+  return find.last;
+}
+
+static bool datalog_writeSegmentHeader(fs::File &file,
+                                       const datalog_segment_header_t &header) {
+  return file.seek(0) &&
+         file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header);
+}
+
+// Stores the final header, so the segment no longer needs a recovery walk
+static void datalog_closeSegment(datalog_t *log) {
+  File file = log->fs->open(log->path, "r+");
+  if (!file || !datalog_writeSegmentHeader(file, log->header)) {
+    ESP_LOGW(LOG_TAG, "Failed to write the final header of %s", log->path);
+  }
+  file.close();
+}
+
+static void datalog_sparePath(const datalog_t *log, char *path, size_t len) {
+  snprintf(path, len, "%s/" DATALOG_SPARE_NAME, log->dir);
+}
+
+static void datalog_startHeader(datalog_t *log, uint32_t segment,
+                                uint32_t sequence) {
+  datalog_segmentPath(log, segment, log->path, sizeof(log->path));
+
+  datalog_segment_header_t header;
+  memset(&header, 0, sizeof(header));
+  header.magic = DATALOG_SEGMENT_MAGIC;
+  header.segment = segment;
+  header.size = DATALOG_SEGMENT_SIZE;
+  header.end = DATALOG_SEGMENT_HEADER_LEN;
+  header.firstSequence = sequence;
+  header.sequence = sequence;
+  portENTER_CRITICAL(&headerMux);
+  log->header = header;
+  portEXIT_CRITICAL(&headerMux);
+  log->nextCheckpoint = 0;
+}
+
+static bool datalog_writeZeros(fs::File &file, uint32_t count) {
+  while (count > 0) {
+    size_t n = count < sizeof(zeros) ? count : sizeof(zeros);
+    if (file.write(zeros, n) != n) {
+      return false;
+    }
+    count -= n;
+  }
+  return true;
+}
+
+/*
+ Creates the segment and fills it with zeros up to its full size, so the
+ FAT clusters are allocated here once instead of during appends. Only used
+ when the spare segment is not ready.
+*/
+static bool datalog_createSegment(datalog_t *log, uint32_t segment,
+                                  uint32_t sequence) {
+  uint32_t start = millis();
+  datalog_startHeader(log, segment, sequence);
+
+  File file = log->fs->open(log->path, FILE_WRITE);
+  if (!file) {
+    ESP_LOGE(LOG_TAG, "Failed to create segment %s", log->path);
+    return false;
+  }
+
+  const datalog_segment_header_t &header = log->header;
+  bool success = file.write((const uint8_t *)&header, sizeof(header)) ==
+                     sizeof(header) &&
+                 datalog_writeZeros(file, header.size - sizeof(header));
+  file.close();
+
+  log->rolloverMillis = millis() - start;
+  if (!success) {
+    ESP_LOGE(LOG_TAG, "Failed to preallocate segment %s", log->path);
+    return false;
+  }
+  ESP_LOGI(LOG_TAG, "Preallocated %u bytes for %s in %u ms",
+           (unsigned)header.size, log->path, (unsigned)log->rolloverMillis);
+  return true;
+}
+
+/*
+ Turns the complete spare into the next segment. The header goes in before
+ the rename, so a reset in between leaves either a spare or a valid segment.
+*/
+static bool datalog_useSpare(datalog_t *log, uint32_t segment,
+                             uint32_t sequence) {
+  uint32_t start = millis();
+  char sparePath[DATALOG_PATH_LEN];
+  datalog_sparePath(log, sparePath, sizeof(sparePath));
+  datalog_startHeader(log, segment, sequence);
+  log->spareSize = 0;
+
+  File file = log->fs->open(sparePath, "r+");
+  bool success = file && file.size() == DATALOG_SEGMENT_SIZE &&
+                 datalog_writeSegmentHeader(file, log->header);
+  if (file) {
+    file.close();
+  }
+  if (!success || !log->fs->rename(sparePath, log->path)) {
+    ESP_LOGW(LOG_TAG, "Failed to use the spare segment for %s", log->path);
+    return false;
+  }
+
+  log->rolloverMillis = millis() - start;
+  ESP_LOGI(LOG_TAG, "Started %s from the spare in %u ms", log->path,
+           (unsigned)log->rolloverMillis);
+  return true;
+}
+
+static bool datalog_startSegment(datalog_t *log, uint32_t segment,
+                                 uint32_t sequence) {
+  if (log->spareSize >= DATALOG_SEGMENT_SIZE &&
+      datalog_useSpare(log, segment, sequence)) {
+    return true;
+  }
+  return datalog_createSegment(log, segment, sequence);
+}
+
+bool datalog_prepare(datalog_t *log, uint32_t maxBytes) {
+  if (!log->mounted) {
+    return false;
+  }
+  if (log->spareSize >= DATALOG_SEGMENT_SIZE) {
+    return true;
+  }
+
+  char path[DATALOG_PATH_LEN];
+  datalog_sparePath(log, path, sizeof(path));
+  File file = log->fs->open(path, log->spareSize == 0 ? FILE_WRITE
+                                                      : FILE_APPEND);
+  if (!file) {
+    ESP_LOGW(LOG_TAG, "Failed to open the spare segment %s", path);
+    return false;
+  }
+
+  uint32_t count = DATALOG_SEGMENT_SIZE - log->spareSize;
+  if (count > maxBytes) {
+    count = maxBytes;
+  }
+  if (datalog_writeZeros(file, count)) {
+    log->spareSize += count;
+  } else {
+    // Start over, the size on the card is unknown now
+    ESP_LOGW(LOG_TAG, "Failed to extend the spare segment %s", path);
+    log->spareSize = 0;
+  }
+  file.close();
+  return log->spareSize >= DATALOG_SEGMENT_SIZE;
+}
+
+// Picks up a spare segment left by a previous boot
+static void datalog_findSpare(datalog_t *log) {
+  char path[DATALOG_PATH_LEN];
+  datalog_sparePath(log, path, sizeof(path));
+  File file = log->fs->open(path, FILE_READ);
+  if (file) {
+    size_t size = file.size();
+    log->spareSize = size <= DATALOG_SEGMENT_SIZE ? size : 0;
+    file.close();
+  }
+}
+
+static void datalog_scrubTail(datalog_t *log) {
+  File file = log->fs->open(log->path, "r+");
+  if (!file || !file.seek(log->header.end)) {
+    ESP_LOGW(LOG_TAG, "Could not scrub torn tail of %s", log->path);
+    return;
+  }
+
+  uint32_t remaining = log->header.size - log->header.end;
+  if (remaining > DATALOG_MAX_RECORD_LEN) {
+    remaining = DATALOG_MAX_RECORD_LEN;
+  }
+  file.write(zeros, remaining);
+  file.close();
+}
+
+static bool datalog_recover(datalog_t *log, fs::File &file) {
+  datalog_segment_header_t &header = log->header;
+  if (!datalog_readSegmentHeader(file, &header)) {
+    return false;
+  }
+
+  // The header is only rewritten at checkpoints, follow the records
+  // appended after the last one
+  datalog_record_t record;
+  while (header.end < header.size &&
+         datalog_readRecord(file, header.end, &record, recordBuf) &&
+         record.sequence == header.sequence) {
+    if (header.firstTime == 0) {
+      header.firstTime = record.time;
+    }
+    header.lastTime = record.time;
+    header.end += DATALOG_HEADER_LEN + record.length + DATALOG_CRC_LEN;
+    header.sequence++;
+  }
+
+  uint8_t tail = 0;
+  if (header.end < header.size && file.seek(header.end)) {
+    file.read(&tail, 1);
+  }
+  if (tail != 0) {
+    ESP_LOGW(LOG_TAG, "Dropping torn tail of %s at %u", log->path,
+             (unsigned)header.end);
+    file.close();
+    datalog_scrubTail(log);
+  }
+
+  log->nextCheckpoint =
+      (header.end / DATALOG_CHECKPOINT_INTERVAL + 1) *
+      DATALOG_CHECKPOINT_INTERVAL;
+  return true;
+}
+
+/*
+ Sequence number to continue with when the header of the segment at
+ log->path is invalid: behind the consecutive records that are still
+ readable in it, failing that the end of the segment before it.
+*/
+static uint32_t datalog_salvageSequence(datalog_t *log, uint32_t segment) {
+  uint32_t sequence = 0;
+  datalog_segment_header_t header;
+  uint32_t previous = datalog_findLastSegment(log, segment);
+  if (previous != 0 && datalog_segmentHeader(log, previous, &header)) {
+    sequence = header.sequence;
+  }
+
+  File file = log->fs->open(log->path, FILE_READ);
+  if (!file) {
+    return sequence;
+  }
+  uint32_t offset = DATALOG_SEGMENT_HEADER_LEN;
+  uint32_t size = file.size();
+  bool first = true;
+  datalog_record_t record;
+  while (offset < size &&
+         datalog_readRecord(file, offset, &record, recordBuf) &&
+         (first ? record.sequence >= sequence : record.sequence == sequence)) {
+    first = false;
+    sequence = record.sequence + 1;
+    offset += DATALOG_HEADER_LEN + record.length + DATALOG_CRC_LEN;
+  }
+  file.close();
+  return sequence;
+}
+
+bool datalog_open(datalog_t *log, fs::FS &fs, const char *dir, bool lazy) {
+  uint32_t start = micros();
+
+  memset(log, 0, sizeof(*log));
+  if (strlen(dir) >= DATALOG_DIR_LEN) {
+    ESP_LOGE(LOG_TAG, "Directory name %s too long", dir);
+    return false;
+  }
+  log->fs = &fs;
+  strcpy(log->dir, dir);
+  fs.mkdir(dir);
+  datalog_findSpare(log);
+
+  uint32_t segment = datalog_findLastSegment(log);
+  if (segment == 0 && lazy) {
+    // The zero size header makes the first append roll over to segment 1
+    log->mounted = true;
+    return true;
+  }
+  if (segment == 0) {
+    log->mounted = datalog_startSegment(log, 1, 0);
+    return log->mounted;
+  }
+
+  datalog_segmentPath(log, segment, log->path, sizeof(log->path));
+  File file = fs.open(log->path, FILE_READ);
+  bool recovered = file && datalog_recover(log, file);
+  if (file) {
+    file.close();
+  }
+
+  if (!recovered) {
+    uint32_t sequence = datalog_salvageSequence(log, segment);
+    ESP_LOGE(LOG_TAG,
+             "Invalid segment header in %s, starting a new segment at "
+             "record %u",
+             log->path, (unsigned)sequence);
+    char badPath[DATALOG_PATH_LEN + 4];
+    snprintf(badPath, sizeof(badPath), "%s.bad", log->path);
+    fs.rename(log->path, badPath);
+    log->mounted = datalog_startSegment(log, segment + 1, sequence);
+    return log->mounted;
+  }
+
+  log->mounted = true;
+  ESP_LOGI(LOG_TAG, "Recovered %s: %u bytes, next record %u in %lu us",
+           log->path, (unsigned)log->header.end,
+           (unsigned)log->header.sequence, micros() - start);
+  return true;
+}
+
+bool datalog_append(datalog_t *log, uint8_t type, const void *payload,
+                    uint16_t length) {
+  if (!log->mounted || length > DATALOG_MAX_PAYLOAD) {
+    return false;
+  }
+
+  uint32_t start = micros();
+  datalog_segment_header_t &header = log->header;
+  size_t recordLen = DATALOG_HEADER_LEN + length + DATALOG_CRC_LEN;
+  if (header.end + recordLen > header.size) {
+    if (header.segment != 0) {
+      datalog_closeSegment(log);
+    }
+    if (!datalog_startSegment(log, header.segment + 1, header.sequence)) {
+      log->mounted = false;
+      return false;
+    }
+  }
+
+  File file = log->fs->open(log->path, "r+");
+  if (!file || !file.seek(header.end)) {
+    ESP_LOGE(LOG_TAG, "Failed to open %s for appending", log->path);
+    return false;
+  }
+
+  uint32_t now = (uint32_t)time(nullptr);
+  datalog_encode(recordBuf, type, header.sequence, now, payload, length);
+  bool success = file.write(recordBuf, recordLen) == recordLen;
+  if (success) {
+    portENTER_CRITICAL(&headerMux);
+    if (header.firstTime == 0) {
+      header.firstTime = now;
+    }
+    header.lastTime = now;
+    header.end += recordLen;
+    header.sequence++;
+    portEXIT_CRITICAL(&headerMux);
+  }
+
+  if (success && header.end >= log->nextCheckpoint) {
+    datalog_writeSegmentHeader(file, header);
+    log->nextCheckpoint =
+        (header.end / DATALOG_CHECKPOINT_INTERVAL + 1) *
+        DATALOG_CHECKPOINT_INTERVAL;
+  }
+  file.close();
+
+  log->lastAppendMicros = micros() - start;
+  if (log->lastAppendMicros > header.worstAppendMicros) {
+    portENTER_CRITICAL(&headerMux);
+    header.worstAppendMicros = log->lastAppendMicros;
+    portEXIT_CRITICAL(&headerMux);
+  }
+  return success;
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#ifndef DATALOG_H
+#define DATALOG_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "FS.h"
+
+// Size of a preallocated log segment, override with a build flag
+#ifndef DATALOG_SEGMENT_SIZE
+#define DATALOG_SEGMENT_SIZE (256 * 1024)
+#endif
+
+#define DATALOG_PATH_LEN 32
+// Longest directory, leaves room for "/<segment>.log" with a 10 digit number
+#define DATALOG_DIR_LEN (DATALOG_PATH_LEN - 16)
+#define DATALOG_SEGMENT_HEADER_LEN 64
+#define DATALOG_MAX_PAYLOAD 200
+#define DATALOG_HEADER_LEN 12
+#define DATALOG_CRC_LEN 4
+#define DATALOG_MAX_RECORD_LEN \
+  (DATALOG_HEADER_LEN + DATALOG_MAX_PAYLOAD + DATALOG_CRC_LEN)
+// The segment header is rewritten whenever the logical end passes a multiple
+// of this offset, recovery follows the records appended after that.
+#define DATALOG_CHECKPOINT_INTERVAL 4096
+// Segments removed per datalog_removeSegments() call
+#define DATALOG_MAX_REMOVE 16
+// Spare segment bytes written per datalog_prepare() call of the measure loop
+#define DATALOG_PREPARE_CHUNK (8 * 1024)
+#define DATALOG_SPARE_NAME "next.pre"
+
+/*
+ Journaled, crash-safe record log stored in preallocated segment files.
+
+ Every segment is DATALOG_SEGMENT_SIZE bytes long and zero filled when it is
+ created, so appends never have to allocate clusters. The next segment is
+ filled ahead of time as a spare file by datalog_prepare(), a rollover then
+ only writes its header and renames it. A segment starts with a header that
+ tracks the logical end, followed by records framed as
+   marker (0xA5) | type | payload length (u16) | sequence (u32) |
+   time (u32) | payload | CRC-32 over type .. payload
+ Sequence numbers increase by one per record across segments. Recovery
+ starts at the logical end stored in the header and follows the valid
+ records behind it; everything after the first invalid one is a torn tail.
+ A segment with an invalid header is set aside as .bad and the next one
+ continues behind its last readable record.
+*/
+typedef enum {
+  DATALOG_RECORD_SYNC = 0x00,       // only written by older firmware
+  DATALOG_RECORD_SAMPLE = 0x01,     // payload: CSV line, gas empty if held
+  DATALOG_RECORD_AGGREGATE = 0x02,  // payload: aggregate_record_t
+} datalog_record_type_t;
+
+typedef struct {
+  uint8_t type;
+  uint16_t length;
+  uint32_t sequence;
+  uint32_t time;
+} datalog_record_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t segment;
+  uint32_t size;
+  uint32_t end;            // offset behind the last record when written
+  uint32_t firstSequence;  // sequence number of the first record
+  uint32_t sequence;       // sequence number of the record at end
+  uint32_t firstTime;
+  uint32_t lastTime;
+  uint32_t worstAppendMicros;
+} datalog_segment_header_t;
+
+typedef struct {
+  fs::FS *fs;
+  char dir[DATALOG_DIR_LEN];
+  char path[DATALOG_PATH_LEN];  // current segment
+  datalog_segment_header_t header;
+  uint32_t nextCheckpoint;  // offset from which the header is rewritten
+  uint32_t spareSize;       // bytes of the spare segment written so far
+  uint32_t lastAppendMicros;  // including a rollover
+  uint32_t rolloverMillis;    // time taken to start the last segment
+  bool mounted;
+} datalog_t;
+
+// Called with every segment number found, return false to stop
+typedef bool (*datalog_segment_visitor_t)(uint32_t segment, void *context);
+
+// With lazy set an empty log creates its first segment on the first append.
+// Fails if dir is DATALOG_DIR_LEN characters or longer.
+bool datalog_open(datalog_t *log, fs::FS &fs, const char *dir,
+                  bool lazy = false);
+bool datalog_append(datalog_t *log, uint8_t type, const void *payload,
+                    uint16_t length);
+// Writes up to maxBytes of the spare segment, true once it is complete
+bool datalog_prepare(datalog_t *log, uint32_t maxBytes);
+void datalog_forEachSegment(datalog_t *log, datalog_segment_visitor_t visitor,
+                            void *context);
+bool datalog_segmentHeader(datalog_t *log, uint32_t segment,
+                           datalog_segment_header_t *header);
+// Removes closed segments whose records all lie within [from, to)
+size_t datalog_removeSegments(datalog_t *log, uint32_t from, uint32_t to);
+void datalog_segmentPath(const datalog_t *log, uint32_t segment, char *path,
+                         size_t len);
+bool datalog_readSegmentHeader(fs::File &file,
+                               datalog_segment_header_t *header);
+bool datalog_readRecord(fs::File &file, uint32_t offset,
+                        datalog_record_t *record, uint8_t *payload);
+
+#endif
\ No newline at end of file
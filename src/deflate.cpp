@@ -0,0 +1,155 @@
+#include "deflate.h"
+
+#include <cstring>
+
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+
+typedef struct {
+  uint8_t *out;
+  size_t capacity;
+  size_t pos;
+  uint32_t bits;
+  uint8_t bitCount;
+  bool overflow;
+} deflate_writer_t;
+
+// Base values and extra bits of the length codes 257..285
+static const uint16_t lengthBase[29] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                        1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                        4, 4, 4, 4, 5, 5, 5, 5, 0};
+// Base values and extra bits of the distance codes 0..29
+static const uint16_t distanceBase[30] = {
+    1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,
+    65,  97,  129, 193, 257, 385,  513,  769,  1025, 1537, 2049, 3073,
+    4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+                                          4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+                                          9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Appends count bits of value, least significant bit first
+static void deflate_putBits(deflate_writer_t *w, uint32_t value,
+                            uint8_t count) {
+  w->bits |= value << w->bitCount;
+  w->bitCount += count;
+  while (w->bitCount >= 8) {
+    if (w->pos < w->capacity) {
+      w->out[w->pos++] = (uint8_t)w->bits;
+    } else {
+      w->overflow = true;
+    }
+    w->bits >>= 8;
+    w->bitCount -= 8;
+  }
+}
+
+static void deflate_alignByte(deflate_writer_t *w) {
+  if (w->bitCount > 0) {
+    deflate_putBits(w, 0, 8 - w->bitCount);
+  }
+}
+
+// Huffman codes are sent most significant bit first
+static void deflate_putCode(deflate_writer_t *w, uint32_t code,
+                            uint8_t length) {
+  uint32_t reversed = 0;
+  for (uint8_t i = 0; i < length; i++) {
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+  deflate_putBits(w, reversed, length);
+}
+
+static void deflate_putSymbol(deflate_writer_t *w, uint16_t symbol) {
+  if (symbol < 144) {
+    deflate_putCode(w, 0x30 + symbol, 8);
+  } else if (symbol < 256) {
+    deflate_putCode(w, 0x190 + symbol - 144, 9);
+  } else if (symbol < 280) {
+    deflate_putCode(w, symbol - 256, 7);
+  } else {
+    deflate_putCode(w, 0xc0 + symbol - 280, 8);
+  }
+}
+
+static void deflate_putMatch(deflate_writer_t *w, uint16_t length,
+                             uint16_t distance) {
+  uint8_t code = 28;
+  while (lengthBase[code] > length) {
+    code--;
+  }
+  deflate_putSymbol(w, 257 + code);
+  deflate_putBits(w, length - lengthBase[code], lengthExtra[code]);
+
+  code = 29;
+  while (distanceBase[code] > distance) {
+    code--;
+  }
+  deflate_putCode(w, code, 5);
+  deflate_putBits(w, distance - distanceBase[code], distanceExtra[code]);
+}
+
+static uint16_t deflate_hash(const uint8_t *p) {
+  uint32_t v = (uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2];
+  return (uint16_t)((v * 2654435761u) >> (32 - DEFLATE_HASH_BITS));
+}
+
+size_t deflate_compress(deflate_state_t *state, const uint8_t *in, size_t len,
+                        uint8_t *out, size_t outCapacity, bool final) {
+  deflate_writer_t w = {out, outCapacity, 0, 0, 0, false};
+
+  // Positions are stored off by one, so 0 marks an empty slot
+  memset(state->hashHead, 0, sizeof(state->hashHead));
+
+  // BFINAL, BTYPE = 01 (fixed Huffman codes)
+  deflate_putBits(&w, final ? 1 : 0, 1);
+  deflate_putBits(&w, 1, 2);
+
+  size_t pos = 0;
+  while (pos < len && !w.overflow) {
+    size_t matchLength = 0;
+    size_t matchDistance = 0;
+
+    if (pos + DEFLATE_MIN_MATCH <= len) {
+      uint16_t h = deflate_hash(in + pos);
+      size_t candidate = state->hashHead[h];
+      state->hashHead[h] = (uint16_t)(pos + 1);
+
+      if (candidate != 0 && pos - (candidate - 1) <= DEFLATE_WINDOW) {
+        const uint8_t *ref = in + candidate - 1;
+        size_t max = len - pos;
+        if (max > DEFLATE_MAX_MATCH) {
+          max = DEFLATE_MAX_MATCH;
+        }
+        while (matchLength < max && ref[matchLength] == in[pos + matchLength]) {
+          matchLength++;
+        }
+        matchDistance = pos - (candidate - 1);
+      }
+    }
+
+    if (matchLength >= DEFLATE_MIN_MATCH) {
+      deflate_putMatch(&w, (uint16_t)matchLength, (uint16_t)matchDistance);
+      pos += matchLength;
+    } else {
+      deflate_putSymbol(&w, in[pos]);
+      pos++;
+    }
+  }
+
+  // End of block, then pad to a full byte
+  deflate_putSymbol(&w, 256);
+  if (!final) {
+    // Empty stored block: BFINAL = 0, BTYPE = 00, padding, LEN and NLEN
+    deflate_putBits(&w, 0, 3);
+    deflate_alignByte(&w);
+    deflate_putBits(&w, 0x0000, 16);
+    deflate_putBits(&w, 0xffff, 16);
+  }
+  deflate_alignByte(&w);
+
+  return w.overflow ? 0 : w.pos;
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define DEFLATE_HASH_BITS 10
+#define DEFLATE_HASH_SIZE (1 << DEFLATE_HASH_BITS)
+#define DEFLATE_WINDOW 4096
+// Worst case output of one call: 9 bit literals for bytes 144..255 (no match
+// codes more per byte), the block header, end of block and sync flush
+#define DEFLATE_MAX_OUTPUT(len) ((len) + (len) / 8 + 16)
+
+// Match finder table, one per concurrent user
+typedef struct {
+  uint16_t hashHead[DEFLATE_HASH_SIZE];
+} deflate_state_t;
+
+/*
+ Minimal raw deflate (RFC 1951) encoder: greedy LZ77 matching with a single
+ entry hash table and one block using the fixed Huffman codes. With final
+ set the call produces a complete stream that zlib's inflate (windowBits
+ -15) or any gzip member decoder accepts. Otherwise the block is followed by
+ an empty stored block to reach a byte boundary, like zlib's Z_SYNC_FLUSH,
+ and the output of further calls can be appended to it. Matches never
+ reach into previous calls. Returns the number of bytes written to out, or
+ 0 if the result does not fit into outCapacity, which can not happen with
+ DEFLATE_MAX_OUTPUT(len) bytes.
+*/
+size_t deflate_compress(deflate_state_t *state, const uint8_t *in, size_t len,
+                        uint8_t *out, size_t outCapacity, bool final = true);
+
+#endif
\ No newline at end of file
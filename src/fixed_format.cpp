@@ -0,0 +1,127 @@
+#include "fixed_format.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Largest right shift for which frac * 10 still fits into 64 bits
+#define MAX_FRACTION_SHIFT 59
+// Largest left shift for which the 53 bit mantissa fits into 63 bits
+#define MAX_INTEGER_SHIFT 10
+
+static int fixfmt_fallback(char *buf, size_t len, double value,
+                           uint8_t decimals, const char *suffix) {
+  return snprintf(buf, len, "%.*f%s", decimals, value,
+                  suffix != nullptr ? suffix : "");
+}
+
+static int fixfmt_output(char *buf, size_t len, const char *text,
+                         size_t textLen, const char *suffix) {
+  size_t suffixLen = suffix != nullptr ? strlen(suffix) : 0;
+  size_t total = textLen + suffixLen;
+
+  if (len > 0) {
+    size_t n = textLen < len - 1 ? textLen : len - 1;
+    memcpy(buf, text, n);
+    size_t m = suffixLen < len - 1 - n ? suffixLen : len - 1 - n;
+    if (m > 0) {
+      memcpy(buf + n, suffix, m);
+    }
+    buf[n + m] = '\0';
+  }
+  return (int)total;
+}
+
+int fixfmt_formatDouble(char *buf, size_t len, double value, uint8_t decimals,
+                        const char *suffix) {
+  if (decimals > FIXFMT_MAX_DECIMALS) {
+    return fixfmt_fallback(buf, len, value, decimals, suffix);
+  }
+
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  bool negative = (bits >> 63) != 0;
+  int biasedExponent = (int)((bits >> 52) & 0x7ff);
+  uint64_t mantissa = bits & ((1ULL << 52) - 1);
+
+  if (biasedExponent == 0x7ff) {
+    return fixfmt_fallback(buf, len, value, decimals, suffix);
+  }
+
+  uint64_t integer = 0;
+  char digits[FIXFMT_MAX_DECIMALS];
+  memset(digits, 0, sizeof(digits));
+
+  if (biasedExponent != 0) {
+    mantissa |= 1ULL << 52;
+    int exponent = biasedExponent - 1075;
+
+    if (exponent >= 0) {
+      if (exponent > MAX_INTEGER_SHIFT) {
+        return fixfmt_fallback(buf, len, value, decimals, suffix);
+      }
+      integer = mantissa << exponent;
+    } else if (-exponent > MAX_FRACTION_SHIFT) {
+      // below 2^-(4 * decimals + 2) the value always rounds to zero
+      if (-exponent < 53 + 4 * decimals + 2) {
+        return fixfmt_fallback(buf, len, value, decimals, suffix);
+      }
+    } else {
+      int shift = -exponent;
+      uint64_t mask = (1ULL << shift) - 1;
+      uint64_t fraction = mantissa & mask;
+      integer = mantissa >> shift;
+
+      for (uint8_t i = 0; i < decimals; i++) {
+        fraction *= 10;
+        digits[i] = (char)(fraction >> shift);
+        fraction &= mask;
+      }
+
+      uint64_t half = 1ULL << (shift - 1);
+      bool lastOdd = decimals > 0 ? (digits[decimals - 1] & 1) != 0
+                                  : (integer & 1) != 0;
+      if (fraction > half || (fraction == half && lastOdd)) {
+        int i = decimals - 1;
+        while (i >= 0 && digits[i] == 9) {
+          digits[i] = 0;
+          i--;
+        }
+        if (i >= 0) {
+          digits[i]++;
+        } else {
+          integer++;
+        }
+      }
+    }
+  }
+  // zero and subnormal values always round to zero
+
+  char text[1 + 20 + 1 + FIXFMT_MAX_DECIMALS];
+  char reversed[20];
+  size_t pos = 0;
+  size_t integerLen = 0;
+
+  if (negative) {
+    text[pos++] = '-';
+  }
+  do {
+    reversed[integerLen++] = (char)('0' + integer % 10);
+    integer /= 10;
+  } while (integer != 0);
+  while (integerLen > 0) {
+    text[pos++] = reversed[--integerLen];
+  }
+  if (decimals > 0) {
+    text[pos++] = '.';
+    for (uint8_t i = 0; i < decimals; i++) {
+      text[pos++] = (char)('0' + digits[i]);
+    }
+  }
+
+  return fixfmt_output(buf, len, text, pos, suffix);
+}
+
+int fixfmt_formatFloat(char *buf, size_t len, float value, uint8_t decimals,
+                       const char *suffix) {
+  return fixfmt_formatDouble(buf, len, (double)value, decimals, suffix);
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef FIXED_FORMAT_H
+#define FIXED_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define FIXFMT_MAX_DECIMALS 6
+
+/*
+ Formats value with a fixed number of decimals followed by an optional unit
+ suffix. The output is identical to snprintf(buf, len, "%.<decimals>f%s"),
+ including round-half-even on exact ties, but is computed with integer
+ arithmetic only. Values outside the fast path (NaN, infinity, very large or
+ very small magnitudes) fall back to snprintf. Returns the length of the
+ untruncated output like snprintf does.
+*/
+int fixfmt_formatDouble(char *buf, size_t len, double value, uint8_t decimals,
+                        const char *suffix = nullptr);
+int fixfmt_formatFloat(char *buf, size_t len, float value, uint8_t decimals,
+                       const char *suffix = nullptr);
+
+#endif
\ No newline at end of file
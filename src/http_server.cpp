@@ -0,0 +1,426 @@
+#include "http_server.h"
+#include "eprobe.h"
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <cstdlib>
+#include <cstring>
+
+#include "Task.h"
+#include "crc32.h"
+#include "deflate.h"
+#include "metrics.h"
+#include "retention.h"
+#include "sample_history.h"
+
+#define HTTP_SERVER_STACK_SIZE 6144
+#define HTTP_SERVER_POLL_MS 50
+#define HTTP_LINE_LEN 128
+#define HTTP_PATH_LEN 64
+#define HTTP_CHUNK 2048
+#define HTTP_DEFLATE_CAPACITY DEFLATE_MAX_OUTPUT(HTTP_CHUNK)
+
+typedef enum { RANGE_NONE, RANGE_VALID, RANGE_INVALID } http_range_t;
+
+// Datalogs served below a path prefix
+typedef struct {
+  const char *prefix;
+  datalog_t *log;
+} http_log_route_t;
+
+typedef struct {
+  char method[8];
+  char path[HTTP_PATH_LEN];
+  char range[32];  // value of the Range header
+  bool acceptGzip;
+} http_request_t;
+
+class HttpServerTask : public Task {
+ public:
+  HttpServerTask()
+      : Task("HttpServer", HTTP_SERVER_STACK_SIZE, 2, HTTP_SERVER_CORE) {}
+  void run(void *data) override;
+};
+
+static const char *LOG_TAG = "HttpServer";
+
+static const uint8_t gzipHeader[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+
+static http_log_route_t logRoutes[] = {
+    {"/segments", nullptr},
+    {"/5m/segments", nullptr},
+    {"/1h/segments", nullptr},
+};
+static HttpServerTask serverTask;
+static WiFiServer server(HTTP_SERVER_PORT);
+static deflate_state_t deflateState;
+static uint8_t chunk[HTTP_CHUNK];
+static uint8_t compressed[HTTP_DEFLATE_CAPACITY];
+static_assert(sizeof(compressed) >= DEFLATE_MAX_OUTPUT(HTTP_CHUNK),
+              "a deflated chunk must always fit");
+
+void httpserver_setup(datalog_t *journal) {
+  ESP_LOGI(LOG_TAG, "Setup HTTP server on port %d", HTTP_SERVER_PORT);
+  logRoutes[0].log = journal;
+  logRoutes[1].log = retention_tierLog(RETENTION_TIER_FINE);
+  logRoutes[2].log = retention_tierLog(RETENTION_TIER_COARSE);
+  serverTask.start();
+}
+
+// Reads one header line without the line break, false on timeout
+static bool http_readLine(WiFiClient &client, char *line, size_t len,
+                          uint32_t deadline) {
+  size_t pos = 0;
+  while (client.connected() && (int32_t)(millis() - deadline) < 0) {
+    if (client.available() <= 0) {
+      delay(1);
+      continue;
+    }
+    int c = client.read();
+    if (c == '\n') {
+      line[pos] = '\0';
+      return true;
+    }
+    if (c != '\r' && pos < len - 1) {
+      line[pos++] = (char)c;
+    }
+  }
+  return false;
+}
+
+static bool http_readRequest(WiFiClient &client, http_request_t *request) {
+  uint32_t deadline = millis() + HTTP_REQUEST_TIMEOUT_MS;
+  char line[HTTP_LINE_LEN];
+
+  memset(request, 0, sizeof(*request));
+  if (!http_readLine(client, line, sizeof(line), deadline) ||
+      sscanf(line, "%7s %63s", request->method, request->path) != 2) {
+    return false;
+  }
+
+  while (http_readLine(client, line, sizeof(line), deadline)) {
+    if (line[0] == '\0') {
+      return true;
+    }
+    if (strncasecmp(line, "Range:", 6) == 0) {
+      sscanf(line + 6, " %31s", request->range);
+    } else if (strncasecmp(line, "Accept-Encoding:", 16) == 0) {
+      request->acceptGzip = strstr(line + 16, "gzip") != nullptr;
+    }
+  }
+  return false;
+}
+
+/*
+ Parses a single "bytes=first-last", "bytes=first-" or "bytes=-suffix"
+ range against a resource of size bytes.
+*/
+static http_range_t http_parseRange(const char *value, uint32_t size,
+                                    uint32_t *first, uint32_t *last) {
+  if (value[0] == '\0') {
+    return RANGE_NONE;
+  }
+  if (strncmp(value, "bytes=", 6) != 0 || strchr(value, ',') != nullptr) {
+    return RANGE_INVALID;
+  }
+
+  const char *spec = value + 6;
+  char *end;
+  if (spec[0] == '-') {
+    uint32_t suffix = strtoul(spec + 1, &end, 10);
+    if (end == spec + 1 || *end != '\0' || suffix == 0 || size == 0) {
+      return RANGE_INVALID;
+    }
+    *first = suffix < size ? size - suffix : 0;
+    *last = size - 1;
+    return RANGE_VALID;
+  }
+
+  *first = strtoul(spec, &end, 10);
+  if (end == spec || *end != '-' || *first >= size) {
+    return RANGE_INVALID;
+  }
+  spec = end + 1;
+  *last = size - 1;
+  if (*spec != '\0') {
+    uint32_t requested = strtoul(spec, &end, 10);
+    if (*end != '\0' || requested < *first) {
+      return RANGE_INVALID;
+    }
+    if (requested < *last) {
+      *last = requested;
+    }
+  }
+  return RANGE_VALID;
+}
+
+static void http_sendStatus(WiFiClient &client, int status,
+                            const char *statusText, const char *contentType) {
+  client.printf(
+      "HTTP/1.1 %d %s\r\n"
+      "Content-Type: %s\r\n"
+      "Connection: close\r\n"
+      "Accept-Ranges: bytes\r\n",
+      status, statusText, contentType);
+}
+
+static void http_sendError(WiFiClient &client, int status,
+                           const char *statusText) {
+  http_sendStatus(client, status, statusText, "text/plain");
+  client.printf("Content-Length: %u\r\n\r\n%s\n",
+                (unsigned)strlen(statusText) + 1, statusText);
+}
+
+typedef struct {
+  WiFiClient *client;
+  datalog_t *log;
+  bool first;
+} http_segment_list_t;
+
+static bool http_segmentListVisitor(uint32_t segment, void *context) {
+  http_segment_list_t *list = (http_segment_list_t *)context;
+  datalog_segment_header_t header;
+  if (!datalog_segmentHeader(list->log, segment, &header)) {
+    return true;
+  }
+
+  list->client->printf(
+      "%s{\"segment\":%u,\"size\":%u,\"firstSequence\":%u,\"sequence\":%u,"
+      "\"firstTime\":%u,\"lastTime\":%u}",
+      list->first ? "" : ",", (unsigned)segment, (unsigned)header.end,
+      (unsigned)header.firstSequence, (unsigned)header.sequence,
+      (unsigned)header.firstTime, (unsigned)header.lastTime);
+  list->first = false;
+  return true;
+}
+
+static void http_sendSegmentList(WiFiClient &client, datalog_t *log) {
+  http_sendStatus(client, 200, "OK", "application/json");
+  client.print("\r\n[");
+  if (log->mounted) {
+    http_segment_list_t list = {&client, log, true};
+    datalog_forEachSegment(log, http_segmentListVisitor, &list);
+  }
+  client.print("]\n");
+}
+
+// False if the stream was abandoned, closing the connection then tells the
+// client that the response is incomplete
+static bool http_sendGzip(WiFiClient &client, File &file, uint32_t length) {
+  uint32_t crc = 0;
+  uint32_t remaining = length;
+
+  client.write(gzipHeader, sizeof(gzipHeader));
+  while (remaining > 0 && client.connected()) {
+    int n = file.read(chunk, remaining < HTTP_CHUNK ? remaining : HTTP_CHUNK);
+    if (n <= 0) {
+      break;
+    }
+    crc = crc32_update(crc, chunk, n);
+    size_t len = deflate_compress(&deflateState, chunk, n, compressed,
+                                  sizeof(compressed), false);
+    if (len == 0) {
+      // Skipping the chunk would corrupt the stream, a missing trailer at
+      // least makes the client fail
+      ESP_LOGE(LOG_TAG, "Deflate overflow, aborting the response");
+      return false;
+    }
+    client.write(compressed, len);
+    remaining -= n;
+  }
+
+  size_t len =
+      deflate_compress(&deflateState, nullptr, 0, compressed,
+                       sizeof(compressed), true);
+  if (len == 0) {
+    ESP_LOGE(LOG_TAG, "Deflate overflow, aborting the response");
+    return false;
+  }
+  client.write(compressed, len);
+  uint32_t trailer[2] = {crc, length - remaining};
+  client.write((const uint8_t *)trailer, sizeof(trailer));
+  return true;
+}
+
+static void http_sendSegment(WiFiClient &client,
+                             const http_request_t &request, datalog_t *log,
+                             uint32_t segment) {
+  datalog_segment_header_t header;
+  if (!log->mounted || !datalog_segmentHeader(log, segment, &header)) {
+    http_sendError(client, 404, "Not Found");
+    return;
+  }
+
+  char path[DATALOG_PATH_LEN];
+  datalog_segmentPath(log, segment, path, sizeof(path));
+  File file = log->fs->open(path, FILE_READ);
+  if (!file) {
+    http_sendError(client, 404, "Not Found");
+    return;
+  }
+
+  uint32_t size = header.end;
+  uint32_t first = 0;
+  uint32_t last = size - 1;
+  http_range_t range = http_parseRange(request.range, size, &first, &last);
+  if (range == RANGE_INVALID) {
+    http_sendStatus(client, 416, "Range Not Satisfiable", "text/plain");
+    client.printf("Content-Range: bytes */%u\r\nContent-Length: 0\r\n\r\n",
+                  (unsigned)size);
+    file.close();
+    return;
+  }
+
+  uint32_t length = last - first + 1;
+  bool gzip = range == RANGE_NONE && request.acceptGzip;
+  if (range == RANGE_VALID) {
+    http_sendStatus(client, 206, "Partial Content",
+                    "application/octet-stream");
+    client.printf("Content-Range: bytes %u-%u/%u\r\n", (unsigned)first,
+                  (unsigned)last, (unsigned)size);
+  } else {
+    http_sendStatus(client, 200, "OK", "application/octet-stream");
+  }
+  if (gzip) {
+    // The compressed length is unknown, the end of data is the end of the
+    // connection
+    client.print("Content-Encoding: gzip\r\n\r\n");
+  } else {
+    client.printf("Content-Length: %u\r\n\r\n", (unsigned)length);
+  }
+
+  uint32_t start = millis();
+  if (!file.seek(first)) {
+    ESP_LOGW(LOG_TAG, "Seek to %u failed in %s", (unsigned)first, path);
+  } else if (gzip) {
+    if (!http_sendGzip(client, file, length)) {
+      file.close();
+      return;
+    }
+  } else {
+    uint32_t remaining = length;
+    while (remaining > 0 && client.connected()) {
+      int n =
+          file.read(chunk, remaining < HTTP_CHUNK ? remaining : HTTP_CHUNK);
+      if (n <= 0) {
+        break;
+      }
+      client.write(chunk, n);
+      remaining -= n;
+    }
+  }
+  file.close();
+  ESP_LOGI(LOG_TAG, "Sent %u bytes of %s%s in %lu ms", (unsigned)length, path,
+           gzip ? " gzipped" : "", millis() - start);
+}
+
+static void http_sendSamples(WiFiClient &client, const char *query) {
+  size_t count = HTTP_SAMPLES_DEFAULT;
+  const char *n = query ? strstr(query, "n=") : nullptr;
+  if (n != nullptr) {
+    count = strtoul(n + 2, nullptr, 10);
+  }
+  if (count > SAMPLE_HISTORY_SIZE) {
+    count = SAMPLE_HISTORY_SIZE;
+  }
+
+  static bme680_sensor_data_t samples[SAMPLE_HISTORY_SIZE];
+  count = samplehistory_latest(samples, count);
+
+  http_sendStatus(client, 200, "OK", "application/json");
+  client.print("\r\n[");
+  for (size_t i = 0; i < count; i++) {
+    // Between gas measurements the held resistance is not repeated
+    char airquality[16] = "null";
+    if (samples[i].flags & SAMPLE_FLAG_GAS_FRESH) {
+      snprintf(airquality, sizeof(airquality), "%.0f", samples[i].airquality);
+    }
+    client.printf(
+        "%s{\"time\":%lu,\"temperature\":%.2f,\"humidity\":%.2f,"
+        "\"pressure\":%.2f,\"airquality\":%s,\"iaq\":%.0f,"
+        "\"iaqAccuracy\":%u}",
+        i == 0 ? "" : ",", (unsigned long)samples[i].acquiringTime,
+        samples[i].temperature, samples[i].humidity,
+        samples[i].pressure / 100.0, airquality, samples[i].iaq,
+        samples[i].iaqAccuracy);
+  }
+  client.print("]\n");
+}
+
+static void http_sendMetrics(WiFiClient &client) {
+  metrics_view_t view;
+  if (!metrics_acquire(&view)) {
+    http_sendError(client, 503, "Service Unavailable");
+    return;
+  }
+
+  http_sendStatus(client, 200, "OK", "text/plain; version=0.0.4");
+  client.printf("Content-Length: %u\r\n\r\n", (unsigned)view.length);
+  client.write((const uint8_t *)view.text, view.length);
+  metrics_release(view);
+}
+
+// Serves the segment list and segments of the datalogs, false if the path
+// belongs to none of them
+static bool http_handleLog(WiFiClient &client, const http_request_t &request) {
+  for (size_t i = 0; i < sizeof(logRoutes) / sizeof(logRoutes[0]); i++) {
+    const http_log_route_t &route = logRoutes[i];
+    size_t len = strlen(route.prefix);
+    if (route.log == nullptr || strncmp(request.path, route.prefix, len) != 0) {
+      continue;
+    }
+    if (request.path[len] == '\0') {
+      http_sendSegmentList(client, route.log);
+      return true;
+    }
+    if (request.path[len] == '/') {
+      http_sendSegment(client, request, route.log,
+                       strtoul(request.path + len + 1, nullptr, 10));
+      return true;
+    }
+  }
+  return false;
+}
+
+static void http_handle(WiFiClient &client) {
+  http_request_t request;
+  if (!http_readRequest(client, &request)) {
+    http_sendError(client, 400, "Bad Request");
+    return;
+  }
+  if (strcmp(request.method, "GET") != 0) {
+    http_sendError(client, 405, "Method Not Allowed");
+    return;
+  }
+
+  char *query = strchr(request.path, '?');
+  if (query != nullptr) {
+    *query++ = '\0';
+  }
+
+  if (http_handleLog(client, request)) {
+    return;
+  }
+  if (strcmp(request.path, "/samples") == 0) {
+    http_sendSamples(client, query);
+  } else if (strcmp(request.path, "/metrics") == 0) {
+    http_sendMetrics(client);
+  } else {
+    http_sendError(client, 404, "Not Found");
+  }
+}
+
+void HttpServerTask::run(void *data) {
+  server.begin();
+
+  while (1) {
+    WiFiClient client = server.available();
+    if (client) {
+      client.setNoDelay(true);
+      http_handle(client);
+      client.stop();
+    } else {
+      delay(HTTP_SERVER_POLL_MS);
+    }
+  }
+}
\ No newline at end of file
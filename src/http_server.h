@@ -0,0 +1,27 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include "datalog.h"
+
+#define HTTP_SERVER_PORT 80
+#define HTTP_SERVER_CORE 0
+#define HTTP_REQUEST_TIMEOUT_MS 2000
+#define HTTP_SAMPLES_DEFAULT 10
+
+/*
+ Minimal HTTP/1.1 server for pulling data off the probe over WiFi. It runs
+ in its own task, answers one request per connection and streams files in
+ chunks straight from the SD card.
+
+   GET /segments          JSON list of the datalog segments
+   GET /segments/<n>      raw segment up to its logical end, honours a
+                          single "Range: bytes=" range and gzips on the fly
+                          if the client accepts it and sent no range
+   GET /5m/segments[/<n>] the same for the 5 minute and hourly aggregates,
+   GET /1h/segments[/<n>] see retention.h
+   GET /samples?n=<count> JSON of the latest samples held in RAM
+   GET /metrics           Prometheus text exposition, see metrics.h
+*/
+void httpserver_setup(datalog_t *journal);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "iaq.h"
+#include "eprobe.h"
+
+#include <cmath>
+
+#include "nvs.h"
+
+#define IAQ_NVS_NAMESPACE "iaq"
+#define IAQ_NVS_KEY "baseline"
+#define IAQ_NVS_VERSION 1
+
+typedef struct {
+  uint32_t version;
+  float baseline;
+  uint32_t observedSeconds;
+} iaq_saved_t;
+
+static const char *LOG_TAG = "IAQ";
+
+static const char *accuracyNames[] = {"stabilizing", "learning", "medium",
+                                      "high"};
+
+const char *iaq_accuracyName(uint8_t accuracy) {
+  return accuracy <= IAQ_ACCURACY_HIGH ? accuracyNames[accuracy] : "unknown";
+}
+
+void iaq_restore(iaq_state_t *state) {
+  nvs_handle handle;
+  if (nvs_open(IAQ_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+    ESP_LOGI(LOG_TAG, "No saved baseline");
+    return;
+  }
+
+  iaq_saved_t saved;
+  size_t length = sizeof(saved);
+  if (nvs_get_blob(handle, IAQ_NVS_KEY, &saved, &length) == ESP_OK &&
+      length == sizeof(saved) && saved.version == IAQ_NVS_VERSION) {
+    state->baseline = saved.baseline;
+    state->observedSeconds = saved.observedSeconds;
+    state->started = true;
+    ESP_LOGI(LOG_TAG, "Restored baseline %.0f Ohm observed for %u s",
+             expf(saved.baseline), (unsigned)saved.observedSeconds);
+  }
+  nvs_close(handle);
+}
+
+static void iaq_save(iaq_state_t *state) {
+  nvs_handle handle;
+  esp_err_t err = nvs_open(IAQ_NVS_NAMESPACE, NVS_READWRITE, &handle);
+  if (err == ESP_OK) {
+    iaq_saved_t saved = {IAQ_NVS_VERSION, state->baseline,
+                         state->observedSeconds};
+    err = nvs_set_blob(handle, IAQ_NVS_KEY, &saved, sizeof(saved));
+    if (err == ESP_OK) {
+      err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+  }
+  if (err != ESP_OK) {
+    ESP_LOGW(LOG_TAG, "Failed to save baseline: %s", esp_err_to_name(err));
+  }
+}
+
+// Grams of water per m3 of air
+static float iaq_absoluteHumidity(float temperature, float humidity) {
+  float saturation =
+      6.112f * expf(17.62f * temperature / (243.12f + temperature));
+  return 216.7f * (humidity / 100.0f * saturation) / (273.15f + temperature);
+}
+
+static uint8_t iaq_accuracy(const iaq_state_t &state) {
+  if (state.readings < IAQ_WARMUP_READINGS) {
+    return IAQ_ACCURACY_STABILIZING;
+  }
+  if (state.observedSeconds >= IAQ_CALIBRATED_S) {
+    return IAQ_ACCURACY_HIGH;
+  }
+  return state.observedSeconds >= IAQ_LEARNING_S ? IAQ_ACCURACY_MEDIUM
+                                                 : IAQ_ACCURACY_LEARNING;
+}
+
+void iaq_update(iaq_state_t *state, const bme680_sensor_data_t &sample) {
+  if (!(sample.flags & SAMPLE_FLAG_GAS_FRESH) || !(sample.airquality > 0)) {
+    return;
+  }
+
+  uint32_t time = (uint32_t)sample.acquiringTime;
+  float compensated =
+      logf(sample.airquality) +
+      IAQ_HUMIDITY_SLOPE *
+          (iaq_absoluteHumidity(sample.temperature, sample.humidity) -
+           IAQ_HUMIDITY_REFERENCE);
+
+  if (state->readings < UINT16_MAX) {
+    state->readings++;
+  }
+  if (state->readings < IAQ_WARMUP_READINGS) {
+    // A cold heater reads too low, keep it out of the baseline
+    state->time = time;
+    state->accuracy = iaq_accuracy(*state);
+    state->iaq = 0;
+    return;
+  }
+
+  uint32_t seconds = state->started && time > state->time ? time - state->time
+                                                          : 0;
+  if (!state->started) {
+    state->baseline = compensated;
+    state->started = true;
+  } else if (compensated > state->baseline) {
+    state->baseline += (compensated - state->baseline) * IAQ_BASELINE_RISE;
+  } else {
+    float weight = (float)seconds / IAQ_BASELINE_TAU_S;
+    state->baseline += (compensated - state->baseline) * fminf(weight, 1.0f);
+  }
+  if (state->observedSeconds < UINT32_MAX - seconds) {
+    state->observedSeconds += seconds;
+  }
+  state->time = time;
+
+  float drop = state->baseline - compensated;
+  state->iaq = 500.0f * fminf(fmaxf(drop / IAQ_FULL_SCALE, 0.0f), 1.0f);
+  state->accuracy = iaq_accuracy(*state);
+
+  if (state->savedTime == 0 || time < state->savedTime) {
+    state->savedTime = time;
+  } else if (time - state->savedTime >= IAQ_SAVE_INTERVAL_S) {
+    state->savedTime = time;
+    iaq_save(state);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef IAQ_H
+#define IAQ_H
+
+#include <cstdint>
+
+#include "sync_measure.h"
+
+// Gas readings after a cold boot before the heater is trusted
+#define IAQ_WARMUP_READINGS 6
+// Time constant of the baseline following dirtier air
+#define IAQ_BASELINE_TAU_S (3 * 24 * 3600)
+// Weight of a reading above the baseline, cleaner air is taken quickly
+#define IAQ_BASELINE_RISE 0.2f
+// Change of ln(resistance) per g/m3 of absolute humidity
+#define IAQ_HUMIDITY_SLOPE 0.03f
+#define IAQ_HUMIDITY_REFERENCE 7.0f  // g/m3, about 40 %RH at 21 *C
+// Drop of ln(resistance) below the baseline that maps to an index of 500
+#define IAQ_FULL_SCALE 2.3f  // a tenth of the clean air resistance
+// Observation needed for the baseline accuracy levels
+#define IAQ_LEARNING_S (12 * 3600)
+#define IAQ_CALIBRATED_S (4 * 24 * 3600)
+// How often the baseline is written to flash
+#define IAQ_SAVE_INTERVAL_S (6 * 3600)
+
+/*
+ Indoor air quality index from the gas resistance.
+
+ The resistance is compensated for absolute humidity, which lowers it
+ roughly exponentially, and compared with a clean air baseline in the log
+ domain. The baseline follows cleaner air quickly and dirtier air with a
+ time constant of days, so it settles on the cleanest air seen recently
+ and tracks the slow drift of the sensor. The index grows linearly with
+ the drop below it, 0 is the baseline and 500 a tenth of it.
+
+ Accuracy follows the levels of Bosch's BSEC: 0 while the heater warms up,
+ 1 while the baseline is being learned, 2 once it has seen 12 h and 3 after
+ four days. Every update is O(1). The state lives in RTC memory across
+ deep sleep and the baseline is also kept in NVS so that a power cycle does
+ not start over.
+*/
+typedef enum {
+  IAQ_ACCURACY_STABILIZING,
+  IAQ_ACCURACY_LEARNING,
+  IAQ_ACCURACY_MEDIUM,
+  IAQ_ACCURACY_HIGH
+} iaq_accuracy_t;
+
+typedef struct {
+  float baseline;  // ln(Ohm), humidity compensated
+  uint32_t observedSeconds;
+  uint32_t time;  // of the last gas reading
+  uint32_t savedTime;
+  uint16_t readings;  // since cold boot
+  float iaq;
+  uint8_t accuracy;
+  bool started;
+} iaq_state_t;
+
+// Restores the baseline from NVS, call on cold boot
+void iaq_restore(iaq_state_t *state);
+// Updates the index from a sample with a fresh gas reading
+void iaq_update(iaq_state_t *state, const bme680_sensor_data_t &sample);
+const char *iaq_accuracyName(uint8_t accuracy);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "log_format.h"
+
+#include <cstdio>
+#include <cstring>
+
+typedef enum {
+  ARG_NONE,
+  ARG_INT,
+  ARG_LONG,
+  ARG_UNSIGNED_LONG,
+  ARG_LONG_LONG,
+  ARG_DOUBLE,
+  ARG_STRING,
+  ARG_PERCENT
+} logformat_arg_t;
+
+/*
+ Parses the conversion specification starting at the '%' in format. Copies
+ it to spec (NUL terminated), returns the argument type and advances format
+ behind the conversion character.
+*/
+static logformat_arg_t logformat_parseSpec(const char **format, char *spec) {
+  const char *p = *format;
+  size_t len = 0;
+  int longCount = 0;
+
+  spec[len++] = *p++;
+  while (*p != '\0' && len < LOG_FORMAT_SPEC_LEN - 2) {
+    char c = *p++;
+    spec[len++] = c;
+    switch (c) {
+      case '%':
+        spec[len] = '\0';
+        *format = p;
+        return ARG_PERCENT;
+      case 'l':
+        longCount++;
+        break;
+      case 'd':
+      case 'i':
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'o':
+      case 'c':
+        spec[len] = '\0';
+        *format = p;
+        if (longCount == 0) {
+          return ARG_INT;
+        }
+        if (longCount > 1) {
+          return ARG_LONG_LONG;
+        }
+        return (c == 'd' || c == 'i' || c == 'c') ? ARG_LONG
+                                                  : ARG_UNSIGNED_LONG;
+      case 'f':
+      case 'e':
+      case 'E':
+      case 'g':
+      case 'G':
+        spec[len] = '\0';
+        *format = p;
+        return ARG_DOUBLE;
+      case 's':
+        spec[len] = '\0';
+        *format = p;
+        return ARG_STRING;
+      default:
+        break;
+    }
+  }
+
+  spec[len] = '\0';
+  *format = p;
+  return ARG_NONE;
+}
+
+static bool logformat_put(uint8_t *payload, size_t capacity, size_t *length,
+                          const void *value, size_t size) {
+  if (*length + size > capacity) {
+    return false;
+  }
+  memcpy(payload + *length, value, size);
+  *length += size;
+  return true;
+}
+
+bool logformat_encode(const char *format, va_list args, uint8_t *payload,
+                      size_t capacity, size_t *length) {
+  char spec[LOG_FORMAT_SPEC_LEN];
+  const char *p = format;
+  bool fits = true;
+
+  *length = 0;
+  while (fits && (p = strchr(p, '%')) != nullptr) {
+    switch (logformat_parseSpec(&p, spec)) {
+      case ARG_INT: {
+        int32_t value = va_arg(args, int);
+        fits = logformat_put(payload, capacity, length, &value, sizeof(value));
+        break;
+      }
+      case ARG_LONG: {
+        int64_t value = va_arg(args, long);
+        fits = logformat_put(payload, capacity, length, &value, sizeof(value));
+        break;
+      }
+      case ARG_UNSIGNED_LONG: {
+        uint64_t value = va_arg(args, unsigned long);
+        fits = logformat_put(payload, capacity, length, &value, sizeof(value));
+        break;
+      }
+      case ARG_LONG_LONG: {
+        int64_t value = va_arg(args, long long);
+        fits = logformat_put(payload, capacity, length, &value, sizeof(value));
+        break;
+      }
+      case ARG_DOUBLE: {
+        double value = va_arg(args, double);
+        fits = logformat_put(payload, capacity, length, &value, sizeof(value));
+        break;
+      }
+      case ARG_STRING: {
+        const char *value = va_arg(args, const char *);
+        if (value == nullptr) {
+          value = "(null)";
+        }
+        size_t room = capacity - *length;
+        size_t len = strlen(value) + 1;
+        if (room == 0) {
+          fits = false;
+          break;
+        }
+        if (len > room) {
+          len = room;
+          fits = false;
+        }
+        memcpy(payload + *length, value, len - 1);
+        payload[*length + len - 1] = '\0';
+        *length += len;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  return fits;
+}
+
+/*
+ Writes the text of a record into line, always NUL terminated. A truncated
+ record ends with "..." after the last complete argument. Returns the length
+ of the text.
+*/
+size_t logformat_expand(const char *format, const uint8_t *payload,
+                        size_t length, bool truncated, char *line,
+                        size_t lineLen) {
+  char spec[LOG_FORMAT_SPEC_LEN];
+  const char *p = format;
+  size_t pos = 0;
+  size_t offset = 0;
+
+  while (*p != '\0' && pos < lineLen - 1) {
+    if (*p != '%') {
+      line[pos++] = *p++;
+      continue;
+    }
+
+    logformat_arg_t type = logformat_parseSpec(&p, spec);
+    size_t room = lineLen - pos;
+    int n = 0;
+    switch (type) {
+      case ARG_PERCENT:
+        n = snprintf(line + pos, room, "%%");
+        break;
+      case ARG_INT: {
+        int32_t value;
+        if (offset + sizeof(value) > length) {
+          goto truncated;
+        }
+        memcpy(&value, payload + offset, sizeof(value));
+        offset += sizeof(value);
+        n = snprintf(line + pos, room, spec, (int)value);
+        break;
+      }
+      case ARG_LONG: {
+        int64_t value;
+        if (offset + sizeof(value) > length) {
+          goto truncated;
+        }
+        memcpy(&value, payload + offset, sizeof(value));
+        offset += sizeof(value);
+        n = snprintf(line + pos, room, spec, (long)value);
+        break;
+      }
+      case ARG_UNSIGNED_LONG: {
+        uint64_t value;
+        if (offset + sizeof(value) > length) {
+          goto truncated;
+        }
+        memcpy(&value, payload + offset, sizeof(value));
+        offset += sizeof(value);
+        n = snprintf(line + pos, room, spec, (unsigned long)value);
+        break;
+      }
+      case ARG_LONG_LONG: {
+        int64_t value;
+        if (offset + sizeof(value) > length) {
+          goto truncated;
+        }
+        memcpy(&value, payload + offset, sizeof(value));
+        offset += sizeof(value);
+        n = snprintf(line + pos, room, spec, (long long)value);
+        break;
+      }
+      case ARG_DOUBLE: {
+        double value;
+        if (offset + sizeof(value) > length) {
+          goto truncated;
+        }
+        memcpy(&value, payload + offset, sizeof(value));
+        offset += sizeof(value);
+        n = snprintf(line + pos, room, spec, value);
+        break;
+      }
+      case ARG_STRING: {
+        if (offset >= length) {
+          goto truncated;
+        }
+        const char *value = (const char *)payload + offset;
+        size_t len = strnlen(value, length - offset);
+        if (len == length - offset) {
+          goto truncated;
+        }
+        offset += len + 1;
+        n = snprintf(line + pos, room, spec, value);
+        break;
+      }
+      default:
+        n = snprintf(line + pos, room, "%s", spec);
+        break;
+    }
+    pos += (n < 0) ? 0 : ((size_t)n < room ? (size_t)n : room - 1);
+  }
+
+  if (!truncated) {
+    line[pos] = '\0';
+    return pos;
+  }
+
+truncated:
+  if (pos > 0 && line[pos - 1] == '\n') {
+    pos--;
+  }
+  pos += snprintf(line + pos, lineLen - pos, "...\n");
+  return pos < lineLen ? pos : lineLen - 1;
+}
\ No newline at end of file
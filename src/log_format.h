@@ -0,0 +1,31 @@
+#ifndef LOG_FORMAT_H
+#define LOG_FORMAT_H
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ Binary encoding of printf style arguments for the deferred serial log,
+ shared with the host side expander in tools/log_expander.
+
+ The payload holds the arguments in the order of the conversions in the
+ format string, little endian and without padding:
+   %d %i %u %x %X %o %c   4 bytes
+   with l or ll           8 bytes, so longs decode on any host
+   %f %e %E %g %G         8 byte double
+   %s                     the characters and a terminating NUL
+ Supported length modifiers are h, l and ll; '*' width and precision are
+ not supported. A string that does not fit is cut and the payload marked
+ truncated, the remaining arguments are left out.
+*/
+#define LOG_FORMAT_SPEC_LEN 16
+
+// Returns true if all arguments fit into payload
+bool logformat_encode(const char *format, va_list args, uint8_t *payload,
+                      size_t capacity, size_t *length);
+size_t logformat_expand(const char *format, const uint8_t *payload,
+                        size_t length, bool truncated, char *line,
+                        size_t lineLen);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "log_sink.h"
+#include "eprobe.h"
+
+#include <Arduino.h>
+#include <atomic>
+#include <cstdarg>
+#include <cstring>
+
+#include "MpscQueue.h"
+#include "Task.h"
+#include "log_format.h"
+#ifdef LOG_SINK_BINARY
+#include "crc32.h"
+#include "log_sink_protocol.h"
+#endif
+
+#define LOG_SINK_LINE_LEN 192
+#define LOG_SINK_DRAIN_STACK_SIZE 3072
+
+typedef struct {
+  const char *format;
+  uint8_t payloadLen;
+  bool truncated;
+  uint8_t payload[LOG_SINK_PAYLOAD_LEN];
+} logsink_record_t;
+
+class LogDrainTask : public Task {
+ public:
+  LogDrainTask()
+      : Task("LogDrain", LOG_SINK_DRAIN_STACK_SIZE, 1, LOG_SINK_DRAIN_CORE) {}
+  void run(void *data) override;
+};
+
+static const char *LOG_TAG = "LogSink";
+
+static MpscQueue<logsink_record_t, LOG_SINK_CAPACITY> records;
+static std::atomic<uint32_t> pending(0);  // records written but not drained
+static std::atomic<uint32_t> dropped(0);
+static std::atomic<bool> paused(false);
+static LogDrainTask drainTask;
+static StackType_t drainStack[LOG_SINK_DRAIN_STACK_SIZE];
+static StaticTask_t drainTaskBuffer;
+
+bool logsink_drainOne();
+
+void logsink_setup() {
+  ESP_LOGI(LOG_TAG, "Setup deferred serial log");
+  drainTask.setStaticStack(drainStack, LOG_SINK_DRAIN_STACK_SIZE,
+                           &drainTaskBuffer);
+  drainTask.start();
+}
+
+uint32_t logsink_droppedCount() { return dropped.load(); }
+
+/*
+ Holds back the drain task while another user owns the UART, e.g. for a
+ bulk export. Records keep queueing up and are dropped once the queue is
+ full.
+*/
+void logsink_pause(bool pause) {
+  paused.store(pause);
+  if (!pause) {
+    drainTask.notify();
+  }
+}
+
+/*
+ Waits until the drain task has written all pending records, e.g. before
+ entering deep sleep.
+*/
+void logsink_flush(uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (pending.load() != 0 && millis() - start < timeoutMs) {
+    delay(10);
+  }
+  Serial.flush();
+}
+
+bool logsink_write(const char *format, ...) {
+  size_t ticket;
+  logsink_record_t *record = records.beginPush(ticket);
+  if (record == nullptr) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  size_t length;
+  va_list args;
+  va_start(args, format);
+  record->format = format;
+  record->truncated = !logformat_encode(format, args, record->payload,
+                                        LOG_SINK_PAYLOAD_LEN, &length);
+  record->payloadLen = length;
+  va_end(args);
+
+  pending.fetch_add(1, std::memory_order_relaxed);
+  records.endPush(ticket);
+  drainTask.notify();
+  return true;
+}
+
+#ifdef LOG_SINK_BINARY
+/*
+ Frames the record as is, the host expands it with the format strings from
+ the ELF file of the build.
+*/
+static size_t logsink_frame(const logsink_record_t *record, uint8_t *frame) {
+  uint32_t format = (uint32_t)(uintptr_t)record->format;
+  frame[0] = LOG_SINK_MAGIC0;
+  frame[1] = LOG_SINK_MAGIC1;
+  frame[2] = record->truncated ? LOG_SINK_FLAG_TRUNCATED : 0;
+  frame[3] = record->payloadLen;
+  memcpy(frame + 4, &format, sizeof(format));
+  memcpy(frame + LOG_SINK_HEADER_LEN, record->payload, record->payloadLen);
+
+  size_t length = LOG_SINK_HEADER_LEN + record->payloadLen;
+  uint32_t crc = crc32_update(0, frame + 2, length - 2);
+  memcpy(frame + length, &crc, sizeof(crc));
+  return length + LOG_SINK_CRC_LEN;
+}
+#endif
+
+bool logsink_drainOne() {
+  logsink_record_t *record = records.front();
+  if (record == nullptr) {
+    return false;
+  }
+
+#ifdef LOG_SINK_BINARY
+  uint8_t line[LOG_SINK_HEADER_LEN + LOG_SINK_PAYLOAD_LEN + LOG_SINK_CRC_LEN];
+  size_t len = logsink_frame(record, line);
+#else
+  char line[LOG_SINK_LINE_LEN];
+  size_t len = logformat_expand(record->format, record->payload,
+                                record->payloadLen, record->truncated, line,
+                                sizeof(line));
+#endif
+  records.popFront();
+  pending.fetch_sub(1, std::memory_order_relaxed);
+
+  Serial.write((const uint8_t *)line, len);
+  return true;
+}
+
+void LogDrainTask::run(void *data) {
+  uint32_t reportedDrops = 0;
+
+  while (1) {
+    while (!paused.load() && logsink_drainOne())
+      ;
+
+    uint32_t drops = dropped.load();
+    if (drops != reportedDrops && !paused.load()) {
+      Serial.printf("[%u log records dropped]\n",
+                    (unsigned)(drops - reportedDrops));
+      reportedDrops = drops;
+    }
+
+    waitForNotification(LOG_SINK_DRAIN_INTERVAL_MS);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef LOG_SINK_H
+#define LOG_SINK_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define LOG_SINK_CAPACITY 32  // records, must be a power of two
+#define LOG_SINK_PAYLOAD_LEN 88
+#define LOG_SINK_DRAIN_INTERVAL_MS 1000
+#define LOG_SINK_DRAIN_CORE 0
+
+/*
+ Deferred serial logging. logsink_write() only stores the address of the
+ format string and the binary encoded arguments (see log_format.h) in a
+ lock-free multi producer ring buffer, so any task may log. A low priority
+ drain task on the other core, woken by a task notification, writes the
+ records to the UART, so the measurement cycle never blocks on a full UART
+ FIFO.
+
+ By default the drain task sends the records as binary frames (see
+ log_sink_protocol.h), which tools/log_expander turns back into text using
+ the ELF file of the build. That keeps the formatting off the device and
+ shrinks the bytes on the wire. Define LOG_SINK_TEXT to expand the records
+ into text on the device instead, e.g. for a plain serial monitor.
+*/
+#ifndef LOG_SINK_TEXT
+#define LOG_SINK_BINARY
+#endif
+
+#define LOGSINK(format, ...) logsink_write(format, ##__VA_ARGS__)
+
+void logsink_setup();
+bool logsink_write(const char *format, ...)
+    __attribute__((format(printf, 1, 2)));
+void logsink_flush(uint32_t timeoutMs = 500);
+void logsink_pause(bool paused);
+uint32_t logsink_droppedCount();
+
+#endif
\ No newline at end of file
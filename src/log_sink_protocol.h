@@ -0,0 +1,26 @@
+#ifndef LOG_SINK_PROTOCOL_H
+#define LOG_SINK_PROTOCOL_H
+
+#include <cstdint>
+
+/*
+ Framing of the binary serial log, written by the drain task unless the
+ firmware is built with LOG_SINK_TEXT and read by tools/log_expander.
+
+ Every frame is
+   magic (0xE5 0x4C) | flags | length (u8) | format address (u32) |
+   payload | CRC-32 over flags .. payload
+ with all integers little endian. format address is the address of the
+ format string in the firmware image; the expander looks it up in the ELF
+ file of the same build. The payload holds the arguments as described in
+ log_format.h. Everything between frames is plain text, e.g. ESP_LOGx
+ output, and is passed through unchanged.
+*/
+#define LOG_SINK_MAGIC0 0xE5
+#define LOG_SINK_MAGIC1 0x4C
+#define LOG_SINK_HEADER_LEN 8
+#define LOG_SINK_CRC_LEN 4
+
+#define LOG_SINK_FLAG_TRUNCATED 0x01
+
+#endif
\ No newline at end of file
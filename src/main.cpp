@@ -1,15 +1,16 @@
 #include <Arduino.h>
 #include "eprobe.h"
 
+#include "log_sink.h"
+#include "metrics.h"
 #include "sync_measure.h"
 #include "system_time.h"
+#include "warm_boot.h"
 
 void print_wakeup_reason();
 
-#define MEASURE_CYCLE_TIME (30 * 1000)
-#define uS_TO_S_FACTOR \
-  1000000                /* Conversion factor for micro seconds to seconds */
-#define TIME_TO_SLEEP 30 /* Time ESP32 will go to sleep (in seconds) */
+#define uS_TO_MS_FACTOR \
+  1000ULL /* Conversion factor for micro seconds to milli seconds */
 
 RTC_DATA_ATTR int bootCount = 0;
 
@@ -17,14 +18,32 @@ static const char *LOG_TAG = "EProbeMain";
 
 void loop() {
   while (1) {
+    uint32_t cycleStart = millis();
     measureLoop();
 
-#ifdef SLEEP_ENABLED
-    ESP_LOGD(LOG_TAG, "Going into light sleep");
+    // The interval adapts to how fast the readings change
+    uint32_t elapsed = millis() - cycleStart;
+    uint32_t interval = measureIntervalMs();
+    uint32_t wait = interval > elapsed ? interval - elapsed : 0;
+
+#if defined(DEEP_SLEEP_ENABLED)
+    ESP_LOGD(LOG_TAG, "Going into deep sleep for %u ms", wait);
+    esp_sleep_enable_timer_wakeup(wait * uS_TO_MS_FACTOR);
+    suspendSyncMeasure();
+    logsink_flush();
+    esp_deep_sleep_start();
+#elif defined(SLEEP_ENABLED)
+    ESP_LOGD(LOG_TAG, "Going into light sleep for %u ms", wait);
+    esp_sleep_enable_timer_wakeup(wait * uS_TO_MS_FACTOR);
     esp_light_sleep_start();
     ESP_LOGD(LOG_TAG, "Woke up from light sleep");
 #else
-    delay(MEASURE_CYCLE_TIME);
+    while (wait > measureKeepaliveMs()) {
+      delay(measureKeepaliveMs());
+      wait -= measureKeepaliveMs();
+      measureKeepalive();
+    }
+    delay(wait);
 #endif
   }
 }
@@ -32,22 +51,24 @@ void loop() {
 void setup() {
   ++bootCount;
 
-  Serial.begin(112500);
+  Serial.begin(115200);
   while (!Serial)
     ;
+  logsink_setup();
   ESP_LOGI(LOG_TAG, "Environment Probe");
   ESP_LOGI(LOG_TAG, "Boot count %d", bootCount);
+  metrics_setBootCount(bootCount);
 
-#ifdef SLEEP_ENABLED
+#if defined(SLEEP_ENABLED) || defined(DEEP_SLEEP_ENABLED)
   ESP_LOGI(LOG_TAG, "Boot number: %d", bootCount);
-  esp_sleep_enable_timer_wakeup(TIME_TO_SLEEP * uS_TO_S_FACTOR);
   print_wakeup_reason();
 #endif
 
+  warmboot_setup();
   setupSyncMeasure();
 }
 
-#ifdef SLEEP_ENABLED
+#if defined(SLEEP_ENABLED) || defined(DEEP_SLEEP_ENABLED)
 /*
 Method to print the reason by which ESP32
 has been awaken from sleep
@@ -0,0 +1,288 @@
+#include "metrics.h"
+#include "eprobe.h"
+
+#include <Arduino.h>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#include "fixed_format.h"
+#include "upload_batch.h"
+
+// Width of the value field, right aligned behind the name
+#define METRICS_VALUE_WIDTH 16
+#define METRICS_INTEGER 0xff
+
+typedef enum {
+  METRIC_TEMPERATURE,
+  METRIC_HUMIDITY,
+  METRIC_PRESSURE,
+  METRIC_GAS_RESISTANCE,
+  METRIC_IAQ,
+  METRIC_IAQ_ACCURACY,
+  METRIC_SAMPLE_TIMESTAMP,
+  METRIC_BOOT_COUNT,
+  METRIC_CYCLES,
+  METRIC_CYCLE_DURATION,
+  METRIC_SAMPLING_INTERVAL,
+  METRIC_UPLOADS,
+  METRIC_UPLOAD_FAILURES,
+  METRIC_UPLOADS_SUPPRESSED,
+  METRIC_UPLOAD_LATENCY,
+  METRIC_UPLOAD_BYTES,
+  METRIC_UPLOAD_BYTES_PER_SAMPLE,
+  METRIC_UPLOAD_QUEUE_ENTRIES,
+  METRIC_UPLOAD_QUEUE_CAPACITY,
+  METRIC_UPLOAD_QUEUE_SAMPLES,
+  METRIC_UPLOAD_QUEUE_MERGES,
+  METRIC_UPLOAD_QUEUE_AGE,
+  METRIC_ALERTS,
+  METRIC_ALERT_LATENCY,
+  METRIC_ALERT_WORST_LATENCY,
+  METRIC_SENSOR_READ,
+  METRIC_SENSOR_READ_FAILURES,
+  METRIC_SENSOR_READ_RETRIES,
+  METRIC_SENSOR_OUTLIERS,
+  METRIC_SD_APPEND,
+  METRIC_SD_WORST_APPEND,
+  METRIC_HEAP_FREE,
+  METRIC_LOG_DROPPED,
+  METRIC_UPTIME,
+  METRIC_WIFI_CONNECT,
+  METRIC_WIFI_DIRECTED_CONNECTS,
+  METRIC_WIFI_SCAN_CONNECTS,
+  METRIC_AIO_HANDSHAKES,
+  METRIC_AIO_SESSION_DROPS,
+  METRIC_AIO_CONNECT,
+  METRIC_WIFI_CONNECTED,
+  METRIC_WIFI_RSSI,
+  METRIC_COUNT
+} metric_t;
+
+typedef struct {
+  const char *name;
+  const char *type;
+  const char *help;
+  uint8_t decimals;  // METRICS_INTEGER for integer values
+} metrics_field_t;
+
+// In metric_t order
+static const metrics_field_t fields[] = {
+    {"eprobe_temperature_celsius", "gauge", "Air temperature.", 2},
+    {"eprobe_humidity_percent", "gauge", "Relative humidity.", 2},
+    {"eprobe_pressure_hpa", "gauge", "Barometric pressure.", 2},
+    {"eprobe_gas_resistance_ohms", "gauge", "Resistance of the gas sensor.",
+     0},
+    {"eprobe_iaq", "gauge", "Indoor air quality index 0-500.", 0},
+    {"eprobe_iaq_accuracy", "gauge",
+     "Accuracy of the air quality index 0-3.", METRICS_INTEGER},
+    {"eprobe_sample_timestamp_seconds", "gauge", "Time the sample was taken.",
+     METRICS_INTEGER},
+    {"eprobe_boot_count", "gauge", "Boots since power on.", METRICS_INTEGER},
+    {"eprobe_cycles_total", "counter", "Measure cycles since boot.",
+     METRICS_INTEGER},
+    {"eprobe_cycle_duration_ms", "gauge",
+     "Duration of the last measure cycle.", METRICS_INTEGER},
+    {"eprobe_sampling_interval_ms", "gauge",
+     "Interval until the next measure cycle.", METRICS_INTEGER},
+    {"eprobe_uploads_total", "counter", "Feed values sent to Adafruit IO.",
+     METRICS_INTEGER},
+    {"eprobe_upload_failures_total", "counter",
+     "Feed values Adafruit IO did not accept.", METRICS_INTEGER},
+    {"eprobe_uploads_suppressed_total", "counter",
+     "Feed values within the deadband or swinging door.", METRICS_INTEGER},
+    {"eprobe_upload_latency_ms", "gauge",
+     "Time from the sample to the end of its upload.", METRICS_INTEGER},
+    {"eprobe_upload_bytes_total", "counter", "MQTT bytes of the uploads.",
+     METRICS_INTEGER},
+    {"eprobe_upload_bytes_per_sample", "gauge",
+     "MQTT upload bytes per sample.", 1},
+    {"eprobe_upload_queue_entries", "gauge",
+     "Entries waiting in the upload queue.", METRICS_INTEGER},
+    {"eprobe_upload_queue_capacity", "gauge",
+     "Entries the upload queue holds before merging.", METRICS_INTEGER},
+    {"eprobe_upload_queue_samples", "gauge",
+     "Samples in the upload queue, merged ones included.", METRICS_INTEGER},
+    {"eprobe_upload_queue_merges_total", "counter",
+     "Upload queue entries merged into aggregates.", METRICS_INTEGER},
+    {"eprobe_upload_queue_age_seconds", "gauge",
+     "Age of the oldest sample in the upload queue.", METRICS_INTEGER},
+    {"eprobe_alerts_total", "counter", "Alerts sent to Adafruit IO.",
+     METRICS_INTEGER},
+    {"eprobe_alert_latency_ms", "gauge",
+     "Time from the sample to the last alert sent.", METRICS_INTEGER},
+    {"eprobe_alert_latency_worst_ms", "gauge",
+     "Worst time from a sample to its alert.", METRICS_INTEGER},
+    {"eprobe_sensor_read_us", "gauge",
+     "Time taken to read the sensor in the last cycle.", METRICS_INTEGER},
+    {"eprobe_sensor_read_failures_total", "counter",
+     "Sensor readings that failed after all retries.", METRICS_INTEGER},
+    {"eprobe_sensor_read_retries_total", "counter", "Retried sensor readings.",
+     METRICS_INTEGER},
+    {"eprobe_sensor_outliers_total", "counter",
+     "Burst readings rejected as outliers.", METRICS_INTEGER},
+    {"eprobe_sd_append_us", "gauge", "Latency of the last datalog append.",
+     METRICS_INTEGER},
+    {"eprobe_sd_append_worst_us", "gauge",
+     "Worst datalog append latency of the segment.", METRICS_INTEGER},
+    {"eprobe_heap_free_bytes", "gauge", "Free heap.", METRICS_INTEGER},
+    {"eprobe_log_dropped_total", "counter", "Serial log records dropped.",
+     METRICS_INTEGER},
+    {"eprobe_uptime_seconds", "gauge", "Time since boot.", METRICS_INTEGER},
+    {"eprobe_wifi_connect_ms", "gauge", "Time taken by the last WiFi connect.",
+     METRICS_INTEGER},
+    {"eprobe_wifi_connects_directed_total", "counter",
+     "WiFi connects to the cached access point.", METRICS_INTEGER},
+    {"eprobe_wifi_connects_scan_total", "counter",
+     "WiFi connects with a full scan.", METRICS_INTEGER},
+    {"eprobe_aio_handshakes_total", "counter",
+     "TLS and MQTT handshakes with Adafruit IO.", METRICS_INTEGER},
+    {"eprobe_aio_session_drops_total", "counter",
+     "Adafruit IO sessions found down.", METRICS_INTEGER},
+    {"eprobe_aio_connect_ms", "gauge",
+     "Time taken by the last Adafruit IO handshake.", METRICS_INTEGER},
+    {"eprobe_wifi_connected", "gauge", "1 if WiFi is connected.",
+     METRICS_INTEGER},
+    {"eprobe_wifi_rssi_dbm", "gauge", "WiFi signal strength.",
+     METRICS_INTEGER},
+};
+
+static_assert(sizeof(fields) / sizeof(fields[0]) == METRIC_COUNT,
+              "Every metric needs a field");
+
+static const char *LOG_TAG = "Metrics";
+
+static char buffers[2][METRICS_TEXT_LEN];
+static size_t length = 0;  // both buffers share the layout
+static uint16_t valueOffsets[METRIC_COUNT];
+static std::atomic<int8_t> published(-1);
+static std::atomic<uint8_t> readers[2];
+static uint32_t bootCount = 0;
+
+void metrics_setBootCount(uint32_t count) { bootCount = count; }
+
+/*
+ Writes the help, type and name of every metric once, each followed by a
+ blank value field. Later publishes only overwrite the value fields.
+*/
+static bool metrics_renderLayout() {
+  char *text = buffers[0];
+  for (int i = 0; i < METRIC_COUNT; i++) {
+    const metrics_field_t &f = fields[i];
+    size_t available = METRICS_TEXT_LEN - length;
+    int n = snprintf(text + length, available,
+                     "# HELP %s %s\n# TYPE %s %s\n%s %*s\n", f.name, f.help,
+                     f.name, f.type, f.name, METRICS_VALUE_WIDTH, "");
+    if (n < 0 || (size_t)n >= available) {
+      ESP_LOGE(LOG_TAG, "No room for metric %s", f.name);
+      length = 0;
+      return false;
+    }
+    length += n;
+    valueOffsets[i] = (uint16_t)(length - 1 - METRICS_VALUE_WIDTH);
+  }
+  memcpy(buffers[1], buffers[0], length);
+  return true;
+}
+
+// Right aligns the value in its field, NaN marks a value that is not known
+static void metrics_patch(char *text, int metric, double value) {
+  char digits[METRICS_VALUE_WIDTH + 1];
+  uint8_t decimals = fields[metric].decimals;
+  int n;
+  if (std::isnan(value)) {
+    n = snprintf(digits, sizeof(digits), "NaN");
+  } else {
+    n = fixfmt_formatDouble(digits, sizeof(digits), value,
+                            decimals == METRICS_INTEGER ? 0 : decimals);
+  }
+  if (n < 0 || n > METRICS_VALUE_WIDTH) {
+    n = snprintf(digits, sizeof(digits), "NaN");
+  }
+
+  char *field = text + valueOffsets[metric];
+  memset(field, ' ', METRICS_VALUE_WIDTH - n);
+  memcpy(field + METRICS_VALUE_WIDTH - n, digits, n);
+}
+
+void metrics_publish(const metrics_snapshot_t &s) {
+  if (length == 0 && !metrics_renderLayout()) {
+    return;
+  }
+  uint8_t back = published.load() == 0 ? 1 : 0;
+  if (readers[back].load() != 0) {
+    ESP_LOGD(LOG_TAG, "Metrics buffer busy, skipping update");
+    return;
+  }
+
+  double v[METRIC_COUNT];
+  v[METRIC_TEMPERATURE] = s.sampleValid ? s.sample.temperature : NAN;
+  v[METRIC_HUMIDITY] = s.sampleValid ? s.sample.humidity : NAN;
+  v[METRIC_PRESSURE] = s.sampleValid ? s.sample.pressure / 100.0 : NAN;
+  v[METRIC_GAS_RESISTANCE] = s.sampleValid ? s.sample.airquality : NAN;
+  v[METRIC_IAQ] = s.sampleValid ? s.sample.iaq : NAN;
+  v[METRIC_IAQ_ACCURACY] = s.sampleValid ? s.sample.iaqAccuracy : NAN;
+  v[METRIC_SAMPLE_TIMESTAMP] =
+      s.sampleValid ? (double)s.sample.acquiringTime : NAN;
+  v[METRIC_BOOT_COUNT] = bootCount;
+  v[METRIC_CYCLES] = s.cycleCounter;
+  v[METRIC_CYCLE_DURATION] = s.cycleMillis;
+  v[METRIC_SAMPLING_INTERVAL] = s.samplingIntervalMs;
+  v[METRIC_UPLOADS] = s.uploadsSent;
+  v[METRIC_UPLOAD_FAILURES] = s.uploadFailures;
+  v[METRIC_UPLOADS_SUPPRESSED] = s.uploadsSuppressed;
+  v[METRIC_UPLOAD_LATENCY] = s.uploadLatencyMs;
+  v[METRIC_UPLOAD_BYTES] = s.uploadBytes;
+  v[METRIC_UPLOAD_BYTES_PER_SAMPLE] =
+      s.uploadSamples > 0 ? (double)s.uploadBytes / s.uploadSamples : NAN;
+  v[METRIC_UPLOAD_QUEUE_ENTRIES] = s.uploadQueueEntries;
+  v[METRIC_UPLOAD_QUEUE_CAPACITY] = UPLOAD_QUEUE_LEN;
+  v[METRIC_UPLOAD_QUEUE_SAMPLES] = s.uploadQueueSamples;
+  v[METRIC_UPLOAD_QUEUE_MERGES] = s.uploadQueueMerges;
+  v[METRIC_UPLOAD_QUEUE_AGE] = s.uploadQueueAgeSeconds;
+  v[METRIC_ALERTS] = s.alertsSent;
+  v[METRIC_ALERT_LATENCY] = s.alertLatencyMs;
+  v[METRIC_ALERT_WORST_LATENCY] = s.alertWorstLatencyMs;
+  v[METRIC_SENSOR_READ] = s.sensorReadMicros;
+  v[METRIC_SENSOR_READ_FAILURES] = s.sensorReadFailures;
+  v[METRIC_SENSOR_READ_RETRIES] = s.sensorReadRetries;
+  v[METRIC_SENSOR_OUTLIERS] = s.sensorOutliers;
+  v[METRIC_SD_APPEND] = s.sdAppendMicros;
+  v[METRIC_SD_WORST_APPEND] = s.sdWorstAppendMicros;
+  v[METRIC_HEAP_FREE] = s.heapFree;
+  v[METRIC_LOG_DROPPED] = s.logDropped;
+  v[METRIC_UPTIME] = s.uptimeSeconds;
+  v[METRIC_WIFI_CONNECT] = s.wifiConnectMs;
+  v[METRIC_WIFI_DIRECTED_CONNECTS] = s.wifiDirectedConnects;
+  v[METRIC_WIFI_SCAN_CONNECTS] = s.wifiScanConnects;
+  v[METRIC_AIO_HANDSHAKES] = s.aioHandshakes;
+  v[METRIC_AIO_SESSION_DROPS] = s.aioSessionDrops;
+  v[METRIC_AIO_CONNECT] = s.aioConnectMs;
+  v[METRIC_WIFI_CONNECTED] = s.wifiConnected;
+  v[METRIC_WIFI_RSSI] = s.wifiConnected ? s.wifiRssi : NAN;
+
+  for (int i = 0; i < METRIC_COUNT; i++) {
+    metrics_patch(buffers[back], i, v[i]);
+  }
+  published.store(back);
+}
+
+bool metrics_acquire(metrics_view_t *view) {
+  while (1) {
+    int8_t front = published.load();
+    if (front < 0) {
+      return false;
+    }
+    readers[front]++;
+    // The writer may have swapped buffers in between, pin the new one then
+    if (published.load() == front) {
+      view->text = buffers[front];
+      view->length = length;
+      view->buffer = front;
+      return true;
+    }
+    readers[front]--;
+  }
+}
+
+void metrics_release(const metrics_view_t &view) { readers[view.buffer]--; }
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sync_measure.h"
+
+#define METRICS_TEXT_LEN 8192
+
+/*
+ Prometheus text exposition of the latest readings and health counters. The
+ help, type and name lines are rendered once into both halves of a static
+ double buffer. Every cycle the measure loop only overwrites the fixed width
+ value fields of the back half and then publishes it, so a scrape is a
+ single send of ready-made bytes without formatting or allocation. Values
+ that are not known, like the readings before the first valid sample, are
+ NaN. A buffer that is still being sent is never rewritten; the update is
+ then skipped until the next cycle.
+*/
+typedef struct {
+  bme680_sensor_data_t sample;
+  bool sampleValid;
+  uint32_t cycleCounter;
+  uint32_t cycleMillis;
+  uint32_t samplingIntervalMs;
+  uint32_t uploadsSent;
+  uint32_t uploadFailures;
+  uint32_t uploadsSuppressed;
+  uint32_t uploadLatencyMs;
+  uint32_t uploadBytes;  // MQTT level, without TCP and TLS
+  uint32_t uploadSamples;
+  uint32_t uploadQueueEntries;
+  uint32_t uploadQueueSamples;
+  uint32_t uploadQueueMerges;
+  uint32_t uploadQueueAgeSeconds;
+  uint32_t alertsSent;
+  uint32_t alertLatencyMs;
+  uint32_t alertWorstLatencyMs;
+  uint32_t sensorReadMicros;
+  uint32_t sensorReadFailures;
+  uint32_t sensorReadRetries;
+  uint32_t sensorOutliers;
+  uint32_t sdAppendMicros;
+  uint32_t sdWorstAppendMicros;
+  uint32_t heapFree;
+  uint32_t logDropped;
+  uint32_t uptimeSeconds;
+  uint32_t wifiConnectMs;
+  uint32_t wifiDirectedConnects;
+  uint32_t wifiScanConnects;
+  uint32_t aioHandshakes;
+  uint32_t aioSessionDrops;
+  uint32_t aioConnectMs;
+  int8_t wifiRssi;
+  bool wifiConnected;
+} metrics_snapshot_t;
+
+typedef struct {
+  const char *text;
+  size_t length;
+  uint8_t buffer;
+} metrics_view_t;
+
+void metrics_setBootCount(uint32_t bootCount);
+void metrics_publish(const metrics_snapshot_t &snapshot);
+// Pins the published text until metrics_release(), false before the first
+// publish
+bool metrics_acquire(metrics_view_t *view);
+void metrics_release(const metrics_view_t &view);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,27 @@
+#include "multi_rate.h"
+#include "eprobe.h"
+
+#include <cmath>
+
+bool multirate_gasDue(const multirate_state_t &state, uint32_t time) {
+  // A clock step backwards measures at once rather than stalling
+  return !state.gasStarted || time < state.gasTime ||
+         time - state.gasTime >= MULTIRATE_GAS_INTERVAL_S;
+}
+
+float multirate_addGas(multirate_state_t *state, uint32_t time,
+                       float resistance) {
+  if (std::isnan(resistance) || resistance <= 0) {
+    return state->gasResistance;
+  }
+
+  if (!state->gasStarted) {
+    state->gasResistance = resistance;
+    state->gasStarted = true;
+  } else {
+    state->gasResistance +=
+        (resistance - state->gasResistance) * MULTIRATE_GAS_WEIGHT;
+  }
+  state->gasTime = time;
+  return state->gasResistance;
+}
\ No newline at end of file
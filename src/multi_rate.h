@@ -0,0 +1,38 @@
+#ifndef MULTI_RATE_H
+#define MULTI_RATE_H
+
+#include <cstdint>
+
+// Seconds between gas measurements, override with a build flag
+#ifndef MULTIRATE_GAS_INTERVAL_S
+#define MULTIRATE_GAS_INTERVAL_S 300
+#endif
+// Weight of a new gas reading in the filtered gas series
+#define MULTIRATE_GAS_WEIGHT 0.5f
+
+/*
+ Channel rates of the BME680.
+
+ Temperature, humidity and pressure are read every measure cycle with the
+ gas heater off and the fast sensor configuration, the sensor's IIR filter
+ serving as their anti-alias filter. Gas resistance only needs to be known
+ every few minutes (like the ultra low power mode of Bosch's BSEC), so the
+ heater is fired with the gas configuration only once
+ MULTIRATE_GAS_INTERVAL_S have passed. The gas readings are smoothed with a
+ first order low pass, which also suppresses the scatter of a heater that
+ has been idle, and the filtered value is held between them.
+
+ The state is plain data so it can live in RTC memory across deep sleep.
+*/
+typedef struct {
+  uint32_t gasTime;     // time of the last gas measurement
+  float gasResistance;  // filtered, Ohm
+  bool gasStarted;
+} multirate_state_t;
+
+bool multirate_gasDue(const multirate_state_t &state, uint32_t time);
+// Adds a gas reading and returns the filtered resistance
+float multirate_addGas(multirate_state_t *state, uint32_t time,
+                       float resistance);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include "retention.h"
+#include "eprobe.h"
+
+#include <cmath>
+#include <cstring>
+
+typedef struct {
+  const char *dir;
+  uint32_t period;
+  datalog_t log;
+} retention_tier_state_t;
+
+static const char *LOG_TAG = "Retention";
+
+static retention_tier_state_t tiers[RETENTION_TIER_COUNT] = {
+    {RETENTION_FINE_DIR, RETENTION_FINE_PERIOD_S, {}},
+    {RETENTION_COARSE_DIR, RETENTION_COARSE_PERIOD_S, {}},
+};
+
+static datalog_t *raw;
+
+typedef struct {
+  datalog_t *log;
+  uint32_t first;
+  uint32_t last;
+} retention_range_t;
+
+// Scans the first and the last aggregate of the log
+static bool retention_rangeVisitor(uint32_t segment, void *context) {
+  retention_range_t *range = (retention_range_t *)context;
+  char path[DATALOG_PATH_LEN];
+  datalog_segmentPath(range->log, segment, path, sizeof(path));
+  File file = range->log->fs->open(path, FILE_READ);
+  if (!file) {
+    return true;
+  }
+
+  datalog_segment_header_t header;
+  datalog_record_t record;
+  uint8_t payload[DATALOG_MAX_PAYLOAD];
+  uint32_t offset = DATALOG_SEGMENT_HEADER_LEN;
+  if (datalog_readSegmentHeader(file, &header)) {
+    while (offset < header.end &&
+           datalog_readRecord(file, offset, &record, payload)) {
+      offset += DATALOG_HEADER_LEN + record.length + DATALOG_CRC_LEN;
+      if (record.type != DATALOG_RECORD_AGGREGATE ||
+          record.length != sizeof(aggregate_record_t)) {
+        continue;
+      }
+      aggregate_record_t aggregate;
+      memcpy(&aggregate, payload, sizeof(aggregate));
+      if (range->first == 0 || aggregate.start < range->first) {
+        range->first = aggregate.start;
+      }
+      if (aggregate.start + aggregate.period > range->last) {
+        range->last = aggregate.start + aggregate.period;
+      }
+    }
+  }
+  file.close();
+  return true;
+}
+
+void retention_setup(fs::FS &fs, datalog_t *journal,
+                     retention_state_t *state) {
+  raw = journal;
+  for (int i = 0; i < RETENTION_TIER_COUNT; i++) {
+    datalog_open(&tiers[i].log, fs, tiers[i].dir, true);
+  }
+
+  // A wakeup from deep sleep still knows the range
+  if (state->coveredTo != 0) {
+    return;
+  }
+  retention_range_t range = {&tiers[RETENTION_TIER_COARSE].log, 0, 0};
+  if (range.log->mounted) {
+    datalog_forEachSegment(range.log, retention_rangeVisitor, &range);
+  }
+  state->coveredFrom = range.first;
+  state->coveredTo = range.last;
+  ESP_LOGI(LOG_TAG, "Hourly aggregates cover %u to %u",
+           (unsigned)state->coveredFrom, (unsigned)state->coveredTo);
+}
+
+datalog_t *retention_tierLog(retention_tier_t tier) {
+  return &tiers[tier].log;
+}
+
+void retention_prepare(uint32_t maxBytes) {
+  for (int i = 0; i < RETENTION_TIER_COUNT; i++) {
+    if (tiers[i].log.mounted && !datalog_prepare(&tiers[i].log, maxBytes)) {
+      return;
+    }
+  }
+}
+
+static void retention_enforce(retention_state_t *state, uint32_t now) {
+  if (raw == nullptr || !raw->mounted || state->coveredFrom == 0) {
+    return;
+  }
+
+  uint32_t rawCutoff = now - RETENTION_RAW_HOURS * 3600;
+  size_t removed = datalog_removeSegments(
+      raw, state->coveredFrom,
+      state->coveredTo < rawCutoff ? state->coveredTo : rawCutoff);
+  datalog_t *fine = &tiers[RETENTION_TIER_FINE].log;
+  if (fine->mounted) {
+    removed += datalog_removeSegments(
+        fine, 0, now - RETENTION_FINE_DAYS * 24 * 3600);
+  }
+  if (removed > 0) {
+    ESP_LOGI(LOG_TAG, "Removed %u expired segments", (unsigned)removed);
+  }
+}
+
+static void retention_flush(retention_state_t *state, int index) {
+  retention_tier_state_t *tier = &tiers[index];
+  const retention_period_t &period = state->periods[index];
+  aggregate_record_t record{};
+  record.start = period.start;
+  record.period = tier->period;
+  for (int c = 0; c < ROLLING_CHANNEL_COUNT; c++) {
+    const retention_accumulator_t &a = period.channels[c];
+    aggregate_channel_t &channel = record.channels[c];
+    channel.count = a.count;
+    channel.min = a.count > 0 ? a.min : NAN;
+    channel.max = a.count > 0 ? a.max : NAN;
+    channel.mean = a.count > 0 ? a.sum / a.count : NAN;
+  }
+
+  if (!tier->log.mounted ||
+      !datalog_append(&tier->log, DATALOG_RECORD_AGGREGATE, &record,
+                      sizeof(record))) {
+    ESP_LOGW(LOG_TAG, "Failed to append aggregate to %s", tier->log.path);
+    return;
+  }
+  if (index == RETENTION_TIER_COARSE) {
+    if (state->coveredFrom == 0) {
+      state->coveredFrom = record.start;
+    }
+    state->coveredTo = record.start + record.period;
+  }
+}
+
+void retention_add(retention_state_t *state,
+                   const bme680_sensor_data_t &sample) {
+  uint32_t time = (uint32_t)sample.acquiringTime;
+  if (time < RETENTION_MIN_VALID_TIME) {
+    return;
+  }
+  float values[ROLLING_CHANNEL_COUNT] = {sample.temperature, sample.humidity,
+                                         sample.pressure / 100.0f,
+                                         sample.flags & SAMPLE_FLAG_GAS_FRESH
+                                             ? sample.airquality / 1000.0f
+                                             : NAN};
+
+  bool hourClosed = false;
+  for (int i = 0; i < RETENTION_TIER_COUNT; i++) {
+    retention_period_t *period = &state->periods[i];
+    uint32_t start = time - time % tiers[i].period;
+    // A clock stepping backwards keeps adding to the open period
+    if (period->start != 0 && start > period->start) {
+      retention_flush(state, i);
+      hourClosed |= i == RETENTION_TIER_COARSE;
+    }
+    if (period->start == 0 || start > period->start) {
+      period->start = start;
+      memset(period->channels, 0, sizeof(period->channels));
+    }
+
+    for (int c = 0; c < ROLLING_CHANNEL_COUNT; c++) {
+      if (std::isnan(values[c])) {
+        continue;
+      }
+      retention_accumulator_t &a = period->channels[c];
+      if (a.count == 0 || values[c] < a.min) {
+        a.min = values[c];
+      }
+      if (a.count == 0 || values[c] > a.max) {
+        a.max = values[c];
+      }
+      a.sum += values[c];
+      a.count++;
+    }
+  }
+
+  if (hourClosed) {
+    retention_enforce(state, time);
+  }
+}
\ No newline at end of file
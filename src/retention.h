@@ -0,0 +1,86 @@
+#ifndef RETENTION_H
+#define RETENTION_H
+
+#include <cstdint>
+
+#include "FS.h"
+#include "datalog.h"
+#include "rolling_stats.h"
+#include "sync_measure.h"
+
+// How long raw samples and 5 minute aggregates are kept, override with a
+// build flag
+#ifndef RETENTION_RAW_HOURS
+#define RETENTION_RAW_HOURS 48
+#endif
+#ifndef RETENTION_FINE_DAYS
+#define RETENTION_FINE_DAYS 90
+#endif
+
+#define RETENTION_FINE_PERIOD_S 300
+#define RETENTION_COARSE_PERIOD_S 3600
+#define RETENTION_FINE_DIR "/agg5m"
+#define RETENTION_COARSE_DIR "/agg1h"
+// Earlier sample times mean the clock has not been set yet
+#define RETENTION_MIN_VALID_TIME 1577836800
+
+/*
+ Tiered retention of the datalog.
+
+ Samples are rolled up into 5 minute and hourly aggregates while they are
+ written, each tier in a datalog of its own. Once an hour is complete, raw
+ segments that lie entirely within the span covered by the hourly tier and
+ are older than RETENTION_RAW_HOURS are removed, as are 5 minute segments
+ older than RETENTION_FINE_DAYS. Hourly aggregates are kept forever, they
+ take about 2 KiB per day.
+*/
+typedef enum {
+  RETENTION_TIER_FINE,
+  RETENTION_TIER_COARSE,
+  RETENTION_TIER_COUNT
+} retention_tier_t;
+
+typedef struct {
+  float min;
+  float max;
+  float mean;
+  uint32_t count;
+} aggregate_channel_t;
+
+// Payload of a DATALOG_RECORD_AGGREGATE record, channels as in rolling_stats.h
+typedef struct {
+  uint32_t start;
+  uint32_t period;
+  aggregate_channel_t channels[ROLLING_CHANNEL_COUNT];
+} aggregate_record_t;
+
+typedef struct {
+  uint32_t count;
+  float min;
+  float max;
+  double sum;
+} retention_accumulator_t;
+
+typedef struct {
+  uint32_t start;  // 0 before the first sample
+  retention_accumulator_t channels[ROLLING_CHANNEL_COUNT];
+} retention_period_t;
+
+// Kept in warmboot_state_t, so the open periods survive deep sleep
+typedef struct {
+  retention_period_t periods[RETENTION_TIER_COUNT];
+  // Raw samples in [coveredFrom, coveredTo) are part of the hourly tier
+  uint32_t coveredFrom;
+  uint32_t coveredTo;
+} retention_state_t;
+
+// The tier segments are only created once the first aggregate is written
+void retention_setup(fs::FS &fs, datalog_t *journal, retention_state_t *state);
+void retention_add(retention_state_t *state,
+                   const bme680_sensor_data_t &sample);
+// datalog_prepare() for the first tier whose spare segment is not complete
+void retention_prepare(uint32_t maxBytes);
+// The datalog of a tier, check mounted before use
+datalog_t *retention_tierLog(retention_tier_t tier);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,246 @@
+#include "rolling_stats.h"
+#include "eprobe.h"
+
+#include <cmath>
+#include <cstring>
+
+// Moments of a closed bucket, single precision is plenty for one bucket
+typedef struct {
+  uint16_t count;
+  float mean;
+  float m2;
+  float min;
+  float max;
+} rolling_bucket_t;
+
+typedef struct {
+  uint32_t count;
+  double mean;
+  double m2;
+  float min;
+  float max;
+} rolling_moments_t;
+
+// Fixed capacity FIFO of bucket numbers
+typedef struct {
+  uint32_t numbers[ROLLING_STATS_MAX_BUCKETS];
+  uint8_t head;
+  uint8_t size;
+} rolling_queue_t;
+
+typedef struct {
+  rolling_bucket_t buckets[ROLLING_STATS_MAX_BUCKETS];  // by number % count
+  rolling_queue_t closed;   // closed buckets in the window, oldest first
+  rolling_queue_t minimum;  // bucket numbers with increasing minimum
+  rolling_queue_t maximum;  // bucket numbers with decreasing maximum
+  rolling_moments_t total;  // closed buckets in the window, min/max unused
+  rolling_moments_t open;
+  uint32_t openBucket;
+  bool started;
+} rolling_series_t;
+
+typedef struct {
+  const char *name;
+  uint32_t bucketSeconds;
+  uint8_t bucketCount;
+  rolling_series_t series[ROLLING_CHANNEL_COUNT];
+} rolling_window_stats_t;
+
+static rolling_window_stats_t windows[ROLLING_WINDOW_COUNT] = {
+    {"1h", ROLLING_STATS_SHORT_BUCKET_S, ROLLING_STATS_SHORT_BUCKETS, {}},
+    {"24h", ROLLING_STATS_LONG_BUCKET_S, ROLLING_STATS_LONG_BUCKETS, {}},
+};
+
+static const char *channelNames[ROLLING_CHANNEL_COUNT] = {
+    "temperature", "humidity", "pressure", "airquality"};
+
+const char *rollingstats_windowName(rolling_window_t window) {
+  return windows[window].name;
+}
+
+const char *rollingstats_channelName(rolling_channel_t channel) {
+  return channelNames[channel];
+}
+
+static uint32_t rollingstats_queueAt(const rolling_queue_t &q, uint8_t i) {
+  return q.numbers[(q.head + i) % ROLLING_STATS_MAX_BUCKETS];
+}
+
+static uint32_t rollingstats_queueBack(const rolling_queue_t &q) {
+  return rollingstats_queueAt(q, q.size - 1);
+}
+
+static void rollingstats_queuePush(rolling_queue_t *q, uint32_t number) {
+  q->numbers[(q->head + q->size) % ROLLING_STATS_MAX_BUCKETS] = number;
+  q->size++;
+}
+
+static void rollingstats_queuePopFront(rolling_queue_t *q) {
+  q->head = (q->head + 1) % ROLLING_STATS_MAX_BUCKETS;
+  q->size--;
+}
+
+// Chan et al. parallel combination of two sets of moments
+static void rollingstats_merge(rolling_moments_t *a, uint32_t count,
+                               double mean, double m2) {
+  if (count == 0) {
+    return;
+  }
+  uint32_t n = a->count + count;
+  double delta = mean - a->mean;
+  a->mean += delta * count / n;
+  a->m2 += m2 + delta * delta * a->count * count / n;
+  a->count = n;
+}
+
+// Inverse of rollingstats_merge
+static void rollingstats_remove(rolling_moments_t *a,
+                                const rolling_bucket_t &b) {
+  if (b.count >= a->count) {
+    memset(a, 0, sizeof(*a));
+    return;
+  }
+  uint32_t n = a->count - b.count;
+  double mean = (a->count * a->mean - b.count * (double)b.mean) / n;
+  double delta = b.mean - mean;
+  a->m2 -= b.m2 + delta * delta * n * b.count / a->count;
+  if (a->m2 < 0) {
+    a->m2 = 0;
+  }
+  a->mean = mean;
+  a->count = n;
+}
+
+static rolling_bucket_t &rollingstats_bucket(rolling_window_stats_t *w,
+                                             rolling_series_t *s,
+                                             uint32_t number) {
+  return s->buckets[number % w->bucketCount];
+}
+
+static void rollingstats_closeBucket(rolling_window_stats_t *w,
+                                     rolling_series_t *s) {
+  if (s->open.count == 0) {
+    return;
+  }
+
+  uint32_t number = s->openBucket;
+  rolling_bucket_t &bucket = rollingstats_bucket(w, s, number);
+  bucket.count = s->open.count;
+  bucket.mean = s->open.mean;
+  bucket.m2 = s->open.m2;
+  bucket.min = s->open.min;
+  bucket.max = s->open.max;
+
+  rollingstats_queuePush(&s->closed, number);
+  rollingstats_merge(&s->total, bucket.count, bucket.mean, bucket.m2);
+
+  while (s->minimum.size > 0 &&
+         rollingstats_bucket(w, s, rollingstats_queueBack(s->minimum)).min >=
+             bucket.min) {
+    s->minimum.size--;
+  }
+  rollingstats_queuePush(&s->minimum, number);
+  while (s->maximum.size > 0 &&
+         rollingstats_bucket(w, s, rollingstats_queueBack(s->maximum)).max <=
+             bucket.max) {
+    s->maximum.size--;
+  }
+  rollingstats_queuePush(&s->maximum, number);
+}
+
+// Drops closed buckets numbered up to last
+static void rollingstats_expire(rolling_window_stats_t *w,
+                                rolling_series_t *s, uint32_t last) {
+  while (s->closed.size > 0 && rollingstats_queueAt(s->closed, 0) <= last) {
+    uint32_t oldest = rollingstats_queueAt(s->closed, 0);
+    rollingstats_remove(&s->total, rollingstats_bucket(w, s, oldest));
+    rollingstats_queuePopFront(&s->closed);
+  }
+  while (s->minimum.size > 0 && rollingstats_queueAt(s->minimum, 0) <= last) {
+    rollingstats_queuePopFront(&s->minimum);
+  }
+  while (s->maximum.size > 0 && rollingstats_queueAt(s->maximum, 0) <= last) {
+    rollingstats_queuePopFront(&s->maximum);
+  }
+}
+
+static void rollingstats_addValue(rolling_window_stats_t *w,
+                                  rolling_series_t *s, uint32_t time,
+                                  float value) {
+  if (std::isnan(value)) {
+    return;
+  }
+
+  uint32_t number = time / w->bucketSeconds;
+  if (!s->started) {
+    s->started = true;
+    s->openBucket = number;
+  } else if (number > s->openBucket) {
+    rollingstats_closeBucket(w, s);
+    memset(&s->open, 0, sizeof(s->open));
+    s->openBucket = number;
+    if (number >= w->bucketCount) {
+      rollingstats_expire(w, s, number - w->bucketCount);
+    }
+  }
+  // A clock stepping backwards keeps adding to the open bucket
+
+  rolling_moments_t &open = s->open;
+  if (open.count == 0 || value < open.min) {
+    open.min = value;
+  }
+  if (open.count == 0 || value > open.max) {
+    open.max = value;
+  }
+  open.count++;
+  double delta = value - open.mean;
+  open.mean += delta / open.count;
+  open.m2 += delta * (value - open.mean);
+}
+
+void rollingstats_add(const bme680_sensor_data_t &sample) {
+  uint32_t time = (uint32_t)sample.acquiringTime;
+  // Pressure in hPa and air quality in kOhm, like on the panel
+  float values[ROLLING_CHANNEL_COUNT] = {sample.temperature, sample.humidity,
+                                         sample.pressure / 100.0f,
+                                         sample.flags & SAMPLE_FLAG_GAS_FRESH
+                                             ? sample.airquality / 1000.0f
+                                             : NAN};
+
+  for (int i = 0; i < ROLLING_WINDOW_COUNT; i++) {
+    for (int c = 0; c < ROLLING_CHANNEL_COUNT; c++) {
+      rollingstats_addValue(&windows[i], &windows[i].series[c], time,
+                            values[c]);
+    }
+  }
+}
+
+bool rollingstats_summary(rolling_window_t window, rolling_channel_t channel,
+                          rolling_summary_t *summary) {
+  rolling_window_stats_t *w = &windows[window];
+  rolling_series_t *s = &w->series[channel];
+
+  rolling_moments_t all = s->total;
+  rollingstats_merge(&all, s->open.count, s->open.mean, s->open.m2);
+  if (all.count == 0) {
+    return false;
+  }
+
+  float min = s->open.min;
+  float max = s->open.max;
+  if (s->minimum.size > 0) {
+    min = rollingstats_bucket(w, s, rollingstats_queueAt(s->minimum, 0)).min;
+    max = rollingstats_bucket(w, s, rollingstats_queueAt(s->maximum, 0)).max;
+  }
+  if (s->open.count > 0 && s->minimum.size > 0) {
+    min = fminf(min, s->open.min);
+    max = fmaxf(max, s->open.max);
+  }
+
+  summary->count = all.count;
+  summary->min = min;
+  summary->max = max;
+  summary->mean = all.mean;
+  summary->stddev = all.count > 1 ? sqrt(all.m2 / (all.count - 1)) : 0.0f;
+  return true;
+}
\ No newline at end of file
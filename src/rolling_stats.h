@@ -0,0 +1,59 @@
+#ifndef ROLLING_STATS_H
+#define ROLLING_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sync_measure.h"
+
+// Windows are split into time buckets: 1 h of 1 min and 24 h of 30 min
+#define ROLLING_STATS_SHORT_BUCKET_S 60
+#define ROLLING_STATS_SHORT_BUCKETS 60
+#define ROLLING_STATS_LONG_BUCKET_S 1800
+#define ROLLING_STATS_LONG_BUCKETS 48
+#define ROLLING_STATS_MAX_BUCKETS 60
+
+/*
+ Rolling min, max, mean and standard deviation over the last hour and day.
+
+ Each window is a ring of time buckets that keep count, mean and M2 (Welford)
+ plus min and max of their samples. Adding a sample only updates the open
+ bucket. When a bucket closes it is merged into the window aggregate with
+ Chan's parallel formula and the bucket falling out of the window is
+ subtracted again, while monotonic deques of bucket numbers track the
+ window min and max. Every operation is O(1) per sample and everything lives
+ in static memory. The open bucket is included in the summaries.
+
+ At about 16 KB the windows do not fit into the 8 KB of RTC slow memory, so
+ unlike the warm boot state they start over on every wakeup from deep sleep.
+*/
+typedef enum {
+  ROLLING_WINDOW_1H,
+  ROLLING_WINDOW_24H,
+  ROLLING_WINDOW_COUNT
+} rolling_window_t;
+
+typedef enum {
+  ROLLING_CHANNEL_TEMPERATURE,
+  ROLLING_CHANNEL_HUMIDITY,
+  ROLLING_CHANNEL_PRESSURE,
+  ROLLING_CHANNEL_AIRQUALITY,
+  ROLLING_CHANNEL_COUNT
+} rolling_channel_t;
+
+typedef struct {
+  uint32_t count;
+  float min;
+  float max;
+  float mean;
+  float stddev;
+} rolling_summary_t;
+
+void rollingstats_add(const bme680_sensor_data_t &sample);
+// False while the window holds no samples
+bool rollingstats_summary(rolling_window_t window, rolling_channel_t channel,
+                          rolling_summary_t *summary);
+const char *rollingstats_windowName(rolling_window_t window);
+const char *rollingstats_channelName(rolling_channel_t channel);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "sample_frame.h"
+#include "eprobe.h"
+
+#include <cstdio>
+
+#include "ObjectPool.h"
+#include "fixed_format.h"
+#include "system_time.h"
+
+#define FORMATTED_TIME (1 << SAMPLE_VALUE_COUNT)
+#define FORMATTED_DATALOG_LINE (1 << (SAMPLE_VALUE_COUNT + 1))
+
+#define isFormatted(frame, bit) (((frame)->formatted & (bit)) != 0)
+
+static const char *LOG_TAG = "SampleFrame";
+
+static ObjectPool<sample_frame_t, SAMPLE_FRAME_POOL_SIZE> framePool;
+
+sample_frame_t *sampleframe_acquire(const bme680_sensor_data_t &data,
+                                    uint16_t cycle) {
+  sample_frame_t *frame = framePool.acquire();
+  if (frame == nullptr) {
+    ESP_LOGE(LOG_TAG, "Sample frame pool exhausted");
+    return nullptr;
+  }
+
+  frame->data = data;
+  frame->cycle = cycle;
+  frame->formatted = 0;
+  return frame;
+}
+
+void sampleframe_release(sample_frame_t *frame) { framePool.release(frame); }
+
+const char *sampleframe_value(sample_frame_t *frame, sample_value_t value) {
+  char *buf = frame->values[value];
+  if (isFormatted(frame, 1 << value)) {
+    return buf;
+  }
+
+  const bme680_sensor_data_t &data = frame->data;
+  bool gasFresh = data.flags & SAMPLE_FLAG_GAS_FRESH;
+  switch (value) {
+    case SAMPLE_VALUE_TEMPERATURE:
+      fixfmt_formatFloat(buf, SAMPLE_VALUE_LEN, data.temperature, 2);
+      break;
+    case SAMPLE_VALUE_HUMIDITY:
+      fixfmt_formatFloat(buf, SAMPLE_VALUE_LEN, data.humidity, 2);
+      break;
+    case SAMPLE_VALUE_PRESSURE:
+      fixfmt_formatDouble(buf, SAMPLE_VALUE_LEN, data.pressure / 100.0, 2);
+      break;
+    case SAMPLE_VALUE_PRESSURE_PA:
+      fixfmt_formatFloat(buf, SAMPLE_VALUE_LEN, data.pressure, 2);
+      break;
+    case SAMPLE_VALUE_AIRQUALITY:
+      fixfmt_formatDouble(buf, SAMPLE_VALUE_LEN, data.airquality / 1000.0, 2,
+                          gasFresh ? "k" : "k*");
+      break;
+    case SAMPLE_VALUE_AIRQUALITY_LOG:
+      if (gasFresh) {
+        fixfmt_formatDouble(buf, SAMPLE_VALUE_LEN, data.airquality / 1000.0,
+                            4);
+      } else {
+        buf[0] = '\0';
+      }
+      break;
+    case SAMPLE_VALUE_AIRQUALITY_OHM:
+      if (gasFresh) {
+        fixfmt_formatFloat(buf, SAMPLE_VALUE_LEN, data.airquality, 2);
+      } else {
+        buf[0] = '\0';
+      }
+      break;
+    default:
+      buf[0] = '\0';
+      break;
+  }
+
+  frame->formatted |= 1 << value;
+  return buf;
+}
+
+const char *sampleframe_timeText(sample_frame_t *frame) {
+  if (!isFormatted(frame, FORMATTED_TIME)) {
+    systime_createCurrentTimeOutput(frame->data.acquiringTime,
+                                    frame->timeText, SAMPLE_TIME_LEN - 1,
+                                    "%c");
+    frame->formatted |= FORMATTED_TIME;
+  }
+  return frame->timeText;
+}
+
+const char *sampleframe_dataLogLine(sample_frame_t *frame) {
+  if (!isFormatted(frame, FORMATTED_DATALOG_LINE)) {
+    snprintf(frame->dataLogLine, SAMPLE_DATALOG_LINE_LEN - 1,
+             "'%s',%s,%s,%s,%s\n", sampleframe_timeText(frame),
+             sampleframe_value(frame, SAMPLE_VALUE_TEMPERATURE),
+             sampleframe_value(frame, SAMPLE_VALUE_HUMIDITY),
+             sampleframe_value(frame, SAMPLE_VALUE_PRESSURE),
+             sampleframe_value(frame, SAMPLE_VALUE_AIRQUALITY_LOG));
+    frame->formatted |= FORMATTED_DATALOG_LINE;
+  }
+  return frame->dataLogLine;
+}
\ No newline at end of file
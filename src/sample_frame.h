@@ -0,0 +1,47 @@
+#ifndef SAMPLE_FRAME_H
+#define SAMPLE_FRAME_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sync_measure.h"
+
+#define SAMPLE_FRAME_POOL_SIZE 2
+#define SAMPLE_VALUE_LEN 16
+#define SAMPLE_TIME_LEN 64
+#define SAMPLE_DATALOG_LINE_LEN 129
+
+// Text representations of a sample, formatted on first use and cached in the
+// frame so that every sink (display, serial, datalog, upload) shares them.
+// Numbers are formatted with the integer based fixfmt_ formatter. Between gas
+// measurements the sample carries the last gas resistance; it is then marked
+// with a '*' for display and left empty in the datalog.
+typedef enum {
+  SAMPLE_VALUE_TEMPERATURE,     // "%.2f" degree celsius
+  SAMPLE_VALUE_HUMIDITY,        // "%.2f" percent
+  SAMPLE_VALUE_PRESSURE,        // "%.2f" hPa
+  SAMPLE_VALUE_PRESSURE_PA,     // "%.2f" Pa
+  SAMPLE_VALUE_AIRQUALITY,      // "%.2fk" kOhm, "%.2fk*" if held
+  SAMPLE_VALUE_AIRQUALITY_LOG,  // "%.4f" kOhm, empty if held
+  SAMPLE_VALUE_AIRQUALITY_OHM,  // "%.2f" Ohm, empty if held
+  SAMPLE_VALUE_COUNT
+} sample_value_t;
+
+typedef struct {
+  bme680_sensor_data_t data;
+  uint16_t cycle;
+  uint16_t formatted;  // bitmask of cached representations
+  char values[SAMPLE_VALUE_COUNT][SAMPLE_VALUE_LEN];
+  char timeText[SAMPLE_TIME_LEN];
+  char dataLogLine[SAMPLE_DATALOG_LINE_LEN];
+} sample_frame_t;
+
+sample_frame_t *sampleframe_acquire(const bme680_sensor_data_t &data,
+                                    uint16_t cycle);
+void sampleframe_release(sample_frame_t *frame);
+
+const char *sampleframe_value(sample_frame_t *frame, sample_value_t value);
+const char *sampleframe_timeText(sample_frame_t *frame);
+const char *sampleframe_dataLogLine(sample_frame_t *frame);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "sample_history.h"
+#include "eprobe.h"
+
+#include <Arduino.h>
+
+static portMUX_TYPE historyMux = portMUX_INITIALIZER_UNLOCKED;
+static sample_history_t *history;
+
+void samplehistory_setup(sample_history_t *state) {
+  portENTER_CRITICAL(&historyMux);
+  history = state;
+  portEXIT_CRITICAL(&historyMux);
+}
+
+void samplehistory_add(const bme680_sensor_data_t &data) {
+  portENTER_CRITICAL(&historyMux);
+  if (history != nullptr) {
+    history->samples[history->count % SAMPLE_HISTORY_SIZE] = data;
+    history->count++;
+  }
+  portEXIT_CRITICAL(&historyMux);
+}
+
+size_t samplehistory_latest(bme680_sensor_data_t *samples, size_t count) {
+  portENTER_CRITICAL(&historyMux);
+  size_t available = 0;
+  if (history != nullptr) {
+    available = history->count < SAMPLE_HISTORY_SIZE ? history->count
+                                                     : SAMPLE_HISTORY_SIZE;
+  }
+  if (count > available) {
+    count = available;
+  }
+  for (size_t i = 0; i < count; i++) {
+    samples[i] = history->samples[(history->count - count + i) %
+                                  SAMPLE_HISTORY_SIZE];
+  }
+  portEXIT_CRITICAL(&historyMux);
+  return count;
+}
\ No newline at end of file
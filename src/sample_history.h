@@ -0,0 +1,26 @@
+#ifndef SAMPLE_HISTORY_H
+#define SAMPLE_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sync_measure.h"
+
+#define SAMPLE_HISTORY_SIZE 64
+
+/*
+ The most recent samples, written by the measure loop and read by the
+ network tasks on the other core. Both sides copy under a spinlock. The
+ state is kept in the warm boot state so it survives deep sleep.
+*/
+typedef struct {
+  bme680_sensor_data_t samples[SAMPLE_HISTORY_SIZE];
+  uint32_t count;  // samples added since the cold boot
+} sample_history_t;
+
+void samplehistory_setup(sample_history_t *state);
+void samplehistory_add(const bme680_sensor_data_t &data);
+// Copies up to count of the latest samples, oldest first
+size_t samplehistory_latest(bme680_sensor_data_t *samples, size_t count);
+
+#endif
\ No newline at end of file
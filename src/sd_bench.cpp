@@ -0,0 +1,221 @@
+#include "sd_bench.h"
+#include "eprobe.h"
+
+#include <Arduino.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#define SDBENCH_APPEND_LINE "'Mon Jan  1 00:00:00 2018',21.50,45.20,1013.25,52.41\n"
+
+static const char *LOG_TAG = "SdBench";
+
+typedef struct {
+  fs::FS *fs;
+  const char *path;
+  uint8_t *buf;
+  uint32_t *samples;
+  uint32_t random;
+  sdbench_report_t report;
+} sdbench_context_t;
+
+const char *sdbench_testName(sdbench_test_t test) {
+  switch (test) {
+    case SDBENCH_SEQUENTIAL_WRITE:
+      return "seq write";
+    case SDBENCH_SEQUENTIAL_READ:
+      return "seq read";
+    case SDBENCH_RANDOM_WRITE:
+      return "rand write";
+    case SDBENCH_RANDOM_READ:
+      return "rand read";
+    case SDBENCH_OPEN_CLOSE:
+      return "open/close";
+    case SDBENCH_APPEND:
+      return "append";
+  }
+  return "?";
+}
+
+float sdbench_megabytesPerSecond(const sdbench_result_t &result) {
+  if (result.totalMicros == 0) {
+    return 0.0f;
+  }
+  return (float)result.bytes / (float)result.totalMicros;
+}
+
+// xorshift32, good enough to spread the offsets of the random tests
+static uint32_t sdbench_random(sdbench_context_t *ctx) {
+  uint32_t x = ctx->random;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  ctx->random = x;
+  return x;
+}
+
+static void sdbench_report(sdbench_context_t *ctx, sdbench_test_t test,
+                           uint32_t blockSize, uint32_t ops, uint32_t bytes,
+                           uint32_t totalMicros) {
+  sdbench_result_t result = {test, blockSize, ops, bytes, totalMicros, 0, 0, 0};
+
+  if (ops > 0) {
+    std::sort(ctx->samples, ctx->samples + ops);
+    result.p50Micros = ctx->samples[(ops - 1) / 2];
+    result.p99Micros = ctx->samples[(ops * 99 - 1) / 100];
+    result.maxMicros = ctx->samples[ops - 1];
+  }
+  ctx->report(result);
+}
+
+static uint32_t sdbench_opsFor(uint32_t blockSize, uint32_t fileSize) {
+  uint32_t ops = fileSize / blockSize;
+  return ops < SDBENCH_MAX_OPS ? ops : SDBENCH_MAX_OPS;
+}
+
+/*
+ Writes a new file block by block, so the timing includes the cluster
+ allocation of a growing file.
+*/
+static uint32_t sdbench_sequentialWrite(sdbench_context_t *ctx,
+                                        uint32_t blockSize) {
+  uint32_t ops = sdbench_opsFor(blockSize, SDBENCH_FILE_SIZE);
+  uint32_t start = micros();
+  File file = ctx->fs->open(ctx->path, FILE_WRITE);
+  if (!file) {
+    ESP_LOGE(LOG_TAG, "Failed to open %s for writing", ctx->path);
+    return 0;
+  }
+
+  uint32_t i;
+  for (i = 0; i < ops; i++) {
+    uint32_t opStart = micros();
+    if (file.write(ctx->buf, blockSize) != blockSize) {
+      break;
+    }
+    ctx->samples[i] = micros() - opStart;
+  }
+  file.close();
+
+  sdbench_report(ctx, SDBENCH_SEQUENTIAL_WRITE, blockSize, i, i * blockSize,
+                 micros() - start);
+  return i * blockSize;
+}
+
+static void sdbench_sequentialRead(sdbench_context_t *ctx, uint32_t blockSize,
+                                   uint32_t fileSize) {
+  uint32_t ops = sdbench_opsFor(blockSize, fileSize);
+  uint32_t start = micros();
+  File file = ctx->fs->open(ctx->path, FILE_READ);
+  if (!file) {
+    ESP_LOGE(LOG_TAG, "Failed to open %s for reading", ctx->path);
+    return;
+  }
+
+  uint32_t i;
+  for (i = 0; i < ops; i++) {
+    uint32_t opStart = micros();
+    if (file.read(ctx->buf, blockSize) != blockSize) {
+      break;
+    }
+    ctx->samples[i] = micros() - opStart;
+  }
+  file.close();
+
+  sdbench_report(ctx, SDBENCH_SEQUENTIAL_READ, blockSize, i, i * blockSize,
+                 micros() - start);
+}
+
+/*
+ Reads or overwrites blocks at random block aligned offsets of the file
+ written before. Each operation includes the seek.
+*/
+static void sdbench_randomAccess(sdbench_context_t *ctx, sdbench_test_t test,
+                                 uint32_t blockSize, uint32_t fileSize) {
+  uint32_t blocks = fileSize / blockSize;
+  uint32_t ops = sdbench_opsFor(blockSize, fileSize);
+  bool write = test == SDBENCH_RANDOM_WRITE;
+  uint32_t start = micros();
+  File file = ctx->fs->open(ctx->path, write ? "r+" : FILE_READ);
+  if (!file || blocks == 0) {
+    ESP_LOGE(LOG_TAG, "Failed to open %s for random access", ctx->path);
+    return;
+  }
+
+  uint32_t i;
+  for (i = 0; i < ops; i++) {
+    uint32_t offset = (sdbench_random(ctx) % blocks) * blockSize;
+    uint32_t opStart = micros();
+    if (!file.seek(offset)) {
+      break;
+    }
+    size_t done = write ? file.write(ctx->buf, blockSize)
+                        : file.read(ctx->buf, blockSize);
+    if (done != blockSize) {
+      break;
+    }
+    ctx->samples[i] = micros() - opStart;
+  }
+  file.close();
+
+  sdbench_report(ctx, test, blockSize, i, i * blockSize, micros() - start);
+}
+
+static void sdbench_openClose(sdbench_context_t *ctx, sdbench_test_t test) {
+  const size_t lineLen = strlen(SDBENCH_APPEND_LINE);
+  bool append = test == SDBENCH_APPEND;
+  uint32_t start = micros();
+
+  uint32_t i;
+  for (i = 0; i < SDBENCH_OPEN_CLOSE_OPS; i++) {
+    uint32_t opStart = micros();
+    File file = ctx->fs->open(ctx->path, append ? FILE_APPEND : FILE_READ);
+    if (!file) {
+      break;
+    }
+    if (append &&
+        file.write((const uint8_t *)SDBENCH_APPEND_LINE, lineLen) != lineLen) {
+      file.close();
+      break;
+    }
+    file.close();
+    ctx->samples[i] = micros() - opStart;
+  }
+
+  sdbench_report(ctx, test, append ? lineLen : 0, i, append ? i * lineLen : 0,
+                 micros() - start);
+}
+
+bool sdbench_run(fs::FS &fs, const char *path, sdbench_report_t report) {
+  sdbench_context_t ctx = {&fs, path, nullptr, nullptr, 0x2545f491, report};
+  ctx.buf = (uint8_t *)malloc(SDBENCH_MAX_BLOCK);
+  ctx.samples = (uint32_t *)malloc(SDBENCH_MAX_OPS * sizeof(uint32_t));
+  if (ctx.buf == nullptr || ctx.samples == nullptr) {
+    ESP_LOGE(LOG_TAG, "Not enough memory for the benchmark");
+    free(ctx.buf);
+    free(ctx.samples);
+    return false;
+  }
+
+  ESP_LOGI(LOG_TAG, "Benchmarking %s", path);
+  for (uint32_t i = 0; i < SDBENCH_MAX_BLOCK; i++) {
+    ctx.buf[i] = (uint8_t)i;
+  }
+
+  for (uint32_t blockSize = SDBENCH_MIN_BLOCK; blockSize <= SDBENCH_MAX_BLOCK;
+       blockSize *= 8) {
+    uint32_t fileSize = sdbench_sequentialWrite(&ctx, blockSize);
+    sdbench_sequentialRead(&ctx, blockSize, fileSize);
+    sdbench_randomAccess(&ctx, SDBENCH_RANDOM_WRITE, blockSize, fileSize);
+    sdbench_randomAccess(&ctx, SDBENCH_RANDOM_READ, blockSize, fileSize);
+  }
+
+  fs.remove(path);
+  sdbench_openClose(&ctx, SDBENCH_APPEND);
+  sdbench_openClose(&ctx, SDBENCH_OPEN_CLOSE);
+  fs.remove(path);
+
+  free(ctx.buf);
+  free(ctx.samples);
+  return true;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef SD_BENCH_H
+#define SD_BENCH_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "FS.h"
+
+#define SDBENCH_FILE_SIZE (256 * 1024)
+#define SDBENCH_MAX_OPS 1024  // latency samples kept per test
+#define SDBENCH_OPEN_CLOSE_OPS 100
+#define SDBENCH_MIN_BLOCK 64
+#define SDBENCH_MAX_BLOCK (32 * 1024)
+
+/*
+ SD card throughput and latency benchmark. Only uses fs::FS and micros(),
+ so the same code runs against SD, SPIFFS or a file backed stand-in on the
+ host. Every test reports the throughput and the p50/p99/max latency of a
+ single operation.
+*/
+typedef enum {
+  SDBENCH_SEQUENTIAL_WRITE,
+  SDBENCH_SEQUENTIAL_READ,
+  SDBENCH_RANDOM_WRITE,
+  SDBENCH_RANDOM_READ,
+  SDBENCH_OPEN_CLOSE,  // open and close only
+  SDBENCH_APPEND,      // open, append a line and close, as appendFile() does
+} sdbench_test_t;
+
+typedef struct {
+  sdbench_test_t test;
+  uint32_t blockSize;
+  uint32_t ops;
+  uint32_t bytes;
+  uint32_t totalMicros;
+  uint32_t p50Micros;
+  uint32_t p99Micros;
+  uint32_t maxMicros;
+} sdbench_result_t;
+
+typedef void (*sdbench_report_t)(const sdbench_result_t &result);
+
+bool sdbench_run(fs::FS &fs, const char *path, sdbench_report_t report);
+const char *sdbench_testName(sdbench_test_t test);
+float sdbench_megabytesPerSecond(const sdbench_result_t &result);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "serial_command.h"
+#include "eprobe.h"
+
+#include <Arduino.h>
+#include <cstring>
+
+#include "Task.h"
+
+#define SERIAL_COMMAND_STACK_SIZE 3072
+
+class SerialCommandTask : public Task {
+ public:
+  SerialCommandTask()
+      : Task("SerialCommand", SERIAL_COMMAND_STACK_SIZE, 1,
+             SERIAL_COMMAND_CORE) {}
+  void run(void *data) override;
+};
+
+static const char *LOG_TAG = "SerialCommand";
+
+static const serial_command_t *commandTable;
+static size_t commandCount;
+static SerialCommandTask commandTask;
+
+void serialcmd_setup(const serial_command_t *commands, size_t count) {
+  ESP_LOGI(LOG_TAG, "Setup serial commands");
+  commandTable = commands;
+  commandCount = count;
+  commandTask.start();
+}
+
+static void serialcmd_printHelp() {
+  Serial.println("Commands:");
+  for (size_t i = 0; i < commandCount; i++) {
+    Serial.printf("  %-10s %s\n", commandTable[i].name, commandTable[i].help);
+  }
+}
+
+static void serialcmd_dispatch(char *line) {
+  char *args = strchr(line, ' ');
+  if (args != nullptr) {
+    *args++ = '\0';
+    while (*args == ' ') {
+      args++;
+    }
+  } else {
+    args = line + strlen(line);
+  }
+
+  for (size_t i = 0; i < commandCount; i++) {
+    if (strcmp(line, commandTable[i].name) == 0) {
+      commandTable[i].handler(args);
+      return;
+    }
+  }
+  if (strcmp(line, "help") != 0) {
+    Serial.printf("Unknown command '%s'\n", line);
+  }
+  serialcmd_printHelp();
+}
+
+void SerialCommandTask::run(void *data) {
+  char line[SERIAL_COMMAND_LINE_LEN];
+  size_t len = 0;
+
+  while (1) {
+    while (Serial.available() > 0) {
+      int c = Serial.read();
+      if (c == '\r' || c == '\n') {
+        if (len > 0) {
+          line[len] = '\0';
+          serialcmd_dispatch(line);
+          len = 0;
+        }
+      } else if (len < SERIAL_COMMAND_LINE_LEN - 1) {
+        line[len++] = (char)c;
+      }
+    }
+    delay(SERIAL_COMMAND_POLL_MS);
+  }
+}
\ No newline at end of file
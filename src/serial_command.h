@@ -0,0 +1,25 @@
+#ifndef SERIAL_COMMAND_H
+#define SERIAL_COMMAND_H
+
+#include <cstddef>
+
+#define SERIAL_COMMAND_LINE_LEN 64
+#define SERIAL_COMMAND_POLL_MS 100
+#define SERIAL_COMMAND_CORE 0
+
+/*
+ Line based commands on the serial console. A low priority task polls the
+ UART, splits each line into the command name and its arguments and calls
+ the matching handler from the table passed to serialcmd_setup(). Handlers
+ run on that task and block further input until they return; work that
+ must not overlap with the measure cycle is handed over to the loop.
+*/
+typedef struct {
+  const char *name;
+  void (*handler)(const char *args);
+  const char *help;
+} serial_command_t;
+
+void serialcmd_setup(const serial_command_t *commands, size_t count);
+
+#endif
\ No newline at end of file
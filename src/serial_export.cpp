@@ -0,0 +1,143 @@
+#include "serial_export.h"
+#include "eprobe.h"
+
+#include <Arduino.h>
+#include <esp_log.h>
+#include <cstdarg>
+#include <cstring>
+
+#include "crc32.h"
+#include "deflate.h"
+#include "log_sink.h"
+
+static const char *LOG_TAG = "SerialExport";
+
+static deflate_state_t deflateState;
+static uint8_t chunk[SERIAL_EXPORT_CHUNK];
+static uint8_t frame[SERIAL_EXPORT_HEADER_LEN + SERIAL_EXPORT_CHUNK +
+                     SERIAL_EXPORT_CRC_LEN];
+
+static void serialexport_sendFrame(uint8_t type, uint8_t flags,
+                                   uint32_t offset, uint16_t rawLength,
+                                   const uint8_t *payload, uint16_t length) {
+  frame[0] = SERIAL_EXPORT_MAGIC0;
+  frame[1] = SERIAL_EXPORT_MAGIC1;
+  frame[2] = type;
+  frame[3] = flags;
+  memcpy(frame + 4, &offset, sizeof(offset));
+  memcpy(frame + 8, &rawLength, sizeof(rawLength));
+  memcpy(frame + 10, &length, sizeof(length));
+  // Compressed payloads are already deflated into frame
+  if (payload != frame + SERIAL_EXPORT_HEADER_LEN) {
+    memcpy(frame + SERIAL_EXPORT_HEADER_LEN, payload, length);
+  }
+
+  uint32_t crc = crc32_update(0, frame + 2, SERIAL_EXPORT_HEADER_LEN - 2 + length);
+  memcpy(frame + SERIAL_EXPORT_HEADER_LEN + length, &crc, sizeof(crc));
+  Serial.write(frame,
+               SERIAL_EXPORT_HEADER_LEN + length + SERIAL_EXPORT_CRC_LEN);
+}
+
+static void serialexport_sendError(const char *message) {
+  serialexport_sendFrame(SERIAL_EXPORT_FRAME_ERROR, 0, 0, 0,
+                         (const uint8_t *)message, strlen(message));
+}
+
+static int serialexport_discardLog(const char *format, va_list args) {
+  return 0;
+}
+
+/*
+ Pausing the log sink only stops LOGSINK output. ESP_LOGx of the IDF goes
+ through esp_log_set_vprintf(), while the log_x macros the Arduino core maps
+ ESP_LOGx to print to the debug UART, so both are switched off.
+*/
+static void serialexport_silenceLogs(bool silence) {
+  static vprintf_like_t previous = nullptr;
+  if (silence) {
+    previous = esp_log_set_vprintf(serialexport_discardLog);
+    Serial.setDebugOutput(false);
+  } else {
+    Serial.setDebugOutput(true);
+    esp_log_set_vprintf(previous);
+  }
+}
+
+static void serialexport_switchBaud(uint32_t baud) {
+  Serial.flush();
+  delay(SERIAL_EXPORT_BAUD_SWITCH_MS);
+  Serial.updateBaudRate(baud);
+}
+
+bool serialexport_send(fs::FS &fs, const char *path, uint32_t offset,
+                       uint32_t end, bool compress, uint32_t baud) {
+  File file = fs.open(path, FILE_READ);
+  if (!file) {
+    serialexport_sendError("cannot open file");
+    return false;
+  }
+
+  uint32_t size = file.size();
+  if (end < size) {
+    size = end;
+  }
+  if (offset > size || !file.seek(offset)) {
+    file.close();
+    serialexport_sendError("offset out of range");
+    return false;
+  }
+
+  logsink_pause(true);
+  serialexport_silenceLogs(true);
+  uint32_t start[2] = {size, baud};
+  serialexport_sendFrame(SERIAL_EXPORT_FRAME_START, 0, offset, 0,
+                         (const uint8_t *)start, sizeof(start));
+  serialexport_switchBaud(baud);
+
+  uint32_t startMillis = millis();
+  uint32_t sent = 0;
+  uint32_t wire = 0;
+  bool success = true;
+  while (offset < size) {
+    uint32_t remaining = size - offset;
+    int n = file.read(chunk, remaining < sizeof(chunk) ? remaining
+                                                       : sizeof(chunk));
+    if (n <= 0) {
+      success = false;
+      break;
+    }
+
+    uint8_t *payload = frame + SERIAL_EXPORT_HEADER_LEN;
+    size_t length = 0;
+    if (compress) {
+      // Leave the chunk uncompressed unless deflating shrinks it
+      length = deflate_compress(&deflateState, chunk, n, payload, n - 1);
+    }
+    if (length > 0) {
+      serialexport_sendFrame(SERIAL_EXPORT_FRAME_DATA,
+                             SERIAL_EXPORT_FLAG_DEFLATE, offset, n, payload,
+                             length);
+    } else {
+      length = n;
+      serialexport_sendFrame(SERIAL_EXPORT_FRAME_DATA, 0, offset, n, chunk, n);
+    }
+    offset += n;
+    sent += n;
+    wire += SERIAL_EXPORT_HEADER_LEN + length + SERIAL_EXPORT_CRC_LEN;
+  }
+  file.close();
+
+  if (success) {
+    serialexport_sendFrame(SERIAL_EXPORT_FRAME_END, 0, offset, 0,
+                           (const uint8_t *)&sent, sizeof(sent));
+  } else {
+    serialexport_sendError("read failed");
+  }
+  serialexport_switchBaud(SERIAL_EXPORT_CONSOLE_BAUD);
+  serialexport_silenceLogs(false);
+  logsink_pause(false);
+
+  ESP_LOGI(LOG_TAG, "Exported %u bytes of %s as %u bytes in %lu ms",
+           (unsigned)sent, path, (unsigned)wire, millis() - startMillis);
+  return success;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef SERIAL_EXPORT_H
+#define SERIAL_EXPORT_H
+
+#include <cstdint>
+
+#include "FS.h"
+#include "serial_export_protocol.h"
+
+#define SERIAL_EXPORT_BAUD 921600
+#define SERIAL_EXPORT_CONSOLE_BAUD 115200
+#define SERIAL_EXPORT_BAUD_SWITCH_MS 100
+
+/*
+ Sends a file as framed packets (see serial_export_protocol.h), starting at
+ offset, stopping at end or the end of the file, and optionally deflating
+ every chunk. The serial log sink and ESP_LOGx output are off while the
+ transfer runs and the UART is switched to baud in between the START and
+ the END frame.
+*/
+bool serialexport_send(fs::FS &fs, const char *path, uint32_t offset,
+                       uint32_t end, bool compress,
+                       uint32_t baud = SERIAL_EXPORT_BAUD);
+
+#endif
\ No newline at end of file
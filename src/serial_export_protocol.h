@@ -0,0 +1,38 @@
+#ifndef SERIAL_EXPORT_PROTOCOL_H
+#define SERIAL_EXPORT_PROTOCOL_H
+
+#include <cstdint>
+
+/*
+ Framing of the bulk file export over serial, shared with the host receiver
+ in tools/export_receiver.
+
+ Every frame is
+   magic (0xE5 0x58) | type | flags | offset (u32) | raw length (u16) |
+   length (u16) | payload | CRC-32 over type .. payload
+ with all integers little endian. offset is the position of the payload in
+ the uncompressed file. With SERIAL_EXPORT_FLAG_DEFLATE set the payload is
+ a raw deflate stream that inflates to raw length bytes, so every frame can
+ be decoded on its own and a transfer can resume at any frame boundary.
+
+ An export starts with a START frame carrying the file size and the baud
+ rate the device switches to right after it, and ends with an END frame or
+ an ERROR frame with a message.
+*/
+#define SERIAL_EXPORT_MAGIC0 0xE5
+#define SERIAL_EXPORT_MAGIC1 0x58
+#define SERIAL_EXPORT_HEADER_LEN 12
+#define SERIAL_EXPORT_CRC_LEN 4
+// Largest payload, chunks that do not shrink are sent uncompressed
+#define SERIAL_EXPORT_CHUNK 4096
+
+#define SERIAL_EXPORT_FLAG_DEFLATE 0x01
+
+typedef enum {
+  SERIAL_EXPORT_FRAME_START = 1,  // payload: file size (u32), baud (u32)
+  SERIAL_EXPORT_FRAME_DATA = 2,
+  SERIAL_EXPORT_FRAME_END = 3,    // payload: bytes sent (u32)
+  SERIAL_EXPORT_FRAME_ERROR = 4,  // payload: message
+} serial_export_frame_type_t;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "startup.h"
+#include "eprobe.h"
+
+#include <Arduino.h>
+#include <freertos/event_groups.h>
+
+#include "Task.h"
+
+class StartupJobTask : public Task {
+ public:
+  StartupJobTask() : Task("StartupJob", 4096, 5) {}
+  void run(void *data) override;
+};
+
+static const char *LOG_TAG = "Startup";
+
+static const startup_job_t *startupJobs;
+static size_t startupJobCount;
+static volatile startup_result_t results[STARTUP_MAX_JOBS];
+// Guards the claimed and abandoned masks and the results they decide on
+static portMUX_TYPE claimMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t claimedMask;
+static volatile uint32_t abandonedMask;
+static EventGroupHandle_t doneBits;
+static StartupJobTask jobTasks[STARTUP_MAX_JOBS];
+
+void startup_run(const startup_job_t *jobs, size_t count, uint32_t timeoutMs,
+                 uint32_t graceMs) {
+  if (count > STARTUP_MAX_JOBS) {
+    ESP_LOGE(LOG_TAG, "Too many startup jobs (%d)", (int)count);
+    count = STARTUP_MAX_JOBS;
+  }
+
+  startupJobs = jobs;
+  startupJobCount = count;
+  doneBits = xEventGroupCreate();
+  claimedMask = 0;
+  abandonedMask = 0;
+
+  uint32_t requiredMask = 0;
+  for (size_t i = 0; i < count; i++) {
+    results[i] = STARTUP_PENDING;
+    if (jobs[i].required) {
+      requiredMask |= STARTUP_DEPENDS(i);
+    }
+  }
+
+  uint32_t start = millis();
+  for (size_t i = 0; i < count; i++) {
+    jobTasks[i].setName(jobs[i].name);
+    jobTasks[i].setCore(jobs[i].core == STARTUP_ANY_CORE ? tskNO_AFFINITY
+                                                         : jobs[i].core);
+    jobTasks[i].start((void *)i);
+  }
+
+  EventBits_t done = xEventGroupWaitBits(doneBits, requiredMask, pdFALSE,
+                                         pdTRUE, pdMS_TO_TICKS(timeoutMs));
+  if ((done & requiredMask) != requiredMask) {
+    // The required jobs share the SPI bus with the display and the measure
+    // loop, so nothing may touch it before they ended
+    for (size_t i = 0; i < count; i++) {
+      if ((requiredMask & ~done) & STARTUP_DEPENDS(i)) {
+        ESP_LOGW(LOG_TAG, "%s did not finish in %u ms, still waiting",
+                 jobs[i].name, (unsigned)timeoutMs);
+      }
+    }
+    done = xEventGroupWaitBits(doneBits, requiredMask, pdFALSE, pdTRUE,
+                               pdMS_TO_TICKS(graceMs));
+  }
+  if ((done & requiredMask) != requiredMask) {
+    // A stuck peripheral degrades the device instead of hanging the boot
+    uint32_t abandoned = 0;
+    portENTER_CRITICAL(&claimMux);
+    for (size_t i = 0; i < count; i++) {
+      uint32_t bit = STARTUP_DEPENDS(i);
+      if ((requiredMask & bit) && results[i] == STARTUP_PENDING &&
+          !(claimedMask & bit)) {
+        results[i] = STARTUP_FAILED;
+        abandoned |= bit;
+      }
+    }
+    abandonedMask = abandoned;
+    portEXIT_CRITICAL(&claimMux);
+
+    for (size_t i = 0; i < count; i++) {
+      if (abandoned & STARTUP_DEPENDS(i)) {
+        ESP_LOGE(LOG_TAG, "%s did not finish in %u ms, giving up on it",
+                 jobs[i].name, (unsigned)(timeoutMs + graceMs));
+      }
+    }
+    xEventGroupSetBits(doneBits, abandoned);
+    xEventGroupWaitBits(doneBits, requiredMask, pdFALSE, pdTRUE,
+                        portMAX_DELAY);
+  }
+  ESP_LOGI(LOG_TAG, "Required startup jobs ended after %lu ms",
+           millis() - start);
+}
+
+bool startup_claim(size_t job) {
+  portENTER_CRITICAL(&claimMux);
+  bool claimed = !(abandonedMask & STARTUP_DEPENDS(job));
+  if (claimed) {
+    claimedMask |= STARTUP_DEPENDS(job);
+  }
+  portEXIT_CRITICAL(&claimMux);
+  return claimed;
+}
+
+bool startup_isAbandoned(size_t job) {
+  return abandonedMask & STARTUP_DEPENDS(job);
+}
+
+bool startup_isDone(size_t job) { return results[job] != STARTUP_PENDING; }
+
+startup_result_t startup_result(size_t job) { return results[job]; }
+
+const char *startup_resultText(startup_result_t result) {
+  switch (result) {
+    case STARTUP_OK:
+      return "ok";
+    case STARTUP_FAILED:
+      return "failed";
+    case STARTUP_SKIPPED:
+      return "skipped";
+    default:
+      return "pending";
+  }
+}
+
+void StartupJobTask::run(void *data) {
+  size_t index = (size_t)data;
+  const startup_job_t &job = startupJobs[index];
+
+  uint32_t waitMask = job.dependencies | job.runAfter;
+  if (waitMask != 0) {
+    xEventGroupWaitBits(doneBits, waitMask, pdFALSE, pdTRUE, portMAX_DELAY);
+  }
+
+  startup_result_t result = STARTUP_OK;
+  for (size_t i = 0; i < startupJobCount; i++) {
+    if ((job.dependencies & STARTUP_DEPENDS(i)) &&
+        results[i] != STARTUP_OK) {
+      result = STARTUP_SKIPPED;
+    }
+  }
+
+  if (result == STARTUP_OK) {
+    uint32_t start = millis();
+    result = job.run() ? STARTUP_OK : STARTUP_FAILED;
+    ESP_LOGI(LOG_TAG, "%s %s after %lu ms", job.name,
+             startup_resultText(result), millis() - start);
+  } else {
+    ESP_LOGW(LOG_TAG, "%s skipped, a dependency failed", job.name);
+  }
+
+  portENTER_CRITICAL(&claimMux);
+  bool abandoned = abandonedMask & STARTUP_DEPENDS(index);
+  if (!abandoned) {
+    results[index] = result;
+  }
+  portEXIT_CRITICAL(&claimMux);
+  if (abandoned) {
+    ESP_LOGW(LOG_TAG, "%s ended after it was given up on, result ignored",
+             job.name);
+    return;
+  }
+  xEventGroupSetBits(doneBits, STARTUP_DEPENDS(index));
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define STARTUP_MAX_JOBS 8
+#define STARTUP_DEPENDS(job) (1 << (job))
+#define STARTUP_ANY_CORE -1
+
+typedef bool (*startup_job_fn)();
+
+typedef struct {
+  const char *name;
+  startup_job_fn run;
+  uint32_t dependencies;  // STARTUP_DEPENDS() mask of jobs that must succeed
+  uint32_t runAfter;      // STARTUP_DEPENDS() mask of jobs that must end
+  bool required;          // sampling can not start before this job ended
+  int8_t core;            // core to run on, STARTUP_ANY_CORE for no affinity
+} startup_job_t;
+
+typedef enum {
+  STARTUP_PENDING,
+  STARTUP_OK,
+  STARTUP_FAILED,
+  STARTUP_SKIPPED  // a dependency failed
+} startup_result_t;
+
+/*
+ Runs every job in its own task as soon as its dependencies are done and
+ blocks until all required jobs have ended, warning about the ones still
+ running after timeoutMs. A required job still running graceMs later is
+ given up on: it counts as failed, its dependents are skipped and its
+ result is ignored should it end after all. Optional jobs keep running in
+ the background.
+
+ A job that may hang in a driver calls startup_claim() once that part is
+ done and only publishes its peripheral if the claim succeeds. A claimed
+ job is no longer given up on.
+*/
+void startup_run(const startup_job_t *jobs, size_t count, uint32_t timeoutMs,
+                 uint32_t graceMs);
+// False if startup_run() gave up on the job
+bool startup_claim(size_t job);
+bool startup_isAbandoned(size_t job);
+bool startup_isDone(size_t job);
+startup_result_t startup_result(size_t job);
+const char *startup_resultText(startup_result_t result);
+
+#endif
\ No newline at end of file
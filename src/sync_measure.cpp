@@ -1,9 +1,13 @@
 #include "sync_measure.h"
 #include "eprobe.h"
 
+#include <atomic>
+#include <cmath>
 #include <iostream>
 
 #include "AdafruitIO_WiFi.h"
+#include "Adafruit_MQTT.h"
+#include "Adafruit_MQTT_Client.h"
 
 #include <Adafruit_Sensor.h>
 #include "Adafruit_BME680.h"
@@ -12,9 +16,32 @@
 #include "FS.h"
 #include "SD.h"
 
+#include "adaptive_sampling.h"
+#include "alert.h"
+#include "burst_filter.h"
+#include "datalog.h"
 #include "file.h"
+#include "fixed_format.h"
 #include "gxepd_display.h"
+#include "http_server.h"
+#include "iaq.h"
+#include "log_sink.h"
+#include "metrics.h"
+#include "multi_rate.h"
+#include "sample_frame.h"
+#include "retention.h"
+#include "rolling_stats.h"
+#include "sample_history.h"
+#include "sd_bench.h"
+#include "serial_command.h"
+#include "serial_export.h"
+#include "startup.h"
+#include "Task.h"
 #include "system_time.h"
+#include "upload_batch.h"
+#include "upload_filter.h"
+#include "warm_boot.h"
+#include "wifi_cache.h"
 
 #ifdef GxGDEP015OC1_ACTIVE
 #include "welcome_screen_200x200.h"
@@ -33,32 +60,108 @@
 
 #define PIN_LED GPIO_NUM_5
 
+#define STARTUP_TIMEOUT_MS 15000
+// A required startup job still running this much later is given up on
+#define STARTUP_GRACE_MS 15000
+#define BME680_RETRY_CYCLES 10
+// Retries of a failed reading, the backoff doubles from the initial delay
+#define BME680_READ_RETRIES 3
+#define BME680_RETRY_BACKOFF_MS 10
+// Invalid samples in a row before the sensor is set up again
+#define BME680_MAX_INVALID_CYCLES 3
+// Readings per cycle, more than one reads a burst and filters outliers
+#ifndef BME680_BURST_READINGS
+#define BME680_BURST_READINGS 1
+#endif
+#define TASK_STATS_CYCLES 20
+#define ROLLING_STATS_LOG_CYCLES 10
+// Adafruit IO accepts 30 values per minute, that is 4 feeds every 8 s
+#define AIO_MIN_UPLOAD_INTERVAL_S 10
+// Every feed is uploaded at least this often
+#define AIO_MAX_SILENCE_S 900
+// A directed connect that takes longer falls back to a full scan
+#define WIFI_DIRECTED_TIMEOUT_MS 3000
+#define WIFI_CONNECT_TIMEOUT_MS 10000
+#define WIFI_POLL_MS 50
+// Pings the Adafruit IO session within half of the MQTT keepalive the
+// library connects with, so a long measure interval does not let the broker
+// drop it
+#define AIO_KEEPALIVE_MS (MQTT_CONN_KEEPALIVE * 1000UL / 2)
+#define AIO_TOPIC_LEN 96
+#define AIO_CREATED_AT_LEN 24  // 2026-10-19T12:00:00Z
+#define AIO_VALUE_JSON_LEN (32 + SAMPLE_VALUE_LEN + AIO_CREATED_AT_LEN)
+#define AIO_ALERT_FEED "alerts"
+// With AIO_BATCH_UPLOAD defined the samples go out as CBOR batches to a
+// single feed (see upload_batch.h) instead of a value per feed, once this
+// many are queued or the oldest is AIO_MAX_SILENCE_S old
+#ifndef AIO_BATCH_SAMPLES
+#define AIO_BATCH_SAMPLES 4
+#endif
+#define AIO_BATCH_FEED "batch"
+// With AIO_MQTT_HOST defined the MQTT session goes in plain TCP to that host
+// instead of TLS to io.adafruit.com, e.g. to test/host/mqtt_broker
+#ifdef AIO_MQTT_HOST
+#ifndef AIO_MQTT_PORT
+#define AIO_MQTT_PORT 1883
+#endif
+#endif
+
+#define DATALOG_DIR "/datalog"
+#define SD_BENCH_PATH "/bench.bin"
+
+// Network work runs on the protocol core, sensing and rendering next to loop()
+#define CORE_NETWORK 0
+#define CORE_SENSING 1
+
 // Macros
-#define isAdafruitIoConnected() (io.status() >= AIO_CONNECTED)
+#define isAdafruitIoConnected() \
+  (!wifiConnecting && aio_sessionStatus() >= AIO_CONNECTED)
 
 // Function Prototypes
-void bme680_setup();
+void setupSyncMeasureWarm();
+bool bme680_setup(const bme680_config_t &config);
+void bme680_applyConfig(const bme680_config_t &config);
 void datalog_setup();
 void aio_setup();
 void display_setup();
 void wifi_setup();
 void sd_setup();
+bool sd_mount();
+void sd_openLogs();
+void sd_mountIfNeeded();
+void sd_prepareSegments();
+void sd_runBenchmark();
+void sd_printBenchmarkResult(const sdbench_result_t &result);
+void sd_benchCommand(const char *args);
+void sd_listCommand(const char *args);
+void sd_exportCommand(const char *args);
 void wifi_EventCallback(WiFiEvent_t event);
 void wifi_connect();
 
 void aio_connectIfDisconnected();
-void display_showSensorData(bme680_sensor_data_t sensorData);
+void http_startIfNeeded();
+aio_status_t aio_sessionStatus();
+void display_showSensorData(sample_frame_t *frame, bool updatePanel);
 void display_showMainScreen();
 void display_showStartupStatus(const char *message);
 void display_showStartupScreen();
-void display_updateBufferForData(const char *temp_buf, const char *humidity_buf,
-                                 const char *pressure_buf,
-                                 const char *airquality_buf,
-                                 long refreshCounter);
-
-void aio_sendSensorData(bme680_sensor_data_t sensorData);
+void display_showStartupSummary();
+void display_updateBufferForData(sample_frame_t *frame);
+void serial_printSensorData(sample_frame_t *frame);
+
+void aio_sendSensorData(sample_frame_t *frame, uint32_t sampleMillis);
+void aio_sendBatch(sample_frame_t *frame, uint32_t sampleMillis);
+size_t aio_sendAlerts(const bme680_sensor_data_t &sample,
+                      uint32_t sampleMillis);
 void aio_checkIoEventsIfConnected();
 void gpio_signalMeasureCycleSuccess();
+void tasks_logRuntimeStats();
+void stats_logRollingStats();
+void display_printRollingRange(rolling_channel_t channel, int16_t y);
+void cycle_publishMetrics(uint32_t cycleStart,
+                          const bme680_sensor_data_t *sample);
+bool bme680_performReading();
+bool bme680_readBurst(bme680_sensor_data_t *sensorData);
 bme680_sensor_data_t bme680_readSensorData();
 
 // BME680
@@ -70,39 +173,271 @@ static GxIO_Class displayIo(SPI, DISPLAY_PIN_CS, DISPLAY_PIN_DC,
 static GxEPD_Class display(displayIo, DISPLAY_PIN_RST,
                            DISPLAY_PIN_BSY);  // (RST, BSY)
 
-// Adafruit IO
-AdafruitIO_WiFi io(IO_USERNAME, IO_KEY, WIFI_SSID, WIFI_PASS);
-AdafruitIO_Feed *temperatureFeed = io.feed("temperature");
-AdafruitIO_Feed *humidityFeed = io.feed("humidity");
-AdafruitIO_Feed *pressureFeed = io.feed("pressure");
-AdafruitIO_Feed *airqualityFeed = io.feed("airquality");
+// Adafruit IO, joining the network through wifi_cache.h instead of a plain
+// WiFi.begin() and publishing with QoS 1 instead of the feeds' QoS 0
+class AdafruitIO_CachedWiFi : public AdafruitIO_WiFi {
+ public:
+  AdafruitIO_CachedWiFi(const char *user, const char *key, const char *ssid,
+                        const char *pass)
+      : AdafruitIO_WiFi(user, key, ssid, pass)
+#ifdef AIO_MQTT_HOST
+        , plainMqtt(&plainClient, AIO_MQTT_HOST, AIO_MQTT_PORT, user, key)
+#endif
+  {
+#ifdef AIO_MQTT_HOST
+    // Only the MQTT session moves, the HTTP client is not used. The library
+    // client is kept rather than deleted as Adafruit_MQTT has no virtual
+    // destructor, and handed back for the base class to delete.
+    libraryMqtt = _mqtt;
+    _mqtt = &plainMqtt;
+#endif
+  }
+
+#ifdef AIO_MQTT_HOST
+  ~AdafruitIO_CachedWiFi() { _mqtt = libraryMqtt; }
+#endif
+
+  bool directed = false;  // last connect went to the cached access point
+
+  // Publishes to a feed with QoS 1, true once the broker acknowledged it
+  bool publish(const char *feedKey, const char *value) {
+    char topic[AIO_TOPIC_LEN];
+    snprintf(topic, sizeof(topic), "%s/feeds/%s", _username, feedKey);
+    return _mqtt->publish(topic, value, MQTT_QOS_1);
+  }
+
+ protected:
+  void _connect() override {
+    _disconnect();
+    delay(100);
+    directed = wificache_begin(&warmboot_state()->wifiCache, _ssid, _pass);
+    _status = AIO_NET_DISCONNECTED;
+  }
+
+#ifdef AIO_MQTT_HOST
+ private:
+  WiFiClient plainClient;  // constructed before plainMqtt
+  Adafruit_MQTT_Client plainMqtt;
+  Adafruit_MQTT *libraryMqtt;
+#endif
+};
+
+AdafruitIO_CachedWiFi io(IO_USERNAME, IO_KEY, WIFI_SSID, WIFI_PASS);
+// Feed keys by rolling_channel_t
+static const char *uploadFeeds[ROLLING_CHANNEL_COUNT] = {
+    "temperature", "humidity", "pressure", "airquality"};
 
 // Global constants
 #define STR_DATE_TIME_LEN 64
 static const char *LOG_TAG = "SyncMeasure";
 
 static uint16_t cycleCounter;
-
-void setupSyncMeasure() {
-  cycleCounter = 0;
-
+static bool sdMounted = false;
+static bool httpServerStarted = false;
+static bool sdMountAttempted = false;
+static datalog_t journal;
+static bool firstSampleTaken = false;
+static volatile bool bme680Available = false;
+static std::atomic<bool> wifiConnecting(false);
+static volatile bool sdBenchRequested = false;
+static uint32_t aioUploadsSent = 0;
+static uint32_t aioUploadFailures = 0;
+static uint32_t bme680ReadFailures = 0;
+static uint32_t bme680ReadRetries = 0;
+static uint32_t bme680OutliersRejected = 0;
+static uint32_t bme680InvalidCycles = 0;  // in a row
+static uint32_t bme680ReadMicros = 0;
+static uint32_t aioUploadLatencyMs = 0;  // sample to the last save()
+static uint32_t aioUploadBytes = 0;
+static uint32_t aioUploadSamples = 0;
+static uint32_t alertsSent = 0;
+static uint32_t alertLatencyMs = 0;
+static uint32_t alertWorstLatencyMs = 0;
+static uint32_t wifiConnectMs = 0;
+static uint32_t wifiDirectedConnects = 0;
+static uint32_t wifiScanConnects = 0;
+static bool aioSessionUp = false;
+static uint32_t aioHandshakes = 0;
+static uint32_t aioSessionDrops = 0;
+static uint32_t aioConnectMs = 0;
+
+// Units as in rolling_stats.h, rates per minute
+static const alert_rule_t alertRules[] = {
+    {"Humidity spike", ROLLING_CHANNEL_HUMIDITY, ALERT_RISE, 3.0f, 600},
+    {"Humidity high", ROLLING_CHANNEL_HUMIDITY, ALERT_ABOVE, 80.0f, 3600},
+    {"Pressure drop", ROLLING_CHANNEL_PRESSURE, ALERT_FALL, 0.5f, 600},
+    {"Gas resistance collapse", ROLLING_CHANNEL_AIRQUALITY, ALERT_DROP, 0.5f,
+     1800},
+    {"Temperature high", ROLLING_CHANNEL_TEMPERATURE, ALERT_ABOVE, 35.0f,
+     3600},
+    {"Temperature low", ROLLING_CHANNEL_TEMPERATURE, ALERT_BELOW, 5.0f, 3600},
+};
+
+// Deadband and swinging door tolerance per feed, in the units uploaded
+static const upload_filter_config_t
+    uploadFilterConfigs[ROLLING_CHANNEL_COUNT] = {
+        {0.05f, 0.1f, AIO_MAX_SILENCE_S},     // temperature (*C)
+        {0.2f, 0.5f, AIO_MAX_SILENCE_S},      // humidity (%)
+        {5.0f, 10.0f, AIO_MAX_SILENCE_S},     // pressure (Pa)
+        {500.0f, 1000.0f, AIO_MAX_SILENCE_S}  // gas resistance (Ohm)
+};
+
+// Sensor configuration of the cycles without and with a gas measurement
+static const bme680_config_t defaultFastSensorConfig = {
+    BME680_OS_2X,          // temperature oversampling
+    BME680_OS_1X,          // humidity oversampling
+    BME680_OS_2X,          // pressure oversampling
+    BME680_FILTER_SIZE_3,  // IIR filter
+    0,                     // heater temperature (*C), 0 turns it off
+    0                      // heater duration (ms)
+};
+// Lowest latency, for bursts of readings that are filtered afterwards
+static const bme680_config_t burstSensorConfig = {
+    BME680_OS_1X,          // temperature oversampling
+    BME680_OS_1X,          // humidity oversampling
+    BME680_OS_1X,          // pressure oversampling
+    BME680_FILTER_SIZE_0,  // IIR filter
+    0,                     // heater temperature (*C)
+    0                      // heater duration (ms)
+};
+static const bme680_config_t defaultGasSensorConfig = {
+    BME680_OS_8X,          // temperature oversampling
+    BME680_OS_2X,          // humidity oversampling
+    BME680_OS_4X,          // pressure oversampling
+    BME680_FILTER_SIZE_3,  // IIR filter
+    320,                   // heater temperature (*C)
+    150                    // heater duration (ms)
+};
+
+// Startup jobs
+enum {
+  STARTUP_JOB_DISPLAY,
+  STARTUP_JOB_SD,
+  STARTUP_JOB_WIFI,
+  STARTUP_JOB_BME680,
+  STARTUP_JOB_DATALOG,
+  STARTUP_JOB_COUNT
+};
+
+static bool display_startupJob() {
   display_setup();
   display_showStartupScreen();
+  return true;
+}
 
-  display_showStartupStatus("SD");
-  sd_setup();
+// The card and the sensor are only used if startup_run() still waits for
+// the job, one it gave up on may end in a stuck driver at any time
+static bool sd_startupJob() {
+  if (!sd_mount() || !startup_claim(STARTUP_JOB_SD)) {
+    return false;
+  }
+  sd_openLogs();
+  return true;
+}
 
-  display_showStartupStatus("WiFi");
+static bool wifi_startupJob() {
   wifi_setup();
-  // aio_setup();
+  return WiFi.status() == WL_CONNECTED;
+}
 
-  display_showStartupStatus("BME680");
-  bme680_setup();
+static bool bme680_startupJob() {
+  bool available = bme680_setup(warmboot_state()->fastSensorConfig);
+  if (!startup_claim(STARTUP_JOB_BME680)) {
+    return false;
+  }
+  bme680Available = available;
+  return available;
+}
 
-  display_showStartupStatus("Datalog");
+static bool datalog_startupJob() {
   datalog_setup();
+  return true;
+}
 
+// Display, SD card and BME680 share the SPI bus and are therefore chained.
+// WiFi comes up next to them and is not needed for the first sample.
+static const startup_job_t startupJobs[STARTUP_JOB_COUNT] = {
+    {"Display", display_startupJob, 0, 0, true, CORE_SENSING},
+    {"SD", sd_startupJob, 0, STARTUP_DEPENDS(STARTUP_JOB_DISPLAY), true,
+     CORE_SENSING},
+    {"WiFi", wifi_startupJob, 0, 0, false, CORE_NETWORK},
+    {"BME680", bme680_startupJob, 0, STARTUP_DEPENDS(STARTUP_JOB_SD), true,
+     CORE_SENSING},
+    {"Datalog", datalog_startupJob, 0, 0, true, CORE_SENSING},
+};
+
+static const serial_command_t serialCommands[] = {
+    {"sdbench", sd_benchCommand, "Benchmark the SD card in the next cycle"},
+    {"ls", sd_listCommand, "[dir] List a directory on the SD card"},
+    {"export", sd_exportCommand, "<path> [offset [z]] Send a file in frames"},
+};
+
+void setupSyncMeasure() {
+  if (warmboot_isWarmBoot()) {
+    setupSyncMeasureWarm();
+    return;
+  }
+
+  cycleCounter = 0;
+
+  warmboot_state_t *state = warmboot_state();
+  state->fastSensorConfig = defaultFastSensorConfig;
+  state->gasSensorConfig = defaultGasSensorConfig;
+  iaq_restore(&state->iaq);
+  samplehistory_setup(&state->sampleHistory);
+
+  startup_run(startupJobs, STARTUP_JOB_COUNT, STARTUP_TIMEOUT_MS,
+              STARTUP_GRACE_MS);
+
+  display_showStartupSummary();
   display_showMainScreen();
+  state->mainScreenShown = true;
+
+  serialcmd_setup(serialCommands,
+                  sizeof(serialCommands) / sizeof(serialCommands[0]));
+#ifdef SD_BENCH
+  sdBenchRequested = true;
+#endif
+}
+
+/*
+ Wakeup from deep sleep: the panel still shows the main screen and the
+ sensor configuration is known, so skip the splash and status refreshes.
+ SD card and WiFi are brought up lazily when the cycle needs them, the HTTP
+ server with them (see http_startIfNeeded()). The rolling statistics start
+ over, see rolling_stats.h.
+*/
+void setupSyncMeasureWarm() {
+  warmboot_state_t *state = warmboot_state();
+  cycleCounter = state->cycleCounter;
+  samplehistory_setup(&state->sampleHistory);
+
+  systime_setupTimezone();
+  display_setup();
+  WiFi.onEvent(wifi_EventCallback);
+  bme680Available = bme680_setup(state->fastSensorConfig);
+  datalog_setup();
+
+  if (!state->mainScreenShown) {
+    display_showMainScreen();
+    state->mainScreenShown = true;
+  }
+
+  serialcmd_setup(serialCommands,
+                  sizeof(serialCommands) / sizeof(serialCommands[0]));
+}
+
+uint32_t measureIntervalMs() {
+  return adaptivesampling_intervalMs(warmboot_state()->sampling);
+}
+
+uint32_t measureKeepaliveMs() { return AIO_KEEPALIVE_MS; }
+
+void measureKeepalive() { aio_checkIoEventsIfConnected(); }
+
+void suspendSyncMeasure() {
+  warmboot_state()->cycleCounter = cycleCounter;
+  warmboot_commit();
 }
 
 void wifi_EventCallback(WiFiEvent_t event) {
@@ -136,20 +471,25 @@ void aio_setup() {
   ESP_LOGI(LOG_TAG, "Adafruit IO connection status: %s", io.statusText());
 }
 
-void bme680_setup() {
+bool bme680_setup(const bme680_config_t &config) {
   ESP_LOGD(LOG_TAG, "Setup BME680 sensor");
   if (!bme.begin()) {
     ESP_LOGE(LOG_TAG, "Could not find a valid BME680 sensor, check wiring!");
-    while (1)
-      ;
+    return false;
   }
 
-  // Set up oversampling and filter initialization
-  bme.setTemperatureOversampling(BME680_OS_8X);
-  bme.setHumidityOversampling(BME680_OS_2X);
-  bme.setPressureOversampling(BME680_OS_4X);
-  bme.setIIRFilterSize(BME680_FILTER_SIZE_3);
-  bme.setGasHeater(320, 150);  // 320*C for 150 ms
+  bme680_applyConfig(config);
+  return true;
+}
+
+// Takes effect with the next reading, a heater temperature or duration of 0
+// turns the gas measurement off
+void bme680_applyConfig(const bme680_config_t &config) {
+  bme.setTemperatureOversampling(config.temperatureOversampling);
+  bme.setHumidityOversampling(config.humidityOversampling);
+  bme.setPressureOversampling(config.pressureOversampling);
+  bme.setIIRFilterSize(config.iirFilterSize);
+  bme.setGasHeater(config.heaterTemperature, config.heaterDuration);
 }
 
 void datalog_setup() {
@@ -161,102 +501,334 @@ void datalog_setup() {
 void display_setup() { display.init(); }
 
 void measureLoop() {
+  uint32_t cycleStart = millis();
   cycleCounter++;
   ESP_LOGD(LOG_TAG, "Entering messuring loop (Cycle: %d)", cycleCounter);
 
+  if (sdBenchRequested) {
+    sdBenchRequested = false;
+    sd_runBenchmark();
+  }
+
+  // Not while a startup job that was given up on may still set it up
+  if (!bme680Available && cycleCounter % BME680_RETRY_CYCLES == 0 &&
+      !startup_isAbandoned(STARTUP_JOB_BME680)) {
+    bme680Available = bme680_setup(warmboot_state()->fastSensorConfig);
+  }
+  if (!bme680Available) {
+    LOGSINK("BME680 not available, skipping measure cycle %d\n",
+            cycleCounter);
+    aio_connectIfDisconnected();
+    aio_checkIoEventsIfConnected();
+    cycle_publishMetrics(cycleStart, nullptr);
+    return;
+  }
+
+  bme680_sensor_data_t sensorData = bme680_readSensorData();
+  if (!(sensorData.flags & SAMPLE_FLAG_VALID)) {
+    LOGSINK("Invalid BME680 sample, skipping measure cycle %d\n",
+            cycleCounter);
+    if (++bme680InvalidCycles >= BME680_MAX_INVALID_CYCLES) {
+      bme680Available = false;
+      bme680InvalidCycles = 0;
+    }
+    aio_connectIfDisconnected();
+    aio_checkIoEventsIfConnected();
+    cycle_publishMetrics(cycleStart, nullptr);
+    return;
+  }
+  bme680InvalidCycles = 0;
+  uint32_t sampleMillis = millis();
+
+  // Alerts go out before anything else the cycle does
+  bool alerting = aio_sendAlerts(sensorData, sampleMillis) > 0;
+  samplehistory_add(sensorData);
+  rollingstats_add(sensorData);
+  // The aggregates closed by this sample go to the card
+  sd_mountIfNeeded();
+  retention_add(&warmboot_state()->retention, sensorData);
+  adaptivesampling_update(&warmboot_state()->sampling, sensorData);
+  if (alerting) {
+    // After the update, whose growth cap would otherwise undo it
+    adaptivesampling_expedite(&warmboot_state()->sampling);
+  }
+  if (!firstSampleTaken) {
+    firstSampleTaken = true;
+    warmboot_state()->wakeToSampleMs = warmboot_millisSinceBoot();
+    LOGSINK("%s boot to first sample: %u ms\n",
+            warmboot_isWarmBoot() ? "Warm" : "Cold",
+            (unsigned)warmboot_state()->wakeToSampleMs);
+  }
+
+  sample_frame_t *frame = sampleframe_acquire(sensorData, cycleCounter);
+  if (frame == nullptr) {
+    cycle_publishMetrics(cycleStart, &sensorData);
+    return;
+  }
+
+  // An alert cycle skips the slow panel refresh and the statistics
+  display_showSensorData(frame, !alerting);
+
   aio_connectIfDisconnected();
   aio_checkIoEventsIfConnected();
+#ifdef AIO_BATCH_UPLOAD
+  aio_sendBatch(frame, sampleMillis);
+#else
+  aio_sendSensorData(frame, sampleMillis);
+#endif
+  sampleframe_release(frame);
 
-  bme680_sensor_data_t sensorData = bme680_readSensorData();
-  display_showSensorData(sensorData);
-  aio_sendSensorData(sensorData);
   gpio_signalMeasureCycleSuccess();
+
+  if (!alerting) {
+    sd_prepareSegments();
+  }
+  if (!alerting && cycleCounter % TASK_STATS_CYCLES == 0) {
+    tasks_logRuntimeStats();
+  }
+  if (!alerting && cycleCounter % ROLLING_STATS_LOG_CYCLES == 0) {
+    stats_logRollingStats();
+  }
+  cycle_publishMetrics(cycleStart, &sensorData);
 }
 
-bme680_sensor_data_t bme680_readSensorData() {
-  ESP_LOGD(LOG_TAG, "Read BME680 sensor data");
-  bme680_sensor_data_t sensorData{};
+void stats_logRollingStats() {
+  rolling_summary_t summary;
 
-  if (!bme.performReading()) {
-    Serial.println("Failed to perform BME680 reading");
-    return sensorData;
+  for (int w = 0; w < ROLLING_WINDOW_COUNT; w++) {
+    for (int c = 0; c < ROLLING_CHANNEL_COUNT; c++) {
+      if (!rollingstats_summary((rolling_window_t)w, (rolling_channel_t)c,
+                                &summary)) {
+        continue;
+      }
+      LOGSINK("Stats %s %s: n %u, min %.2f, max %.2f, mean %.2f, sd %.3f\n",
+              rollingstats_windowName((rolling_window_t)w),
+              rollingstats_channelName((rolling_channel_t)c),
+              (unsigned)summary.count, summary.min, summary.max,
+              summary.mean, summary.stddev);
+    }
   }
-  sensorData.temperature = bme.temperature;
-  sensorData.pressure = bme.pressure;
-  sensorData.humidity = bme.humidity;
-  sensorData.airquality = bme.gas_resistance;
+}
 
-  return sensorData;
+void cycle_publishMetrics(uint32_t cycleStart,
+                          const bme680_sensor_data_t *sample) {
+  metrics_snapshot_t snapshot = {};
+  if (sample != nullptr) {
+    snapshot.sample = *sample;
+    snapshot.sampleValid = true;
+  }
+  snapshot.cycleCounter = cycleCounter;
+  snapshot.cycleMillis = millis() - cycleStart;
+  snapshot.uploadsSent = aioUploadsSent;
+  snapshot.uploadFailures = aioUploadFailures;
+  snapshot.sensorReadMicros = bme680ReadMicros;
+  snapshot.uploadLatencyMs = aioUploadLatencyMs;
+  snapshot.uploadBytes = aioUploadBytes;
+  snapshot.uploadSamples = aioUploadSamples;
+  const upload_queue_t &queue = warmboot_state()->uploadQueue;
+  snapshot.uploadQueueEntries = queue.count;
+  snapshot.uploadQueueSamples = uploadbatch_samples(queue);
+  snapshot.uploadQueueMerges = queue.merges;
+  if (queue.count > 0 && sample != nullptr) {
+    snapshot.uploadQueueAgeSeconds =
+        (uint32_t)sample->acquiringTime - queue.entries[0].start;
+  }
+  snapshot.alertsSent = alertsSent;
+  snapshot.alertLatencyMs = alertLatencyMs;
+  snapshot.alertWorstLatencyMs = alertWorstLatencyMs;
+  snapshot.sensorReadFailures = bme680ReadFailures;
+  snapshot.sensorReadRetries = bme680ReadRetries;
+  snapshot.sensorOutliers = bme680OutliersRejected;
+  for (int c = 0; c < ROLLING_CHANNEL_COUNT; c++) {
+    snapshot.uploadsSuppressed += warmboot_state()->uploadFilters[c].suppressed;
+  }
+  snapshot.samplingIntervalMs = measureIntervalMs();
+  if (journal.mounted) {
+    snapshot.sdAppendMicros = journal.lastAppendMicros;
+    snapshot.sdWorstAppendMicros = journal.header.worstAppendMicros;
+  }
+  snapshot.heapFree = esp_get_free_heap_size();
+  snapshot.logDropped = logsink_droppedCount();
+  snapshot.uptimeSeconds = warmboot_millisSinceBoot() / 1000;
+  snapshot.wifiConnectMs = wifiConnectMs;
+  snapshot.wifiDirectedConnects = wifiDirectedConnects;
+  snapshot.wifiScanConnects = wifiScanConnects;
+  snapshot.aioHandshakes = aioHandshakes;
+  snapshot.aioSessionDrops = aioSessionDrops;
+  snapshot.aioConnectMs = aioConnectMs;
+  snapshot.wifiConnected = WiFi.status() == WL_CONNECTED;
+  if (snapshot.wifiConnected) {
+    snapshot.wifiRssi = WiFi.RSSI();
+  }
+  metrics_publish(snapshot);
 }
 
-void display_showSensorData(bme680_sensor_data_t sensorData) {
-  ESP_LOGD(LOG_TAG, "Displaying Sensor Data");
-  char temp_buf[10];
-  char humidity_buf[10];
-  char pressure_buf[13];
-  char airquality_buf[13];
-  char strftime_buf[STR_DATE_TIME_LEN];
-  time_t now;
+void tasks_logRuntimeStats() {
+  TaskRuntimeStats stats[TASK_MAX_REGISTERED];
+  uint8_t coreLoad[portNUM_PROCESSORS];
+  size_t count =
+      Task::sampleRuntimeStats(stats, TASK_MAX_REGISTERED, coreLoad);
 
-  time(&now);
+  for (size_t i = 0; i < count; i++) {
+    LOGSINK("Task %s: core %d, prio %d, cpu %u%%, stack free %u\n",
+            stats[i].name, (int)stats[i].coreId, stats[i].priority,
+            stats[i].cpuPercent, (unsigned)stats[i].stackHighWater);
+  }
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    LOGSINK("Core %d load %u%%\n", core, coreLoad[core]);
+  }
+  LOGSINK("Heap free %u, loop stack free %u\n",
+          (unsigned)esp_get_free_heap_size(),
+          (unsigned)uxTaskGetStackHighWaterMark(nullptr));
+  LOGSINK("BME680 read %u us (%d per cycle), retries %u, failures %u, "
+          "outliers %u\n",
+          (unsigned)bme680ReadMicros, BME680_BURST_READINGS,
+          (unsigned)bme680ReadRetries, (unsigned)bme680ReadFailures,
+          (unsigned)bme680OutliersRejected);
+  if (journal.mounted) {
+    LOGSINK("Datalog %s: end %u, append %u us, worst %u us, rollover %u ms\n",
+            journal.path, (unsigned)journal.header.end,
+            (unsigned)journal.lastAppendMicros,
+            (unsigned)journal.header.worstAppendMicros,
+            (unsigned)journal.rolloverMillis);
+  }
+}
 
-  systime_createCurrentTimeOutput(now, strftime_buf, (STR_DATE_TIME_LEN - 1),
-                                  "%c");
+// Reads the sensor, retrying with backoff. False if every attempt failed.
+bool bme680_performReading() {
+  for (int attempt = 0; attempt <= BME680_READ_RETRIES; attempt++) {
+    if (attempt > 0) {
+      bme680ReadRetries++;
+      delay(BME680_RETRY_BACKOFF_MS << (attempt - 1));
+    }
+    if (bme.performReading()) {
+      return true;
+    }
+  }
+  bme680ReadFailures++;
+  return false;
+}
 
-  Serial.println(
-      "------------------------------------------------------------");
-  Serial.printf("Measure cycle %d at %s\n", cycleCounter, strftime_buf);
-  Serial.println(
-      "------------------------------------------------------------");
+// Takes BME680_BURST_READINGS fast readings and combines them with a Hampel
+// filter, false if less than half of them succeeded
+bool bme680_readBurst(bme680_sensor_data_t *sensorData) {
+  float temperatures[BME680_BURST_READINGS];
+  float humidities[BME680_BURST_READINGS];
+  float pressures[BME680_BURST_READINGS];
+  size_t count = 0;
+
+  bme680_applyConfig(burstSensorConfig);
+  for (int i = 0; i < BME680_BURST_READINGS; i++) {
+    if (bme680_performReading()) {
+      temperatures[count] = bme.temperature;
+      humidities[count] = bme.humidity;
+      pressures[count] = bme.pressure;
+      count++;
+    }
+  }
+  if (count * 2 < BME680_BURST_READINGS) {
+    return false;
+  }
 
-  snprintf(temp_buf, 10, "%.2f", (double)sensorData.temperature);
-  snprintf(humidity_buf, 10, "%.2f", (double)sensorData.humidity);
-  snprintf(pressure_buf, 12, "%.2f", (double)(sensorData.pressure / 100.0));
-  snprintf(airquality_buf, 12, "%.2fk",
-           (double)(sensorData.airquality / 1000.0));
+  size_t rejected = 0;
+  sensorData->temperature =
+      burstfilter_combine(temperatures, count, &rejected);
+  sensorData->humidity = burstfilter_combine(humidities, count, &rejected);
+  sensorData->pressure = burstfilter_combine(pressures, count, &rejected);
+  bme680OutliersRejected += rejected;
+  return true;
+}
 
-  Serial.println(temp_buf);
-  Serial.println(humidity_buf);
-  Serial.println(pressure_buf);
-  Serial.println(airquality_buf);
+bme680_sensor_data_t bme680_readSensorData() {
+  ESP_LOGD(LOG_TAG, "Read BME680 sensor data");
+  bme680_sensor_data_t sensorData{};
+  time(&sensorData.acquiringTime);
+  uint32_t start = micros();
+
+  warmboot_state_t *state = warmboot_state();
+  uint32_t time = (uint32_t)sensorData.acquiringTime;
+  bool gas = multirate_gasDue(state->multiRate, time);
+  bool burst = BME680_BURST_READINGS > 1;
+
+  if (gas || !burst) {
+    bme680_applyConfig(gas ? state->gasSensorConfig
+                           : state->fastSensorConfig);
+    if (bme680_performReading()) {
+      sensorData.temperature = bme.temperature;
+      sensorData.pressure = bme.pressure;
+      sensorData.humidity = bme.humidity;
+      sensorData.flags |= SAMPLE_FLAG_VALID;
+      if (gas) {
+        sensorData.airquality =
+            multirate_addGas(&state->multiRate, time, bme.gas_resistance);
+        sensorData.flags |= SAMPLE_FLAG_GAS_FRESH;
+      }
+    } else {
+      LOGSINK("Failed to perform BME680 reading\n");
+    }
+  }
+  if (burst) {
+    if (bme680_readBurst(&sensorData)) {
+      sensorData.flags |= SAMPLE_FLAG_VALID;
+    } else {
+      LOGSINK("Failed to perform BME680 burst reading\n");
+    }
+  }
+  bme680ReadMicros = micros() - start;
+
+  if (!(sensorData.flags & SAMPLE_FLAG_GAS_FRESH)) {
+    sensorData.airquality = state->multiRate.gasResistance;
+  }
+  iaq_update(&state->iaq, sensorData);
+  sensorData.iaq = state->iaq.iaq;
+  sensorData.iaqAccuracy = state->iaq.accuracy;
+
+  return sensorData;
+}
+
+void display_showSensorData(sample_frame_t *frame, bool updatePanel) {
+  ESP_LOGD(LOG_TAG, "Displaying Sensor Data");
 
-  Serial.println(
-      "------------------------------------------------------------");
+  serial_printSensorData(frame);
 
-  if (cycleCounter % 40 == 0) {
+  if (updatePanel && cycleCounter % 40 == 0) {
     display_showMainScreen();
   }
 
-  systime_createCurrentTimeOutput(now, strftime_buf, (STR_DATE_TIME_LEN - 1),
-                                  "%c");
-  char dataLogLine[129];
-  snprintf(dataLogLine, 128, "'%s',%.2f,%.2f,%.2f,%.4f\n", strftime_buf,
-           (double)sensorData.temperature, (double)sensorData.humidity,
-           (double)sensorData.pressure / 100, 0,
-           (double)sensorData.airquality / 1000.0);
+  sd_mountIfNeeded();
+  if (journal.mounted) {
+    const char *line = sampleframe_dataLogLine(frame);
+    if (!datalog_append(&journal, DATALOG_RECORD_SAMPLE, line,
+                        strlen(line))) {
+      ESP_LOGW(LOG_TAG, "Failed to append sample to %s", journal.path);
+    }
+  }
 
-  appendFile(SD, "/datalog.csv", dataLogLine);
+  if (updatePanel) {
+    display_updateBufferForData(frame);
+  }
+}
 
-  display_updateBufferForData(temp_buf, humidity_buf, pressure_buf,
-                              airquality_buf, cycleCounter);
+void serial_printSensorData(sample_frame_t *frame) {
+  LOGSINK("Measure cycle %d at %s: %s C, %s %%, %s hPa, %s, IAQ %d (%s)\n",
+          frame->cycle, sampleframe_timeText(frame),
+          sampleframe_value(frame, SAMPLE_VALUE_TEMPERATURE),
+          sampleframe_value(frame, SAMPLE_VALUE_HUMIDITY),
+          sampleframe_value(frame, SAMPLE_VALUE_PRESSURE),
+          sampleframe_value(frame, SAMPLE_VALUE_AIRQUALITY),
+          (int)frame->data.iaq, iaq_accuracyName(frame->data.iaqAccuracy));
 }
 
-void display_updateBufferForData(const char *temp_buf, const char *humidity_buf,
-                                 const char *pressure_buf,
-                                 const char *airquality_buf,
-                                 long refreshCounter) {
+void display_updateBufferForData(sample_frame_t *frame) {
   char strftime_buf[STR_DATE_TIME_LEN];
-  time_t now;
-
-  time(&now);
 
 #ifdef GxGDEP015OC1_ACTIVE
-  systime_createCurrentTimeOutput(now, strftime_buf, (STR_DATE_TIME_LEN - 1),
-                                  "%d.%m.%y %T");
+  systime_createCurrentTimeOutput(frame->data.acquiringTime, strftime_buf,
+                                  (STR_DATE_TIME_LEN - 1), "%d.%m.%y %T");
 #endif
 #ifdef GxGDE0213B1_ACTIVE
-  systime_createCurrentTimeOutput(now, strftime_buf, (STR_DATE_TIME_LEN - 1),
-                                  "%d.%m. %T");
+  systime_createCurrentTimeOutput(frame->data.acquiringTime, strftime_buf,
+                                  (STR_DATE_TIME_LEN - 1), "%d.%m. %T");
 #endif
 
   display.setTextColor(GxEPD_BLACK);
@@ -264,25 +836,34 @@ void display_updateBufferForData(const char *temp_buf, const char *humidity_buf,
   display.setFont(fsmall);
 
   display.setCursor(34, 22);
-  display.print(temp_buf);
+  display.print(sampleframe_value(frame, SAMPLE_VALUE_TEMPERATURE));
   display.updateWindow(34, 0, 100, 24);
 
   display.setCursor(34, 72);
-  display.print(humidity_buf);
+  display.print(sampleframe_value(frame, SAMPLE_VALUE_HUMIDITY));
   display.updateWindow(34, 50, 100, 24);
 
   display.setCursor(34, 122);
-  display.print(pressure_buf);
+  display.print(sampleframe_value(frame, SAMPLE_VALUE_PRESSURE));
   display.updateWindow(34, 100, 100, 24);
 
   display.setCursor(34, 172);
-  display.print(airquality_buf);
+  display.print(sampleframe_value(frame, SAMPLE_VALUE_AIRQUALITY));
   display.updateWindow(34, 150, 100, 24);
 
+  display.setFont(fsmall7pt);
+  display_printRollingRange(ROLLING_CHANNEL_TEMPERATURE, 36);
+  display_printRollingRange(ROLLING_CHANNEL_HUMIDITY, 86);
+  display_printRollingRange(ROLLING_CHANNEL_PRESSURE, 136);
+#ifdef GxGDE0213B1_ACTIVE
+  // The 200x200 panel shows the time bar there
+  display_printRollingRange(ROLLING_CHANNEL_AIRQUALITY, 186);
+#endif
+
 #ifdef GxGDEP015OC1_ACTIVE
   display.setFont(fsmall7pt);
   display.setCursor(136, 11);
-  display.printf("[%06d]", refreshCounter);
+  display.printf("[%06d]", frame->cycle);
   display.updateWindow(136, 0, display.width(), 22);
 
   display.setTextColor(GxEPD_WHITE);
@@ -295,7 +876,7 @@ void display_updateBufferForData(const char *temp_buf, const char *humidity_buf,
 #ifdef GxGDE0213B1_ACTIVE
   display.setFont(fsmall7pt);
   display.setCursor(2, 214);
-  display.printf("[%06d]", refreshCounter);
+  display.printf("[%06d]", frame->cycle);
   display.updateWindow(0, 204, display.width(), 14);
 
   display.setTextColor(GxEPD_WHITE);
@@ -306,6 +887,22 @@ void display_updateBufferForData(const char *temp_buf, const char *humidity_buf,
 #endif
 }
 
+// Prints the 24 h min/max below a value, y is the text baseline
+void display_printRollingRange(rolling_channel_t channel, int16_t y) {
+  rolling_summary_t summary;
+  if (!rollingstats_summary(ROLLING_WINDOW_24H, channel, &summary)) {
+    return;
+  }
+
+  char min[SAMPLE_VALUE_LEN];
+  char max[SAMPLE_VALUE_LEN];
+  fixfmt_formatFloat(min, sizeof(min), summary.min, 1);
+  fixfmt_formatFloat(max, sizeof(max), summary.max, 1);
+  display.setCursor(34, y);
+  display.printf("24h %s..%s", min, max);
+  display.updateWindow(34, y - 10, 100, 13);
+}
+
 void display_showMainScreen() {
   ESP_LOGD(LOG_TAG, "Show main screen");
 
@@ -329,6 +926,24 @@ void display_showStartupScreen() {
   display.updateWindow(0, 0, GxEPD_WIDTH, GxEPD_HEIGHT, false);
 }
 
+void display_showStartupSummary() {
+  char message[32] = "";
+  size_t len = 0;
+
+  for (size_t i = 0; i < STARTUP_JOB_COUNT; i++) {
+    startup_result_t result = startup_result(i);
+    if (result == STARTUP_FAILED || result == STARTUP_SKIPPED) {
+      len += snprintf(message + len, sizeof(message) - len, "%s%s!",
+                      len > 0 ? " " : "", startupJobs[i].name);
+      if (len >= sizeof(message)) {
+        break;
+      }
+    }
+  }
+
+  display_showStartupStatus(len > 0 ? message : "Ready");
+}
+
 void display_showStartupStatus(const char *message) {
   display.setTextColor(GxEPD_WHITE);
   display.fillScreen(GxEPD_BLACK);
@@ -342,47 +957,358 @@ void display_showStartupStatus(const char *message) {
 void aio_connectIfDisconnected() {
   ESP_LOGI(LOG_TAG, "Checking WiFi and AIO connection");
 
+  if (wifiConnecting) {
+    ESP_LOGD(LOG_TAG, "WiFi connect already in progress");
+    return;
+  }
+
   int wifiStatus = WiFi.status();
   if (wifiStatus == WL_CONNECT_FAILED || wifiStatus == WL_CONNECTION_LOST ||
       wifiStatus == WL_DISCONNECTED) {
     wifi_connect();
   }
+  http_startIfNeeded();
+}
+
+/*
+ The HTTP server reads the logs the SD card setup opens, so it starts from
+ the measure loop once that setup is done and WiFi is up, never next to the
+ startup jobs or a lazy mount.
+*/
+void http_startIfNeeded() {
+  if (httpServerStarted || WiFi.status() != WL_CONNECTED) {
+    return;
+  }
+  sd_mountIfNeeded();
+  httpserver_setup(&journal);
+  httpServerStarted = true;
+}
+
+static bool wifi_waitConnected(uint32_t start, uint32_t timeoutMs) {
+  while (WiFi.status() != WL_CONNECTED) {
+    if (millis() - start >= timeoutMs) {
+      return false;
+    }
+    delay(WIFI_POLL_MS);
+  }
+  return true;
+}
+
+/*
+ The MQTT and TLS handshake happens inside the status check of the library
+ whenever the session is down, so timing the check that brings it up gives
+ the connect latency.
+*/
+aio_status_t aio_sessionStatus() {
+  uint32_t start = millis();
+  aio_status_t status = io.status();
+  bool up = status >= AIO_CONNECTED;
+  if (up && !aioSessionUp) {
+    aioHandshakes++;
+    aioConnectMs = millis() - start;
+    ESP_LOGI(LOG_TAG, "Adafruit IO session up in %u ms (handshake %u)",
+             (unsigned)aioConnectMs, (unsigned)aioHandshakes);
+  } else if (!up && aioSessionUp) {
+    aioSessionDrops++;
+    ESP_LOGW(LOG_TAG, "Adafruit IO session lost (%d)", status);
+  }
+  aioSessionUp = up;
+  return status;
 }
 
 void wifi_connect() {
-  int status = 0;
-  int waitStates = 0;
+  // The WiFi startup job and the measure loop may both get here
+  if (wifiConnecting.exchange(true)) {
+    ESP_LOGD(LOG_TAG, "WiFi connect already in progress");
+    return;
+  }
+
+  wifi_cache_t *cache = &warmboot_state()->wifiCache;
+  uint32_t start = millis();
 
   io.connect();
-  // WiFi.begin(WIFI_SSID, WIFI_PASS);
+  bool directed = io.directed;
+  bool connected = wifi_waitConnected(
+      start, directed ? WIFI_DIRECTED_TIMEOUT_MS : WIFI_CONNECT_TIMEOUT_MS);
+  if (!connected && directed) {
+    ESP_LOGW(LOG_TAG, "Directed connect failed after %u ms, full scan",
+             (unsigned)(millis() - start));
+    wificache_invalidate(cache);
+    io.connect();
+    directed = false;
+    connected = wifi_waitConnected(millis(), WIFI_CONNECT_TIMEOUT_MS);
+  }
 
-  while (status != WL_CONNECTED && waitStates < 10) {
-    waitStates++;
-    ESP_LOGI(LOG_TAG, "Attempting to connect to network (%d/10)", waitStates);
-    status = WiFi.status();
+  wifiConnectMs = millis() - start;
+  if (connected) {
+    wificache_store(cache);
+    if (directed) {
+      wifiDirectedConnects++;
+    } else {
+      wifiScanConnects++;
+    }
+    ESP_LOGI(LOG_TAG, "WiFi connected in %u ms (%s)", (unsigned)wifiConnectMs,
+             directed ? "directed" : "full scan");
+  } else {
+    ESP_LOGW(LOG_TAG, "WiFi not connected after %u ms",
+             (unsigned)wifiConnectMs);
+  }
 
-    delay(1000);
+  wifiConnecting = false;
+}
+
+static size_t aio_topicLen(const char *feedKey) {
+  return strlen(IO_USERNAME) + strlen("/feeds/") + strlen(feedKey);
+}
+
+// MQTT bytes of a QoS 1 publish and its PUBACK, TCP and TLS not counted
+static size_t aio_publishBytes(const char *feedKey, size_t payloadLen) {
+  size_t remaining = 2 + aio_topicLen(feedKey) + 2 + payloadLen;
+  return 1 + (remaining < 128 ? 1 : 2) + remaining + 4;
+}
+
+// A feed value stamped with its time for the JSON topic of the feed, so one
+// sent late does not show up as a current reading
+static size_t aio_formatValue(char *payload, size_t len, float value,
+                              uint32_t time) {
+  char text[SAMPLE_VALUE_LEN];
+  fixfmt_formatFloat(text, sizeof(text), value, 2);
+  time_t t = time;
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  char createdAt[AIO_CREATED_AT_LEN];
+  strftime(createdAt, sizeof(createdAt), "%Y-%m-%dT%H:%M:%SZ", &tm);
+  return snprintf(payload, len, "{\"value\":%s,\"created_at\":\"%s\"}",
+                  text, createdAt);
+}
+
+static bool aio_publishValue(int channel, float value, uint32_t time,
+                             uint32_t now) {
+  char feed[AIO_TOPIC_LEN];
+  snprintf(feed, sizeof(feed), "%s/json", uploadFeeds[channel]);
+  char payload[AIO_VALUE_JSON_LEN];
+  size_t len = aio_formatValue(payload, sizeof(payload), value, time);
+  bool success = io.publish(feed, payload);
+  aioUploadsSent++;
+  aioUploadBytes += aio_publishBytes(feed, len);
+  if (!success) {
+    aioUploadFailures++;
+  }
+  ESP_LOGI(LOG_TAG, "Adafruit IO %s: %s from %u s ago, response %d",
+           rollingstats_channelName((rolling_channel_t)channel), payload,
+           (unsigned)(now - time), success);
+  return success;
+}
+
+// What sending the sample as a value per feed costs
+static size_t aio_sampleTextBytes(const bme680_sensor_data_t &sample) {
+  float values[ROLLING_CHANNEL_COUNT] = {
+      sample.temperature, sample.humidity, sample.pressure,
+      sample.flags & SAMPLE_FLAG_GAS_FRESH ? sample.airquality : NAN};
+  size_t bytes = 0;
+  for (int c = 0; c < ROLLING_CHANNEL_COUNT; c++) {
+    if (std::isnan(values[c])) {
+      continue;
+    }
+    char feed[AIO_TOPIC_LEN];
+    snprintf(feed, sizeof(feed), "%s/json", uploadFeeds[c]);
+    char payload[AIO_VALUE_JSON_LEN];
+    bytes += aio_publishBytes(
+        feed, aio_formatValue(payload, sizeof(payload), values[c],
+                              (uint32_t)sample.acquiringTime));
   }
+  return bytes;
 }
 
-void aio_sendSensorData(bme680_sensor_data_t sensorData) {
+/*
+ Queues the sample and sends recent data first, a value per feed and at
+ most one per feed every AIO_MIN_UPLOAD_INTERVAL_S: the current sample
+ through the upload filters, then the backlog of an outage newest first,
+ an aggregate with its mean at the middle of its span. Every value carries
+ its time as created_at. The queue is bounded, an outage merges its oldest
+ entries (see upload_batch.h).
+*/
+void aio_sendSensorData(sample_frame_t *frame, uint32_t sampleMillis) {
   ESP_LOGD(LOG_TAG, "Send sensor to Adafruit IO");
 
-  if (isAdafruitIoConnected()) {
-    bool temperatureSuccess = temperatureFeed->save(sensorData.temperature);
-    bool humiditySuccess = humidityFeed->save(sensorData.humidity);
-    bool pressureSuccess = pressureFeed->save(sensorData.pressure);
-    bool airqualitySuccess = airqualityFeed->save(sensorData.airquality);
-
-    ESP_LOGI(LOG_TAG,
-             "Adafruit IO feed response: temperature: %d, humidity: %d, "
-             "pressure: %d, airquality: %d",
-             temperatureSuccess, humiditySuccess, pressureSuccess,
-             airqualitySuccess);
-  } else {
-    ESP_LOGD(LOG_TAG, "Adafruit IO disconnected (%d). Skip sending data",
-             io.status());
+  warmboot_state_t *state = warmboot_state();
+  upload_queue_t *queue = &state->uploadQueue;
+  aioUploadSamples++;
+  uploadbatch_add(queue, frame->data);
+
+  uint32_t time = (uint32_t)frame->data.acquiringTime;
+  if (time >= state->lastUploadTime &&
+      time - state->lastUploadTime < AIO_MIN_UPLOAD_INTERVAL_S) {
+    ESP_LOGD(LOG_TAG, "Last upload %u s ago, skip sending data",
+             (unsigned)(time - state->lastUploadTime));
+    return;
+  }
+  if (!isAdafruitIoConnected()) {
+    ESP_LOGD(LOG_TAG, "Adafruit IO disconnected (%d), %u entries queued",
+             io.status(), queue->count);
+    return;
+  }
+
+  // A point a failed publish left pending would be replaced, the sample
+  // then waits in the queue with the backlog
+  if (state->uploadPendingMask == 0) {
+    const upload_entry_t &entry = queue->entries[queue->count - 1];
+    for (int c = 0; c < ROLLING_CHANNEL_COUNT; c++) {
+      const upload_channel_t &channel = entry.channels[c];
+      upload_point_t point;
+      if (uploadfilter_add(&state->uploadFilters[c], uploadFilterConfigs[c],
+                           entry.start, channel.count > 0 ? channel.mean : NAN,
+                           &point)) {
+        state->uploadPending[c] = point;
+        state->uploadPendingMask |= 1 << c;
+      }
+    }
+    uploadbatch_removeNewest(queue, 1);
+  }
+
+  // The rate limit of AIO_MIN_UPLOAD_INTERVAL_S also holds for a backlog
+  int budget = ROLLING_CHANNEL_COUNT;
+  bool success = true;
+  for (int c = 0; c < ROLLING_CHANNEL_COUNT && success; c++) {
+    if (!(state->uploadPendingMask & (1 << c))) {
+      continue;
+    }
+    const upload_point_t &point = state->uploadPending[c];
+    success = aio_publishValue(c, point.value, point.time, time);
+    budget--;
+    if (success) {
+      state->uploadPendingMask &= ~(1 << c);
+    }
   }
+
+  // An entry of the backlog only starts with the budget for all its feeds
+  while (success && queue->count > 0) {
+    const upload_entry_t &entry = queue->entries[queue->count - 1];
+    int feeds = 0;
+    for (int c = 0; c < ROLLING_CHANNEL_COUNT; c++) {
+      feeds += entry.channels[c].count > 0;
+    }
+    if (feeds > budget) {
+      break;
+    }
+    for (int c = 0; c < ROLLING_CHANNEL_COUNT && success; c++) {
+      if (entry.channels[c].count > 0) {
+        success = aio_publishValue(c, entry.channels[c].mean,
+                                   entry.start + entry.span / 2, time);
+        budget--;
+      }
+    }
+    if (success) {
+      uploadbatch_removeNewest(queue, 1);
+    }
+  }
+
+  if (budget == ROLLING_CHANNEL_COUNT) {
+    ESP_LOGD(LOG_TAG, "No feed changed beyond its tolerance");
+    return;
+  }
+  state->lastUploadTime = time;
+  aioUploadLatencyMs = millis() - sampleMillis;
+}
+
+// A publish has to fit into the packet buffer of the MQTT library, its base64
+// text what is left after the fixed header, the topic and the terminator
+#define AIO_BATCH_TEXT_LEN \
+  (MAXBUFFERSIZE - 7 - (sizeof(IO_USERNAME "/feeds/" AIO_BATCH_FEED) - 1))
+static_assert(AIO_BATCH_TEXT_LEN / 4 * 3 >= UPLOAD_BATCH_MAX_SINGLE_LEN,
+              "A batch entry does not fit into an MQTT publish, shorten "
+              "IO_USERNAME or AIO_BATCH_FEED");
+
+/*
+ Queues the sample and sends the queue newest first once it holds
+ AIO_BATCH_SAMPLES entries or its oldest is AIO_MAX_SILENCE_S old. The
+ queue is bounded, an outage merges its oldest entries (see upload_batch.h).
+*/
+void aio_sendBatch(sample_frame_t *frame, uint32_t sampleMillis) {
+  upload_queue_t *queue = &warmboot_state()->uploadQueue;
+  aioUploadSamples++;
+  uploadbatch_add(queue, frame->data);
+
+  uint32_t age = (uint32_t)frame->data.acquiringTime - queue->entries[0].start;
+  if (queue->count < AIO_BATCH_SAMPLES && age < AIO_MAX_SILENCE_S) {
+    return;
+  }
+  if (!isAdafruitIoConnected()) {
+    ESP_LOGD(LOG_TAG, "Adafruit IO disconnected, %u entries queued",
+             queue->count);
+    return;
+  }
+
+  char text[MAXBUFFERSIZE];
+  uint8_t payload[MAXBUFFERSIZE];
+  size_t sampleTextBytes = aio_sampleTextBytes(frame->data);
+  while (queue->count > 0) {
+    // Never 0, any single entry fits (see the static_assert above)
+    uint8_t count;
+    size_t len = uploadbatch_encodeNewest(*queue, payload,
+                                          AIO_BATCH_TEXT_LEN / 4 * 3, &count);
+    uploadbatch_base64(payload, len, text, sizeof(text));
+    bool success = io.publish(AIO_BATCH_FEED, text);
+    aioUploadsSent++;
+    size_t bytes = aio_publishBytes(AIO_BATCH_FEED, strlen(text));
+    aioUploadBytes += bytes;
+    if (!success) {
+      aioUploadFailures++;
+      break;
+    }
+
+    uint32_t queued = uploadbatch_samples(*queue);
+    uploadbatch_removeNewest(queue, count);
+    uint32_t samples = queued - uploadbatch_samples(*queue);
+    LOGSINK("Batch of %u samples: %u bytes, %u per sample (%u as feeds)\n",
+            (unsigned)samples, (unsigned)bytes, (unsigned)(bytes / samples),
+            (unsigned)sampleTextBytes);
+  }
+  aioUploadLatencyMs = millis() - sampleMillis;
+}
+
+/*
+ Fast path for alerts: evaluated right after the sample is read and sent
+ to the alerts feed before the cycle does anything else. Alerts the broker
+ did not acknowledge stay pending in RTC memory and are sent again with
+ every following sample. Returns the number of rules this sample fired.
+*/
+size_t aio_sendAlerts(const bme680_sensor_data_t &sample,
+                      uint32_t sampleMillis) {
+  warmboot_state_t *state = warmboot_state();
+  size_t ruleCount = sizeof(alertRules) / sizeof(alertRules[0]);
+  size_t fired =
+      alert_evaluate(&state->alerts, alertRules, ruleCount, sample);
+  alert_event_t events[ALERT_MAX_RULES];
+  size_t count = alert_pending(state->alerts, alertRules, ruleCount, events,
+                               ALERT_MAX_RULES);
+  if (count == 0) {
+    return 0;
+  }
+
+  if (!isAdafruitIoConnected()) {
+    aio_connectIfDisconnected();
+  }
+
+  uint32_t time = (uint32_t)sample.acquiringTime;
+  char message[ALERT_MESSAGE_LEN];
+  for (size_t i = 0; i < count; i++) {
+    alert_formatMessage(events[i], message, sizeof(message));
+    // publish() returns once the broker acknowledged the QoS 1 message
+    bool success = isAdafruitIoConnected() && io.publish(AIO_ALERT_FEED, message);
+    uint32_t latency = (time - events[i].time) * 1000 + millis() - sampleMillis;
+    if (success) {
+      alert_acknowledge(&state->alerts, events[i], time);
+      alertsSent++;
+      alertLatencyMs = latency;
+      if (latency > alertWorstLatencyMs) {
+        alertWorstLatencyMs = latency;
+      }
+    }
+    LOGSINK("Alert %s, %s after %u ms\n", message,
+            success ? "sent" : "pending", (unsigned)latency);
+  }
+  return fired;
 }
 
 void aio_checkIoEventsIfConnected() {
@@ -493,7 +1419,7 @@ void appendFile(fs::FS &fs, const char *path, const char *message) {
   if (file.print(message)) {
     ESP_LOGD(LOG_TAG, "Message appended");
   } else {
-    Serial.println("Append failed");
+    ESP_LOGW(LOG_TAG, "Append failed");
   }
   file.close();
 }
@@ -516,57 +1442,115 @@ void deleteFile(fs::FS &fs, const char *path) {
   }
 }
 
-/* void testFileIO(fs::FS &fs, const char *path) {
-  File file = fs.open(path);
-  static uint8_t buf[512];
-  size_t len = 0;
-  uint32_t start = millis();
-  uint32_t end = start;
-  if (file) {
-    len = file.size();
-    size_t flen = len;
-    start = millis();
-    while (len) {
-      size_t toRead = len;
-      if (toRead > 512) {
-        toRead = 512;
-      }
-      file.read(buf, toRead);
-      len -= toRead;
+void sd_benchCommand(const char *args) {
+  Serial.println("SD benchmark starts with the next measure cycle");
+  sdBenchRequested = true;
+}
+
+void sd_listCommand(const char *args) {
+  if (!sdMounted) {
+    Serial.println("No SD card mounted");
+    return;
+  }
+  listDir(SD, *args != '\0' ? args : "/", 1);
+}
+
+/*
+ The logical end of a datalog segment at path, UINT32_MAX for other files.
+ For the open segment it comes from a locked snapshot of its header, so the
+ export neither races the appends nor sends the zero filled rest.
+*/
+static uint32_t sd_exportEnd(const char *path) {
+  datalog_t *logs[] = {&journal, retention_tierLog(RETENTION_TIER_FINE),
+                       retention_tierLog(RETENTION_TIER_COARSE)};
+
+  for (size_t i = 0; i < sizeof(logs) / sizeof(logs[0]); i++) {
+    size_t dirLen = strlen(logs[i]->dir);
+    if (!logs[i]->mounted || strncmp(path, logs[i]->dir, dirLen) != 0 ||
+        path[dirLen] != '/') {
+      continue;
+    }
+    char *suffix;
+    uint32_t segment = strtoul(path + dirLen + 1, &suffix, 10);
+    datalog_segment_header_t header;
+    if (strcmp(suffix, ".log") == 0 &&
+        datalog_segmentHeader(logs[i], segment, &header)) {
+      return header.end;
     }
-    end = millis() - start;
-    Serial.printf("%u bytes read for %u ms\n", flen, end);
-    file.close();
-  } else {
-    Serial.println("Failed to open file for reading");
   }
+  return UINT32_MAX;
+}
 
-  file = fs.open(path, FILE_WRITE);
-  if (!file) {
-    Serial.println("Failed to open file for writing");
+/*
+ export <path> [offset [z]]: streams the file with the framed export
+ protocol, starting at offset and deflating the chunks if z is given.
+*/
+void sd_exportCommand(const char *args) {
+  char path[DATALOG_PATH_LEN];
+  unsigned long offset = 0;
+  char mode[2] = "";
+
+  if (sscanf(args, "%31s %lu %1s", path, &offset, mode) < 1) {
+    Serial.println("Usage: export <path> [offset [z]]");
     return;
   }
+  if (!sdMounted) {
+    Serial.println("No SD card mounted");
+    return;
+  }
+  serialexport_send(SD, path, offset, sd_exportEnd(path), mode[0] == 'z');
+}
 
-  size_t i;
-  start = millis();
-  for (i = 0; i < 2048; i++) {
-    file.write(buf, 512);
+void sd_runBenchmark() {
+  sd_mountIfNeeded();
+  if (!sdMounted) {
+    LOGSINK("SD benchmark skipped, no card mounted\n");
+    return;
   }
-  end = millis() - start;
-  Serial.printf("%u bytes written for %u ms\n", 2048 * 512, end);
-  file.close();
+
+  uint32_t start = millis();
+  sdbench_run(SD, SD_BENCH_PATH, sd_printBenchmarkResult);
+  LOGSINK("SD benchmark finished after %lu ms\n", millis() - start);
 }
- */
+
+void sd_printBenchmarkResult(const sdbench_result_t &result) {
+  LOGSINK("SD %-10s %5u B x %4u: %7.3f MB/s, p50 %u us, p99 %u us, max %u us\n",
+          sdbench_testName(result.test), (unsigned)result.blockSize,
+          (unsigned)result.ops, sdbench_megabytesPerSecond(result),
+          (unsigned)result.p50Micros, (unsigned)result.p99Micros,
+          (unsigned)result.maxMicros);
+}
+
+// Spreads the allocation of the next segments over the measure cycles
+void sd_prepareSegments() {
+  if (journal.mounted && datalog_prepare(&journal, DATALOG_PREPARE_CHUNK)) {
+    retention_prepare(DATALOG_PREPARE_CHUNK);
+  }
+}
+
+void sd_mountIfNeeded() {
+  if (!sdMountAttempted) {
+    sd_setup();
+  }
+}
+
 void sd_setup() {
+  if (sd_mount()) {
+    sd_openLogs();
+  }
+}
+
+bool sd_mount() {
+  sdMountAttempted = true;
   if (!SD.begin()) {
     ESP_LOGW(LOG_TAG, "Card Mount Failed");
-    return;
+    return false;
   }
   uint8_t cardType = SD.cardType();
 
   if (cardType == CARD_NONE) {
     ESP_LOGW(LOG_TAG, "No SD card attached");
-    return;
+    return false;
   }
 
   const char *cardTypeName;
@@ -583,4 +1567,12 @@ void sd_setup() {
 
   uint64_t cardSize = SD.cardSize() / (1024 * 1024);
   ESP_LOGD(LOG_TAG, "SD Card Size: %lluMB", cardSize);
+  return true;
+}
+
+void sd_openLogs() {
+  sdMounted = true;
+
+  datalog_open(&journal, SD, DATALOG_DIR);
+  retention_setup(SD, &journal, &warmboot_state()->retention);
 }
@@ -1,17 +1,43 @@
 #ifndef SYNC_MEASURE_H
 #define SYNC_MEASURE_H
 
+#include <cstdint>
 #include <ctime>
 
+// airquality was measured in this cycle, otherwise it is the last gas
+// reading held
+#define SAMPLE_FLAG_GAS_FRESH 0x01
+// The sensor was read successfully, invalid samples must not be used
+#define SAMPLE_FLAG_VALID 0x02
+
 typedef struct {
     time_t acquiringTime;
     float temperature;
     float humidity;
     float pressure;
     float airquality;
+    float iaq;            // index 0-500, see iaq.h
+    uint8_t iaqAccuracy;  // iaq_accuracy_t
+    uint8_t flags;
 } bme680_sensor_data_t;
 
+typedef struct {
+    uint8_t temperatureOversampling;
+    uint8_t humidityOversampling;
+    uint8_t pressureOversampling;
+    uint8_t iirFilterSize;
+    uint16_t heaterTemperature;
+    uint16_t heaterDuration;
+} bme680_config_t;
+
 void setupSyncMeasure();
 void measureLoop();
+// Time from the start of the last measure cycle to the next one
+uint32_t measureIntervalMs();
+// Longest the loop may wait awake before calling measureKeepalive(), which
+// keeps the network session from timing out
+uint32_t measureKeepaliveMs();
+void measureKeepalive();
+void suspendSyncMeasure();
 
 #endif
\ No newline at end of file
@@ -26,12 +26,16 @@ void systime_setup() {
     time(&now);
   }
 
+  systime_setupTimezone();
+
+  // xEventGroupSetBits(m_sntpEventGroup, DATE_SET_BIT);
+}
+
+void systime_setupTimezone() {
   // Set timezone to China Standard Time
   //    putenv("TZ=cet-1cest,m3.5.0,m10.5.0");
   setenv("TZ", "cet-1cest,m3.5.0,m10.5.0", 1);
   tzset();
-
-  // xEventGroupSetBits(m_sntpEventGroup, DATE_SET_BIT);
 }
 
 void systime_obtainTime() {
@@ -4,6 +4,7 @@
 #include <ctime>
 
 void systime_setup();
+void systime_setupTimezone();
 void systime_createCurrentTimeOutput(time_t timestamp, char *strftime_buf, size_t buf_len, const char *pattern);
 
 #endif
\ No newline at end of file
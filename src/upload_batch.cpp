@@ -0,0 +1,274 @@
+#include "upload_batch.h"
+#include "eprobe.h"
+
+#include <cmath>
+#include <cstring>
+
+// CBOR major types
+#define CBOR_UNSIGNED 0x00
+#define CBOR_NEGATIVE 0x20
+#define CBOR_ARRAY 0x80
+#define CBOR_NULL 0xf6
+
+typedef struct {
+  uint8_t *buf;
+  size_t len;
+  size_t length;
+} cbor_writer_t;
+
+static void cbor_writeHead(cbor_writer_t *w, uint8_t major, uint32_t value) {
+  uint8_t head[5];
+  size_t n;
+  if (value < 24) {
+    head[0] = major | value;
+    n = 1;
+  } else if (value <= 0xff) {
+    head[0] = major | 24;
+    head[1] = value;
+    n = 2;
+  } else if (value <= 0xffff) {
+    head[0] = major | 25;
+    head[1] = value >> 8;
+    head[2] = value;
+    n = 3;
+  } else {
+    head[0] = major | 26;
+    head[1] = value >> 24;
+    head[2] = value >> 16;
+    head[3] = value >> 8;
+    head[4] = value;
+    n = 5;
+  }
+  if (w->length + n <= w->len) {
+    memcpy(w->buf + w->length, head, n);
+  }
+  w->length += n;
+}
+
+static void cbor_writeInt(cbor_writer_t *w, int32_t value) {
+  if (value >= 0) {
+    cbor_writeHead(w, CBOR_UNSIGNED, value);
+  } else {
+    cbor_writeHead(w, CBOR_NEGATIVE, (uint32_t)(-1 - value));
+  }
+}
+
+// NaN becomes null
+static void cbor_writeFixed(cbor_writer_t *w, float value, int32_t scale) {
+  if (std::isnan(value)) {
+    if (w->length < w->len) {
+      w->buf[w->length] = CBOR_NULL;
+    }
+    w->length++;
+    return;
+  }
+  cbor_writeInt(w, (int32_t)lroundf(value * scale));
+}
+
+static constexpr int32_t channelScales[UPLOAD_BATCH_CHANNELS] = {
+    UPLOAD_BATCH_TEMPERATURE_SCALE, UPLOAD_BATCH_HUMIDITY_SCALE,
+    UPLOAD_BATCH_PRESSURE_SCALE, UPLOAD_BATCH_GAS_SCALE,
+    UPLOAD_BATCH_IAQ_SCALE};
+// Sensor ranges the values are clamped to, they bound the row length
+static constexpr float channelMins[UPLOAD_BATCH_CHANNELS] = {-40, 0, 30000,
+                                                             0, 0};
+static constexpr float channelMaxs[UPLOAD_BATCH_CHANNELS] = {85, 100, 110000,
+                                                             1e9f, 500};
+
+static constexpr size_t cbor_intLen(int64_t value) {
+  return value < 0         ? cbor_intLen(-1 - value)
+         : value < 24      ? 1
+         : value <= 0xff   ? 2
+         : value <= 0xffff ? 3
+                           : 5;
+}
+
+static constexpr size_t uploadbatch_valueLen(int c) {
+  return cbor_intLen((int64_t)(channelMins[c] * channelScales[c])) >
+                 cbor_intLen((int64_t)(channelMaxs[c] * channelScales[c]))
+             ? cbor_intLen((int64_t)(channelMins[c] * channelScales[c]))
+             : cbor_intLen((int64_t)(channelMaxs[c] * channelScales[c]));
+}
+
+static_assert(1 + 1 + 5 + 5 +
+                      3 * (uploadbatch_valueLen(0) + uploadbatch_valueLen(1) +
+                           uploadbatch_valueLen(2) + uploadbatch_valueLen(3) +
+                           uploadbatch_valueLen(4)) <=
+                  UPLOAD_BATCH_MAX_ROW_LEN,
+              "UPLOAD_BATCH_MAX_ROW_LEN does not cover the channel ranges");
+
+// NaN becomes null, anything else is clamped to the sensor range
+static void uploadbatch_writeValue(cbor_writer_t *w, float value, int c) {
+  if (value < channelMins[c]) {
+    value = channelMins[c];
+  } else if (value > channelMaxs[c]) {
+    value = channelMaxs[c];
+  }
+  cbor_writeFixed(w, value, channelScales[c]);
+}
+
+// Buckets that neighbouring entries are merged into, finest first
+static const uint32_t bucketPeriods[] = {300, 3600, 6 * 3600, 24 * 3600};
+
+static uint32_t uploadbatch_entrySamples(const upload_entry_t &entry) {
+  uint32_t samples = 0;
+  for (int c = 0; c < UPLOAD_BATCH_CHANNELS; c++) {
+    if (entry.channels[c].count > samples) {
+      samples = entry.channels[c].count;
+    }
+  }
+  return samples;
+}
+
+static void uploadbatch_writeRow(cbor_writer_t *w, const upload_entry_t &entry,
+                                 int32_t dt) {
+  bool aggregate = entry.span > 0 || uploadbatch_entrySamples(entry) > 1;
+  cbor_writeHead(w, CBOR_ARRAY,
+                 aggregate ? UPLOAD_BATCH_AGGREGATE_FIELDS
+                           : UPLOAD_BATCH_SAMPLE_FIELDS);
+  cbor_writeInt(w, dt);
+  if (aggregate) {
+    cbor_writeInt(w, entry.span);
+    cbor_writeInt(w, uploadbatch_entrySamples(entry));
+  }
+  for (int c = 0; c < UPLOAD_BATCH_CHANNELS; c++) {
+    const upload_channel_t &channel = entry.channels[c];
+    float mean = channel.count > 0 ? channel.mean : NAN;
+    if (aggregate) {
+      uploadbatch_writeValue(w, channel.count > 0 ? channel.min : NAN, c);
+      uploadbatch_writeValue(w, channel.count > 0 ? channel.max : NAN, c);
+    }
+    uploadbatch_writeValue(w, mean, c);
+  }
+}
+
+// Merges entry i + 1 into entry i
+static void uploadbatch_merge(upload_queue_t *queue, uint8_t i) {
+  upload_entry_t *a = &queue->entries[i];
+  const upload_entry_t &b = queue->entries[i + 1];
+  a->span = b.start + b.span - a->start;
+  for (int c = 0; c < UPLOAD_BATCH_CHANNELS; c++) {
+    upload_channel_t *x = &a->channels[c];
+    const upload_channel_t &y = b.channels[c];
+    if (y.count == 0) {
+      continue;
+    }
+    if (x->count == 0) {
+      *x = y;
+      continue;
+    }
+    x->min = y.min < x->min ? y.min : x->min;
+    x->max = y.max > x->max ? y.max : x->max;
+    x->mean = (x->mean * x->count + y.mean * y.count) / (x->count + y.count);
+    x->count += y.count;
+  }
+
+  memmove(&queue->entries[i + 1], &queue->entries[i + 2],
+          (queue->count - i - 2) * sizeof(queue->entries[0]));
+  queue->count--;
+  queue->merges++;
+}
+
+static void uploadbatch_compact(upload_queue_t *queue) {
+  for (uint32_t period : bucketPeriods) {
+    for (uint8_t i = 0; i + 1 < queue->count; i++) {
+      const upload_entry_t &a = queue->entries[i];
+      const upload_entry_t &b = queue->entries[i + 1];
+      if (a.start / period == (b.start + b.span) / period) {
+        uploadbatch_merge(queue, i);
+        return;
+      }
+    }
+  }
+  uploadbatch_merge(queue, 0);
+}
+
+void uploadbatch_add(upload_queue_t *queue,
+                     const bme680_sensor_data_t &sample) {
+  if (queue->count == UPLOAD_QUEUE_LEN) {
+    uploadbatch_compact(queue);
+  }
+
+  float values[UPLOAD_BATCH_CHANNELS] = {
+      sample.temperature, sample.humidity, sample.pressure,
+      sample.flags & SAMPLE_FLAG_GAS_FRESH ? sample.airquality : NAN,
+      sample.iaqAccuracy > 0 ? sample.iaq : NAN};
+  upload_entry_t *entry = &queue->entries[queue->count++];
+  entry->start = (uint32_t)sample.acquiringTime;
+  entry->span = 0;
+  for (int c = 0; c < UPLOAD_BATCH_CHANNELS; c++) {
+    bool valid = !std::isnan(values[c]);
+    entry->channels[c] = {values[c], values[c], values[c], valid ? 1u : 0u};
+  }
+}
+
+uint32_t uploadbatch_samples(const upload_queue_t &queue) {
+  uint32_t samples = 0;
+  for (uint8_t i = 0; i < queue.count; i++) {
+    samples += uploadbatch_entrySamples(queue.entries[i]);
+  }
+  return samples;
+}
+
+// Encodes count entries from first on, 0 if they do not fit
+static size_t uploadbatch_encode(const upload_queue_t &queue, uint8_t first,
+                                 uint8_t count, uint8_t *out, size_t len) {
+  cbor_writer_t w = {out, len, 0};
+  uint32_t previous = queue.entries[first].start;
+  cbor_writeHead(&w, CBOR_ARRAY, 3);
+  cbor_writeInt(&w, UPLOAD_BATCH_VERSION);
+  cbor_writeHead(&w, CBOR_UNSIGNED, previous);
+  cbor_writeHead(&w, CBOR_ARRAY, count);
+  for (uint8_t i = first; i < first + count; i++) {
+    const upload_entry_t &entry = queue.entries[i];
+    uploadbatch_writeRow(&w, entry, (int32_t)(entry.start - previous));
+    previous = entry.start;
+  }
+  return w.length <= len ? w.length : 0;
+}
+
+size_t uploadbatch_encodeNewest(const upload_queue_t &queue, uint8_t *out,
+                                size_t len, uint8_t *count) {
+  uint8_t n = queue.count < UPLOAD_BATCH_MAX_ROWS ? queue.count
+                                                  : UPLOAD_BATCH_MAX_ROWS;
+  for (; n > 0; n--) {
+    size_t length = uploadbatch_encode(queue, queue.count - n, n, out, len);
+    if (length > 0) {
+      *count = n;
+      return length;
+    }
+  }
+  *count = 0;
+  return 0;
+}
+
+void uploadbatch_removeNewest(upload_queue_t *queue, uint8_t count) {
+  queue->count = count < queue->count ? queue->count - count : 0;
+}
+
+size_t uploadbatch_base64(const uint8_t *data, size_t dataLen, char *out,
+                          size_t len) {
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  size_t length = (dataLen + 2) / 3 * 4;
+  if (length + 1 > len) {
+    return 0;
+  }
+  char *p = out;
+  for (size_t i = 0; i < dataLen; i += 3) {
+    uint32_t bits = (uint32_t)data[i] << 16;
+    if (i + 1 < dataLen) {
+      bits |= (uint32_t)data[i + 1] << 8;
+    }
+    if (i + 2 < dataLen) {
+      bits |= data[i + 2];
+    }
+    *p++ = alphabet[(bits >> 18) & 0x3f];
+    *p++ = alphabet[(bits >> 12) & 0x3f];
+    *p++ = i + 1 < dataLen ? alphabet[(bits >> 6) & 0x3f] : '=';
+    *p++ = i + 2 < dataLen ? alphabet[bits & 0x3f] : '=';
+  }
+  *p = '\0';
+  return length;
+}
\ No newline at end of file
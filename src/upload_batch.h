@@ -0,0 +1,98 @@
+#ifndef UPLOAD_BATCH_H
+#define UPLOAD_BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sync_measure.h"
+
+// Entries of the upload queue, override with a build flag. Each takes 88
+// bytes of RTC memory.
+#ifndef UPLOAD_QUEUE_LEN
+#define UPLOAD_QUEUE_LEN 16
+#endif
+
+#define UPLOAD_BATCH_VERSION 2
+// Fixed point scales of the encoded values
+#define UPLOAD_BATCH_TEMPERATURE_SCALE 100  // 0.01 *C
+#define UPLOAD_BATCH_HUMIDITY_SCALE 100     // 0.01 %
+#define UPLOAD_BATCH_PRESSURE_SCALE 1       // Pa
+#define UPLOAD_BATCH_GAS_SCALE 1            // Ohm
+#define UPLOAD_BATCH_IAQ_SCALE 1
+// Temperature, humidity, pressure, gas resistance and IAQ, in this order
+#define UPLOAD_BATCH_CHANNELS 5
+// Values per row of a sample and of an aggregate
+#define UPLOAD_BATCH_SAMPLE_FIELDS (1 + UPLOAD_BATCH_CHANNELS)
+#define UPLOAD_BATCH_AGGREGATE_FIELDS (3 + 3 * UPLOAD_BATCH_CHANNELS)
+// Rows per payload, the row count is then a single byte
+#define UPLOAD_BATCH_MAX_ROWS 23
+// Longest encoding of a payload with a single aggregate row. Values are
+// clamped to the sensor range, which keeps temperature, humidity and IAQ
+// within 3 bytes, pressure, gas resistance, span and samples take up to 5
+// and dt of the first row is 0.
+#define UPLOAD_BATCH_MAX_ROW_LEN (1 + 1 + 5 + 5 + 3 * (3 + 3 + 5 + 5 + 3))
+#define UPLOAD_BATCH_MAX_SINGLE_LEN (1 + 1 + 5 + 1 + UPLOAD_BATCH_MAX_ROW_LEN)
+
+/*
+ Bounded upload queue and its batch payload, shared with the host decoder
+ in tools/batch_decoder.
+
+ The queue holds at most UPLOAD_QUEUE_LEN entries in time order, each a
+ single sample or an aggregate (min, max, mean) of consecutive samples.
+ Adding to a full queue merges the oldest two neighbours that fall into the
+ same 5 minute bucket, failing that the same hour, 6 hours or day, and
+ failing all the two oldest entries. Nothing is dropped: the backlog of a
+ long outage is kept at a resolution that gets coarser with its age, while
+ the recent samples stay raw. The senders take the newest entries first.
+
+ Entries are encoded as CBOR (RFC 8949):
+   [version, first time, [row, ...]]
+ with a sample row
+   [dt, temperature, humidity, pressure, gas, iaq]
+ and an aggregate row
+   [dt, span, samples, temperature min, max, mean, humidity min, ...]
+ Times are Unix seconds, dt is the difference to the previous row (to the
+ first time for the first row) and span the seconds from the first to the
+ last sample of an aggregate. All values are integers in the fixed point
+ scales above, clamped to the sensor range. A gas resistance that was not
+ measured with the sample and an IAQ that is not yet estimated are null.
+ The payload goes out as base64 text since Adafruit IO feeds only take text
+ values.
+
+ The queue is plain data so it can live in RTC memory across deep sleep.
+*/
+typedef struct {
+  float min;
+  float max;
+  float mean;
+  uint32_t count;
+} upload_channel_t;
+
+typedef struct {
+  uint32_t start;  // time of the first sample
+  uint32_t span;   // 0 for a single sample
+  upload_channel_t channels[UPLOAD_BATCH_CHANNELS];
+} upload_entry_t;
+
+typedef struct {
+  upload_entry_t entries[UPLOAD_QUEUE_LEN];
+  uint8_t count;
+  uint32_t merges;
+} upload_queue_t;
+
+// Appends a sample, merging older entries if the queue is full
+void uploadbatch_add(upload_queue_t *queue, const bme680_sensor_data_t &sample);
+// Samples represented by the queue
+uint32_t uploadbatch_samples(const upload_queue_t &queue);
+// Encodes the newest entries that fit into len bytes. Returns the payload
+// length and the number of entries encoded, 0 if not even one fits.
+size_t uploadbatch_encodeNewest(const upload_queue_t &queue, uint8_t *out,
+                                size_t len, uint8_t *count);
+// Removes the count newest entries, after they have been sent
+void uploadbatch_removeNewest(upload_queue_t *queue, uint8_t count);
+// Writes data as zero terminated base64 and returns its length, 0 if it
+// does not fit into len
+size_t uploadbatch_base64(const uint8_t *data, size_t dataLen, char *out,
+                          size_t len);
+
+#endif
\ No newline at end of file
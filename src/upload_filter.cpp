@@ -0,0 +1,106 @@
+#include "upload_filter.h"
+#include "eprobe.h"
+
+#include <cmath>
+
+static void uploadfilter_archive(upload_filter_t *filter,
+                                 const upload_point_t &point,
+                                 upload_point_t *out) {
+  filter->archived = point;
+  filter->holding = false;
+  filter->sent++;
+  *out = point;
+}
+
+/*
+ Moves point onto the line from the archived point with the slope within the
+ door closest to its own, so the line to it stays within the tolerance of
+ every value since. It moves by at most the tolerance.
+*/
+static upload_point_t uploadfilter_onDoor(const upload_filter_t *filter,
+                                          const upload_point_t &point) {
+  float seconds = point.time - filter->archived.time;
+  float slope = (point.value - filter->archived.value) / seconds;
+  if (slope > filter->upperSlope) {
+    slope = filter->upperSlope;
+  } else if (slope < filter->lowerSlope) {
+    slope = filter->lowerSlope;
+  }
+  return {point.time, filter->archived.value + slope * seconds};
+}
+
+// Narrows the door from the archived point to the tolerance band of point,
+// false and unchanged if it would close
+static bool uploadfilter_narrow(upload_filter_t *filter,
+                                const upload_filter_config_t &config,
+                                const upload_point_t &point) {
+  float seconds = point.time - filter->archived.time;
+  float upper = (point.value + config.tolerance - filter->archived.value) /
+                seconds;
+  float lower = (point.value - config.tolerance - filter->archived.value) /
+                seconds;
+
+  if (!filter->holding) {
+    filter->upperSlope = upper;
+    filter->lowerSlope = lower;
+    filter->holding = true;
+    return true;
+  }
+  if (upper > filter->upperSlope) {
+    upper = filter->upperSlope;
+  }
+  if (lower < filter->lowerSlope) {
+    lower = filter->lowerSlope;
+  }
+  if (lower > upper) {
+    return false;
+  }
+  filter->upperSlope = upper;
+  filter->lowerSlope = lower;
+  return true;
+}
+
+bool uploadfilter_add(upload_filter_t *filter,
+                      const upload_filter_config_t &config, uint32_t time,
+                      float value, upload_point_t *point) {
+  upload_point_t current = {time, value};
+  if (std::isnan(value)) {
+    return false;
+  }
+  if (!filter->started || time <= filter->archived.time ||
+      (filter->holding && time <= filter->held.time)) {
+    // First value or a clock step, start over
+    filter->started = true;
+    uploadfilter_archive(filter, current, point);
+    return true;
+  }
+
+  // Noise within the deadband does not move the series
+  float reference =
+      filter->holding ? filter->held.value : filter->archived.value;
+  if (fabsf(value - reference) < config.deadband) {
+    current.value = reference;
+  }
+
+  if (filter->holding) {
+    if (!uploadfilter_narrow(filter, config, current)) {
+      // The held point is the last one the door could reach
+      uploadfilter_archive(filter, uploadfilter_onDoor(filter, filter->held),
+                           point);
+      uploadfilter_narrow(filter, config, current);
+      filter->held = current;
+      return true;
+    }
+    // The held point is dropped for the current one
+    filter->suppressed++;
+  } else {
+    uploadfilter_narrow(filter, config, current);
+  }
+  filter->held = current;
+
+  if (time - filter->archived.time >= config.maxSilence) {
+    uploadfilter_archive(filter, uploadfilter_onDoor(filter, current), point);
+    return true;
+  }
+  return false;
+}
\ No newline at end of file
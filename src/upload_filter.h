@@ -0,0 +1,53 @@
+#ifndef UPLOAD_FILTER_H
+#define UPLOAD_FILTER_H
+
+#include <cstdint>
+
+/*
+ Exception and swinging door compression of a feed, as in process
+ historians.
+
+ A value that differs from the last value passed on by less than the
+ deadband is taken as that value, so noise does not move the series. The
+ values are then compressed: the "door" is the range of slopes from the
+ last uploaded point that keep every value since within the tolerance.
+ While it stays open, the newest value is only held. When it closes, the
+ held value is the last one a straight line can reach and is uploaded, and
+ the door starts over from it. A held value is uploaded at the latest
+ maxSilence seconds after the previous upload. An uploaded value is moved
+ onto the door, by at most the tolerance, so the series rebuilt by linear
+ interpolation between uploaded points stays within deadband + tolerance of
+ every sample (see test/host/upload_filter).
+
+ The feed has no timestamps, an uploaded point arrives one sample later than
+ it was taken.
+*/
+typedef struct {
+  float deadband;
+  float tolerance;
+  uint32_t maxSilence;  // seconds
+} upload_filter_config_t;
+
+typedef struct {
+  uint32_t time;
+  float value;
+} upload_point_t;
+
+// Plain data so it can live in RTC memory across deep sleep
+typedef struct {
+  upload_point_t archived;  // last uploaded point
+  upload_point_t held;      // newest point within the door
+  float upperSlope;
+  float lowerSlope;
+  bool started;
+  bool holding;
+  uint32_t sent;
+  uint32_t suppressed;
+} upload_filter_t;
+
+// Returns true with the point to upload in point when the series needs one
+bool uploadfilter_add(upload_filter_t *filter,
+                      const upload_filter_config_t &config, uint32_t time,
+                      float value, upload_point_t *point);
+
+#endif
\ No newline at end of file
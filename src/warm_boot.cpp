@@ -0,0 +1,38 @@
+#include "warm_boot.h"
+#include "eprobe.h"
+
+#include <Arduino.h>
+#include "esp_timer.h"
+
+#define WARMBOOT_MAGIC 0x45505231  // "EPR1"
+
+static const char *LOG_TAG = "WarmBoot";
+
+RTC_DATA_ATTR static warmboot_state_t rtcState;
+static bool warmBoot = false;
+
+void warmboot_setup() {
+  esp_sleep_wakeup_cause_t wakeupReason = esp_sleep_get_wakeup_cause();
+  warmBoot =
+      wakeupReason == ESP_SLEEP_WAKEUP_TIMER && rtcState.magic == WARMBOOT_MAGIC;
+
+  if (!warmBoot) {
+    warmboot_invalidate();
+  }
+  ESP_LOGI(LOG_TAG, "%s boot (wakeup cause %d)", warmBoot ? "Warm" : "Cold",
+           wakeupReason);
+}
+
+bool warmboot_isWarmBoot() { return warmBoot; }
+
+warmboot_state_t *warmboot_state() { return &rtcState; }
+
+void warmboot_commit() { rtcState.magic = WARMBOOT_MAGIC; }
+
+void warmboot_invalidate() {
+  rtcState = warmboot_state_t{};
+}
+
+uint32_t warmboot_millisSinceBoot() {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
\ No newline at end of file
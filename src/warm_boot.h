@@ -0,0 +1,47 @@
+#ifndef WARM_BOOT_H
+#define WARM_BOOT_H
+
+#include <cstdint>
+
+#include "adaptive_sampling.h"
+#include "alert.h"
+#include "iaq.h"
+#include "multi_rate.h"
+#include "retention.h"
+#include "sample_history.h"
+#include "sync_measure.h"
+#include "upload_batch.h"
+#include "upload_filter.h"
+#include "wifi_cache.h"
+
+// State kept in RTC slow memory across deep sleep. It is only trusted after
+// a timer wakeup and when the magic matches, otherwise the probe cold boots.
+typedef struct {
+  uint32_t magic;
+  uint16_t cycleCounter;
+  bool mainScreenShown;
+  bme680_config_t fastSensorConfig;  // heater off
+  bme680_config_t gasSensorConfig;
+  multirate_state_t multiRate;
+  iaq_state_t iaq;
+  alert_state_t alerts;
+  uint32_t wakeToSampleMs;
+  adaptive_sampling_state_t sampling;
+  uint32_t lastUploadTime;
+  upload_filter_t uploadFilters[ROLLING_CHANNEL_COUNT];
+  upload_point_t uploadPending[ROLLING_CHANNEL_COUNT];
+  uint8_t uploadPendingMask;  // bit per channel with a point to upload
+  upload_queue_t uploadQueue;
+  wifi_cache_t wifiCache;
+  retention_state_t retention;
+  sample_history_t sampleHistory;
+} warmboot_state_t;
+
+void warmboot_setup();
+bool warmboot_isWarmBoot();
+warmboot_state_t *warmboot_state();
+void warmboot_commit();
+void warmboot_invalidate();
+uint32_t warmboot_millisSinceBoot();
+
+#endif
\ No newline at end of file
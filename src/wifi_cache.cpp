@@ -0,0 +1,65 @@
+#include "wifi_cache.h"
+#include "eprobe.h"
+
+#include <WiFi.h>
+#include <cstring>
+#include <ctime>
+
+static const char *LOG_TAG = "WiFiCache";
+
+static bool staticIp = false;
+
+static bool wificache_leaseValid(const wifi_cache_t &cache) {
+  time_t now = time(nullptr);
+  return cache.leaseTime >= WIFICACHE_MIN_VALID_TIME &&
+         now >= (time_t)cache.leaseTime &&
+         now - cache.leaseTime < WIFICACHE_LEASE_REUSE_S;
+}
+
+bool wificache_begin(wifi_cache_t *cache, const char *ssid, const char *pass) {
+  staticIp = cache->valid && wificache_leaseValid(*cache);
+  if (staticIp) {
+    WiFi.config(IPAddress(cache->ip), IPAddress(cache->gateway),
+                IPAddress(cache->subnet), IPAddress(cache->dns));
+  } else {
+    // Back to DHCP after a static configuration
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+  }
+
+  if (!cache->valid) {
+    ESP_LOGD(LOG_TAG, "No cached access point, full scan");
+    WiFi.begin(ssid, pass);
+    return false;
+  }
+
+  ESP_LOGD(LOG_TAG,
+           "Directed connect on channel %d to %02x:%02x:%02x:%02x:%02x:%02x "
+           "(%s)",
+           cache->channel, cache->bssid[0], cache->bssid[1], cache->bssid[2],
+           cache->bssid[3], cache->bssid[4], cache->bssid[5],
+           staticIp ? "cached IP" : "DHCP");
+  WiFi.begin(ssid, pass, cache->channel, cache->bssid);
+  return true;
+}
+
+void wificache_store(wifi_cache_t *cache) {
+  const uint8_t *bssid = WiFi.BSSID();
+  if (bssid == nullptr) {
+    return;
+  }
+  memcpy(cache->bssid, bssid, sizeof(cache->bssid));
+  cache->channel = WiFi.channel();
+
+  if (!staticIp) {
+    cache->ip = WiFi.localIP();
+    cache->gateway = WiFi.gatewayIP();
+    cache->subnet = WiFi.subnetMask();
+    cache->dns = WiFi.dnsIP();
+    // Without a clock the lease is not reused
+    time_t now = time(nullptr);
+    cache->leaseTime = now >= WIFICACHE_MIN_VALID_TIME ? (uint32_t)now : 0;
+  }
+  cache->valid = true;
+}
+
+void wificache_invalidate(wifi_cache_t *cache) { *cache = wifi_cache_t{}; }
\ No newline at end of file
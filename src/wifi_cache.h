@@ -0,0 +1,47 @@
+#ifndef WIFI_CACHE_H
+#define WIFI_CACHE_H
+
+#include <cstdint>
+
+// Seconds a DHCP lease is reused as a static configuration, override with a
+// build flag. Should stay well below the lease time of the router.
+#ifndef WIFICACHE_LEASE_REUSE_S
+#define WIFICACHE_LEASE_REUSE_S 3600
+#endif
+// Anything earlier is a clock that has not been set
+#define WIFICACHE_MIN_VALID_TIME 1577836800
+
+/*
+ Fast reconnect to the last access point.
+
+ A plain WiFi.begin() scans every channel for the SSID and then waits for
+ DHCP, seconds of radio-on time for each wakeup. After a successful connect
+ the channel, BSSID and IP configuration are remembered, and the next
+ connect joins that access point directly on its channel. While the DHCP
+ lease is younger than WIFICACHE_LEASE_REUSE_S the address is also set
+ statically, skipping DHCP altogether. Later connects refresh the lease
+ with DHCP, still directed.
+
+ A directed connect that fails is the caller's cue to invalidate the cache
+ and connect again with a full scan.
+
+ The cache is plain data so it can live in RTC memory across deep sleep.
+*/
+typedef struct {
+  bool valid;
+  int32_t channel;
+  uint8_t bssid[6];
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint32_t leaseTime;  // time of the last DHCP, 0 if unknown
+} wifi_cache_t;
+
+// Starts connecting, returns true if the connect is directed
+bool wificache_begin(wifi_cache_t *cache, const char *ssid, const char *pass);
+// Remembers the access point and configuration once connected
+void wificache_store(wifi_cache_t *cache);
+void wificache_invalidate(wifi_cache_t *cache);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,105 @@
+/*
+ Host side measurement of the datalog append latency across rollovers.
+
+ Build:
+   g++ -O2 -I../support -I../../../src -o datalog_latency \
+       datalog_latency.cpp ../support/Arduino.cpp ../support/FS.cpp \
+       ../../../src/datalog.cpp ../../../src/crc32.cpp
+
+ Usage:
+   datalog_latency <empty directory> [appends] [--no-prepare] [--sync]
+
+ Appends sample sized records like the measure loop does and calls
+ datalog_prepare() after each of them, or never with --no-prepare, which
+ makes every rollover zero fill the new segment inside the append as before
+ the spare segment existed. --sync fsyncs every file on close. Prints the
+ latency distribution and the most bytes a single call wrote.
+*/
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "Arduino.h"
+#include "FS.h"
+#include "datalog.h"
+
+#define SAMPLE_LINE "'Sun Oct 18 22:45:36 2026',21.53,45.21,1013.25,52.41,87,3\n"
+
+typedef struct {
+  std::vector<uint32_t> micros;
+  uint64_t maxBytes;
+} call_stats_t;
+
+static void printStats(const char *name, call_stats_t &stats) {
+  if (stats.micros.empty()) {
+    return;
+  }
+  std::sort(stats.micros.begin(), stats.micros.end());
+  size_t n = stats.micros.size();
+  printf("%-8s %7zu calls: p50 %6u us, p99 %6u us, max %6u us, "
+         "max %7llu bytes per call\n",
+         name, n, (unsigned)stats.micros[(n - 1) / 2],
+         (unsigned)stats.micros[(n * 99 - 1) / 100],
+         (unsigned)stats.micros[n - 1], (unsigned long long)stats.maxBytes);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <empty directory> [appends] [--no-prepare] "
+                    "[--sync]\n", argv[0]);
+    return 2;
+  }
+  uint32_t appends = 20000;
+  bool prepare = true;
+  fs::FS fs(argv[1]);
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--no-prepare") == 0) {
+      prepare = false;
+    } else if (strcmp(argv[i], "--sync") == 0) {
+      fs.setSyncOnClose(true);
+    } else {
+      appends = (uint32_t)strtoul(argv[i], nullptr, 0);
+    }
+  }
+
+  datalog_t log;
+  if (!datalog_open(&log, fs, "/eprobe")) {
+    fprintf(stderr, "Failed to open the datalog in %s\n", argv[1]);
+    return 1;
+  }
+
+  call_stats_t appendStats = {{}, 0};
+  call_stats_t prepareStats = {{}, 0};
+  uint32_t firstSegment = log.header.segment;
+  for (uint32_t i = 0; i < appends; i++) {
+    uint64_t bytes = fs.bytesWritten();
+    if (!datalog_append(&log, DATALOG_RECORD_SAMPLE, SAMPLE_LINE,
+                        strlen(SAMPLE_LINE))) {
+      fprintf(stderr, "Append %u failed\n", (unsigned)i);
+      return 1;
+    }
+    appendStats.micros.push_back(log.lastAppendMicros);
+    appendStats.maxBytes =
+        std::max(appendStats.maxBytes, fs.bytesWritten() - bytes);
+
+    if (prepare) {
+      bytes = fs.bytesWritten();
+      uint32_t start = micros();
+      datalog_prepare(&log, DATALOG_PREPARE_CHUNK);
+      if (fs.bytesWritten() != bytes) {
+        prepareStats.micros.push_back(micros() - start);
+        prepareStats.maxBytes =
+            std::max(prepareStats.maxBytes, fs.bytesWritten() - bytes);
+      }
+    }
+  }
+
+  printf("%u appends, %u rollovers, %s\n", (unsigned)appends,
+         (unsigned)(log.header.segment - firstSegment),
+         prepare ? "spare segment prepared" : "no spare segment");
+  printStats("append", appendStats);
+  printStats("prepare", prepareStats);
+  return 0;
+}
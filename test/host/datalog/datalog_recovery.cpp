@@ -0,0 +1,146 @@
+/*
+ Host side generator of large synthetic datalogs and recovery harness.
+
+ Build:
+   g++ -O2 -I../support -I../../../src -o datalog_recovery \
+       datalog_recovery.cpp ../support/Arduino.cpp ../support/FS.cpp \
+       ../../../src/datalog.cpp ../../../src/crc32.cpp
+
+ Usage:
+   datalog_recovery <empty directory> [megabytes]
+
+ Fills the directory with sample records until the log holds the given
+ size (64 MiB by default), then simulates resets: a clean one with the
+ header of the open segment lagging behind, a torn last record, garbage
+ behind the end, a destroyed segment header and a destroyed segment. Each
+ time the log is reopened, the time datalog_open() takes is printed, the
+ recovered end and sequence are checked against the records written, and a
+ further append must succeed.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Arduino.h"
+#include "FS.h"
+#include "datalog.h"
+
+#define LOG_DIR "/eprobe"
+#define SAMPLE_LINE "'Sun Oct 18 22:45:36 2026',21.53,45.21,1013.25,52.41,87,3\n"
+
+static int failures = 0;
+
+static bool appendSample(datalog_t *log) {
+  return datalog_append(log, DATALOG_RECORD_SAMPLE, SAMPLE_LINE,
+                        strlen(SAMPLE_LINE));
+}
+
+static void expect(bool condition, const char *what) {
+  if (!condition) {
+    printf("  FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+// Reopens the log like a reset does and checks where it continues
+static void reopen(fs::FS &fs, datalog_t *log, const char *scenario,
+                   uint32_t segment, uint32_t end, uint32_t sequence) {
+  uint32_t start = micros();
+  bool opened = datalog_open(log, fs, LOG_DIR);
+  uint32_t elapsed = micros() - start;
+
+  printf("%-16s open %6u us, segment %u, end %6u, next record %u\n",
+         scenario, (unsigned)elapsed, (unsigned)log->header.segment,
+         (unsigned)log->header.end, (unsigned)log->header.sequence);
+  expect(opened, "datalog_open");
+  expect(log->header.segment == segment, "segment");
+  expect(log->header.end == end, "end");
+  expect(log->header.sequence == sequence, "sequence");
+  expect(appendSample(log), "append after recovery");
+}
+
+static void overwrite(fs::FS &fs, const char *path, uint32_t offset,
+                      const uint8_t *data, size_t len) {
+  File file = fs.open(path, "r+");
+  if (!file || !file.seek(offset) || file.write(data, len) != len) {
+    printf("  FAILED: corrupting %s at %u\n", path, (unsigned)offset);
+    failures++;
+  }
+  file.close();
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <empty directory> [megabytes]\n", argv[0]);
+    return 2;
+  }
+  uint32_t megabytes = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 0) : 64;
+  fs::FS fs(argv[1]);
+  static datalog_t log;
+
+  if (!datalog_open(&log, fs, LOG_DIR)) {
+    fprintf(stderr, "Failed to create the datalog in %s\n", argv[1]);
+    return 1;
+  }
+  uint32_t segments = megabytes * 1024 * 1024 / DATALOG_SEGMENT_SIZE;
+  uint32_t start = millis();
+  while (log.header.segment < segments ||
+         log.header.end < log.header.size / 2) {
+    if (!appendSample(&log)) {
+      fprintf(stderr, "Append failed at record %u\n",
+              (unsigned)log.header.sequence);
+      return 1;
+    }
+    datalog_prepare(&log, DATALOG_PREPARE_CHUNK);
+  }
+  printf("Generated %u segments, %u records in %lu ms\n",
+         (unsigned)log.header.segment, (unsigned)log.header.sequence,
+         millis() - start);
+
+  // The header on the card is only as recent as the last checkpoint
+  uint32_t segment = log.header.segment;
+  uint32_t end = log.header.end;
+  uint32_t sequence = log.header.sequence;
+  reopen(fs, &log, "clean reset", segment, end, sequence);
+
+  // A record whose CRC never made it to the card
+  end = log.header.end;
+  sequence = log.header.sequence;
+  appendSample(&log);
+  uint8_t torn = 0xff;
+  overwrite(fs, log.path, log.header.end - 1, &torn, 1);
+  reopen(fs, &log, "torn record", segment, end, sequence);
+
+  // Garbage where the next record would go
+  end = log.header.end;
+  sequence = log.header.sequence;
+  uint8_t garbage[64];
+  for (size_t i = 0; i < sizeof(garbage); i++) {
+    garbage[i] = (uint8_t)rand();
+  }
+  overwrite(fs, log.path, end, garbage, sizeof(garbage));
+  reopen(fs, &log, "garbage tail", segment, end, sequence);
+
+  // A destroyed header sets the segment aside and starts the next one,
+  // continuing the sequence behind the records still readable in it
+  sequence = log.header.sequence;
+  uint8_t zeros[DATALOG_SEGMENT_HEADER_LEN] = {0};
+  overwrite(fs, log.path, 0, zeros, sizeof(zeros));
+  reopen(fs, &log, "bad header", segment + 1, DATALOG_SEGMENT_HEADER_LEN,
+         sequence);
+
+  // With its first record gone as well it continues behind the previous
+  // segment
+  while (log.header.segment == segment + 1) {
+    appendSample(&log);
+  }
+  sequence = log.header.firstSequence;
+  uint8_t record[DATALOG_HEADER_LEN] = {0};
+  overwrite(fs, log.path, 0, zeros, sizeof(zeros));
+  overwrite(fs, log.path, DATALOG_SEGMENT_HEADER_LEN, record, sizeof(record));
+  reopen(fs, &log, "bad segment", segment + 3, DATALOG_SEGMENT_HEADER_LEN,
+         sequence);
+
+  printf("%d failures\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+/*
+ Host side microbenchmark of fixfmt_formatFloat against snprintf.
+
+ Build:
+   g++ -O2 -I../../../src -o fixed_format_bench fixed_format_bench.cpp \
+       ../../../src/fixed_format.cpp
+
+ Usage:
+   fixed_format_bench [iterations]
+
+ Formats the same set of sensor like values with both and prints the time
+ per call. Host numbers only give the ratio, the probe has no FPU for double
+ and a slower snprintf, so measure there for absolute values.
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "fixed_format.h"
+
+#define VALUE_COUNT 4096
+
+typedef struct {
+  float value;
+  uint8_t decimals;
+  const char *suffix;
+} bench_value_t;
+
+static bench_value_t values[VALUE_COUNT];
+static volatile int sink;
+
+template <typename F>
+static double nsPerCall(long iterations, F format) {
+  char buf[32];
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; i++) {
+    const bench_value_t &v = values[i % VALUE_COUNT];
+    sink += format(buf, sizeof(buf), v);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         iterations;
+}
+
+int main(int argc, char **argv) {
+  long iterations = argc > 1 ? strtol(argv[1], nullptr, 0) : 10000000;
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> temperature(-20.0f, 45.0f);
+  std::uniform_real_distribution<float> humidity(0.0f, 100.0f);
+  std::uniform_real_distribution<float> pressure(950.0f, 1050.0f);
+  std::uniform_real_distribution<float> gas(1.0f, 500.0f);
+
+  for (int i = 0; i < VALUE_COUNT; i++) {
+    switch (i % 4) {
+      case 0:
+        values[i] = {temperature(rng), 1, "C"};
+        break;
+      case 1:
+        values[i] = {humidity(rng), 1, "%"};
+        break;
+      case 2:
+        values[i] = {pressure(rng), 0, " hPa"};
+        break;
+      default:
+        values[i] = {gas(rng), 2, nullptr};
+        break;
+    }
+  }
+
+  double fixed = nsPerCall(iterations, [](char *buf, size_t len,
+                                          const bench_value_t &v) {
+    return fixfmt_formatFloat(buf, len, v.value, v.decimals, v.suffix);
+  });
+  double printf = nsPerCall(iterations, [](char *buf, size_t len,
+                                           const bench_value_t &v) {
+    return snprintf(buf, len, "%.*f%s", v.decimals, (double)v.value,
+                    v.suffix != nullptr ? v.suffix : "");
+  });
+
+  ::printf("fixfmt_formatFloat %.1f ns/call\n", fixed);
+  ::printf("snprintf           %.1f ns/call\n", printf);
+  ::printf("speedup            %.1fx\n", printf / fixed);
+  return 0;
+}
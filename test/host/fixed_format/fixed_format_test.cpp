@@ -0,0 +1,136 @@
+/*
+ Host side comparison of fixfmt_formatFloat and fixfmt_formatDouble against
+ snprintf.
+
+ Build:
+   g++ -O2 -I../../../src -o fixed_format_test fixed_format_test.cpp \
+       ../../../src/fixed_format.cpp
+
+ Usage:
+   fixed_format_test [stride [first]]
+
+ Checks exact round-half-even ties, random doubles and truncated output
+ buffers, then walks every float bit pattern for each number of decimals up
+ to FIXFMT_MAX_DECIMALS. With stride and first only every stride-th pattern
+ starting at first is walked, so the full walk can be split over processes:
+   for i in 0 1 2 3 4 5 6 7; do fixed_format_test 8 $i & done; wait
+ Prints the first mismatches and exits with 1 if there were any.
+*/
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "fixed_format.h"
+
+#define BUF_LEN 512
+#define MAX_REPORTED 20
+
+static uint64_t checked = 0;
+static uint64_t mismatches = 0;
+
+static void check(double value, uint8_t decimals, const char *suffix,
+                  size_t len, int actualLen, const char *actual) {
+  char expected[BUF_LEN];
+  int expectedLen = snprintf(expected, len, "%.*f%s", decimals, value,
+                             suffix != nullptr ? suffix : "");
+  checked++;
+  if (actualLen == expectedLen && (len == 0 || strcmp(actual, expected) == 0)) {
+    return;
+  }
+  if (mismatches++ < MAX_REPORTED) {
+    printf("Mismatch for %.17g, %u decimals, len %zu: \"%s\" (%d) != "
+           "\"%s\" (%d)\n",
+           value, decimals, len, len > 0 ? actual : "", actualLen,
+           len > 0 ? expected : "", expectedLen);
+  }
+}
+
+static void checkDouble(double value, uint8_t decimals, const char *suffix,
+                        size_t len) {
+  char actual[BUF_LEN];
+  int actualLen = fixfmt_formatDouble(actual, len, value, decimals, suffix);
+  check(value, decimals, suffix, len, actualLen, actual);
+}
+
+static void checkFloat(float value, uint8_t decimals) {
+  char actual[BUF_LEN];
+  int actualLen = fixfmt_formatFloat(actual, BUF_LEN, value, decimals);
+  check(value, decimals, nullptr, BUF_LEN, actualLen, actual);
+}
+
+static void checkAllFloats(uint32_t stride, uint32_t first) {
+  for (uint8_t decimals = 0; decimals <= FIXFMT_MAX_DECIMALS; decimals++) {
+    uint64_t before = mismatches;
+    for (uint64_t bits = first; bits <= UINT32_MAX; bits += stride) {
+      uint32_t pattern = (uint32_t)bits;
+      float value;
+      memcpy(&value, &pattern, sizeof(value));
+      checkFloat(value, decimals);
+    }
+    printf("Floats, %u decimals: %" PRIu64 " mismatches\n", decimals,
+           mismatches - before);
+  }
+}
+
+// Every multiple of 2^-shift is exact, so this hits the halfway cases of all
+// decimals that the binary fraction can represent
+static void checkTies() {
+  uint64_t before = mismatches;
+  for (int shift = 1; shift <= 24; shift++) {
+    double step = 1.0 / (double)(1 << shift);
+    for (int i = -4096; i <= 4096; i++) {
+      for (uint8_t decimals = 0; decimals <= FIXFMT_MAX_DECIMALS; decimals++) {
+        checkDouble(i * step, decimals, nullptr, BUF_LEN);
+        checkDouble(1000.0 + i * step, decimals, nullptr, BUF_LEN);
+      }
+    }
+  }
+  printf("Ties: %" PRIu64 " mismatches\n", mismatches - before);
+}
+
+static void checkRandomDoubles(std::mt19937_64 &rng) {
+  uint64_t before = mismatches;
+  std::uniform_int_distribution<int> exponents(-70, 80);
+  std::uniform_real_distribution<double> mantissas(1.0, 2.0);
+  for (int i = 0; i < 10000000; i++) {
+    double value = ldexp(mantissas(rng), exponents(rng));
+    if (rng() & 1) {
+      value = -value;
+    }
+    checkDouble(value, (uint8_t)(rng() % (FIXFMT_MAX_DECIMALS + 1)), nullptr,
+                BUF_LEN);
+  }
+  printf("Random doubles: %" PRIu64 " mismatches\n", mismatches - before);
+}
+
+static void checkTruncation(std::mt19937_64 &rng) {
+  static const char *suffixes[] = {nullptr, "", "C", " hPa", "%"};
+  uint64_t before = mismatches;
+  std::uniform_real_distribution<double> values(-2000.0, 2000.0);
+  for (int i = 0; i < 1000000; i++) {
+    checkDouble(values(rng), (uint8_t)(rng() % (FIXFMT_MAX_DECIMALS + 1)),
+                suffixes[rng() % 5], rng() % 16);
+  }
+  printf("Truncation and suffixes: %" PRIu64 " mismatches\n",
+         mismatches - before);
+}
+
+int main(int argc, char **argv) {
+  uint32_t stride = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : 1;
+  uint32_t first = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 0) : 0;
+  if (stride == 0) {
+    stride = 1;
+  }
+  std::mt19937_64 rng(0x65507262);
+
+  checkTies();
+  checkRandomDoubles(rng);
+  checkTruncation(rng);
+  checkAllFloats(stride, first);
+
+  printf("%" PRIu64 " values checked, %" PRIu64 " mismatches\n", checked,
+         mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
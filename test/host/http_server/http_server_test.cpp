@@ -0,0 +1,362 @@
+/*
+ Host side test of the HTTP server against a datalog on the host file
+ system, over a real TCP connection on 127.0.0.1.
+
+ Build (Linux, needs zlib):
+   g++ -O2 -I../support -I../../../src -o http_server_test \
+       http_server_test.cpp ../support/Arduino.cpp ../support/FS.cpp \
+       ../support/WiFi.cpp ../../../src/http_server.cpp \
+       ../../../src/datalog.cpp ../../../src/sample_history.cpp \
+       ../../../src/deflate.cpp ../../../src/crc32.cpp -lz -lpthread
+
+ Usage:
+   http_server_test <empty directory>
+
+ Writes a datalog with a closed and an open segment, starts the server on a
+ free port and checks the segment list, the raw and the gzipped segments,
+ ranges with a start and an end, open ended and suffix ranges, 416 for
+ unsatisfiable ranges and 404 for unknown segments and paths against the
+ bytes in the segment files. The aggregate tiers and the metrics are not
+ linked, their routes answer 404 and 503.
+*/
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+
+#include "Arduino.h"
+#include "FS.h"
+#include "WiFi.h"
+#include "datalog.h"
+#include "http_server.h"
+#include "metrics.h"
+#include "retention.h"
+
+#define LOG_DIR "/eprobe"
+#define SAMPLE_LINE "'Sun Oct 18 22:45:36 2026',21.53,45.21,1013.25,52.41,87,3\n"
+#define SERVER_START_TIMEOUT_MS 2000
+
+typedef struct {
+  int status;
+  std::string headers;
+  std::string body;
+} response_t;
+
+static int failures = 0;
+static int checks = 0;
+
+// retention.cpp and metrics.cpp are not linked
+datalog_t *retention_tierLog(retention_tier_t tier) { return nullptr; }
+bool metrics_acquire(metrics_view_t *view) { return false; }
+void metrics_release(const metrics_view_t &view) {}
+
+static void expect(bool condition, const char *request, const char *what) {
+  checks++;
+  if (!condition) {
+    printf("  FAILED: %s: %s\n", request, what);
+    failures++;
+  }
+}
+
+// Sends a GET with the extra header lines and reads until the server closes
+static bool get(const char *path, const char *headers, response_t *response) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(WiFiServer::hostPort());
+  if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    perror("connect");
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+
+  char request[256];
+  snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: probe\r\n%s\r\n",
+           path, headers);
+  if (send(fd, request, strlen(request), 0) < 0) {
+    close(fd);
+    return false;
+  }
+
+  std::string raw;
+  char buf[4096];
+  ssize_t n;
+  while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+    raw.append(buf, n);
+  }
+  close(fd);
+
+  size_t split = raw.find("\r\n\r\n");
+  if (split == std::string::npos ||
+      sscanf(raw.c_str(), "HTTP/1.1 %d", &response->status) != 1) {
+    return false;
+  }
+  response->headers = raw.substr(0, split + 2);
+  response->body = raw.substr(split + 4);
+  return true;
+}
+
+// Value of a response header, empty if it is missing
+static std::string header(const response_t &response, const char *name) {
+  size_t len = strlen(name);
+  size_t pos = response.headers.find("\r\n");
+  while (pos != std::string::npos && pos + 2 < response.headers.size()) {
+    const char *line = response.headers.c_str() + pos + 2;
+    size_t end = response.headers.find("\r\n", pos + 2);
+    if (strncasecmp(line, name, len) == 0 && line[len] == ':') {
+      size_t value = pos + 2 + len + 1;
+      while (response.headers[value] == ' ') {
+        value++;
+      }
+      return response.headers.substr(value, end - value);
+    }
+    pos = end;
+  }
+  return "";
+}
+
+static bool gunzip(const std::string &in, std::string *out) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+    return false;
+  }
+  stream.next_in = (Bytef *)in.data();
+  stream.avail_in = in.size();
+  char buf[4096];
+  int result;
+  out->clear();
+  do {
+    stream.next_out = (Bytef *)buf;
+    stream.avail_out = sizeof(buf);
+    result = inflate(&stream, Z_NO_FLUSH);
+    out->append(buf, sizeof(buf) - stream.avail_out);
+  } while (result == Z_OK);
+  // Z_STREAM_END only after the trailer CRC and length matched
+  bool success = result == Z_STREAM_END && stream.avail_in == 0;
+  inflateEnd(&stream);
+  return success;
+}
+
+// The segment bytes up to the logical end, as the server should send them
+static std::string segmentBytes(fs::FS &fs, datalog_t *log, uint32_t segment) {
+  datalog_segment_header_t header;
+  char path[DATALOG_PATH_LEN];
+  std::string data;
+  if (!datalog_segmentHeader(log, segment, &header)) {
+    return data;
+  }
+  datalog_segmentPath(log, segment, path, sizeof(path));
+  File file = fs.open(path, FILE_READ);
+  data.resize(header.end);
+  if (!file || file.read((uint8_t *)&data[0], header.end) != header.end) {
+    data.clear();
+  }
+  file.close();
+  return data;
+}
+
+static void checkList(datalog_t *log, uint32_t closed, uint32_t open) {
+  response_t response;
+  const char *request = "/segments";
+  if (!get(request, "", &response)) {
+    expect(false, request, "response");
+    return;
+  }
+  expect(response.status == 200, request, "status 200");
+  expect(header(response, "Content-Type") == "application/json", request,
+         "JSON content type");
+  expect(response.body.front() == '[' && response.body.find("]\n") ==
+                                             response.body.size() - 2,
+         request, "JSON array");
+
+  for (uint32_t segment = closed; segment <= open; segment++) {
+    datalog_segment_header_t segmentHeader;
+    datalog_segmentHeader(log, segment, &segmentHeader);
+    char entry[96];
+    snprintf(entry, sizeof(entry),
+             "{\"segment\":%u,\"size\":%u,\"firstSequence\":%u,"
+             "\"sequence\":%u,",
+             (unsigned)segment, (unsigned)segmentHeader.end,
+             (unsigned)segmentHeader.firstSequence,
+             (unsigned)segmentHeader.sequence);
+    expect(response.body.find(entry) != std::string::npos, request, entry);
+  }
+}
+
+static void checkSegment(uint32_t segment, const std::string &data) {
+  char request[64];
+  char expected[64];
+  response_t response;
+  snprintf(request, sizeof(request), "/segments/%u", (unsigned)segment);
+  printf("Segment %u, %u bytes\n", (unsigned)segment, (unsigned)data.size());
+
+  // Raw, Content-Length is the logical end, not the preallocated size
+  if (get(request, "", &response)) {
+    snprintf(expected, sizeof(expected), "%u", (unsigned)data.size());
+    expect(response.status == 200, request, "raw status 200");
+    expect(header(response, "Content-Length") == expected, request,
+           "raw Content-Length");
+    expect(header(response, "Accept-Ranges") == "bytes", request,
+           "Accept-Ranges");
+    expect(response.body == data, request, "raw body");
+  } else {
+    expect(false, request, "raw response");
+  }
+
+  // gzip, without a length, ending with the connection
+  std::string inflated;
+  if (get(request, "Accept-Encoding: deflate, gzip\r\n", &response)) {
+    expect(response.status == 200, request, "gzip status 200");
+    expect(header(response, "Content-Encoding") == "gzip", request,
+           "Content-Encoding gzip");
+    expect(header(response, "Content-Length").empty(), request,
+           "no Content-Length with gzip");
+    expect(gunzip(response.body, &inflated), request, "gzip stream intact");
+    expect(inflated == data, request, "gzip body");
+    printf("  gzip %u bytes\n", (unsigned)response.body.size());
+  } else {
+    expect(false, request, "gzip response");
+  }
+
+  typedef struct {
+    const char *what;
+    uint32_t first;
+    uint32_t last;
+  } range_case_t;
+  uint32_t size = data.size();
+  char spec[4][32];
+  snprintf(spec[0], sizeof(spec[0]), "bytes=100-4195");
+  snprintf(spec[1], sizeof(spec[1]), "bytes=%u-", (unsigned)(size - 10));
+  snprintf(spec[2], sizeof(spec[2]), "bytes=-500");
+  snprintf(spec[3], sizeof(spec[3]), "bytes=%u-99999999", (unsigned)(size / 2));
+  const range_case_t ranges[] = {
+      {"range", 100, 4195},
+      {"open ended range", size - 10, size - 1},
+      {"suffix range", size - 500, size - 1},
+      {"range past the end", size / 2, size - 1},
+  };
+  for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+    char headers[160];
+    // A range wins over gzip
+    snprintf(headers, sizeof(headers),
+             "Range: %s\r\nAccept-Encoding: gzip\r\n", spec[i]);
+    if (!get(request, headers, &response)) {
+      expect(false, request, ranges[i].what);
+      continue;
+    }
+    snprintf(expected, sizeof(expected), "bytes %u-%u/%u",
+             (unsigned)ranges[i].first, (unsigned)ranges[i].last,
+             (unsigned)size);
+    expect(response.status == 206, ranges[i].what, "status 206");
+    expect(header(response, "Content-Range") == expected, ranges[i].what,
+           expected);
+    expect(header(response, "Content-Encoding").empty(), ranges[i].what,
+           "not gzipped");
+    expect(response.body ==
+               data.substr(ranges[i].first,
+                           ranges[i].last - ranges[i].first + 1),
+           ranges[i].what, "body");
+  }
+
+  // Suffix longer than the segment: the whole segment
+  if (get(request, "Range: bytes=-99999999\r\n", &response)) {
+    expect(response.status == 206, "long suffix range", "status 206");
+    expect(response.body == data, "long suffix range", "body");
+  } else {
+    expect(false, request, "long suffix range");
+  }
+
+  char unsatisfiable[4][48];
+  snprintf(unsatisfiable[0], sizeof(unsatisfiable[0]), "Range: bytes=%u-\r\n",
+           (unsigned)size);
+  snprintf(unsatisfiable[1], sizeof(unsatisfiable[1]),
+           "Range: bytes=0-1,5-6\r\n");
+  snprintf(unsatisfiable[2], sizeof(unsatisfiable[2]),
+           "Range: bytes=200-100\r\n");
+  snprintf(unsatisfiable[3], sizeof(unsatisfiable[3]), "Range: lines=1-2\r\n");
+  snprintf(expected, sizeof(expected), "bytes */%u", (unsigned)size);
+  for (size_t i = 0; i < 4; i++) {
+    if (!get(request, unsatisfiable[i], &response)) {
+      expect(false, unsatisfiable[i], "response");
+      continue;
+    }
+    expect(response.status == 416, unsatisfiable[i], "status 416");
+    expect(header(response, "Content-Range") == expected, unsatisfiable[i],
+           expected);
+    expect(response.body.empty(), unsatisfiable[i], "empty body");
+  }
+}
+
+static void checkStatus(const char *path, int status) {
+  response_t response;
+  char what[32];
+  snprintf(what, sizeof(what), "status %d", status);
+  expect(get(path, "", &response) && response.status == status, path, what);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <empty directory>\n", argv[0]);
+    return 2;
+  }
+  fs::FS fs(argv[1]);
+  static datalog_t log;
+  if (!datalog_open(&log, fs, LOG_DIR)) {
+    fprintf(stderr, "Failed to create the datalog in %s\n", argv[1]);
+    return 1;
+  }
+
+  // One full segment and a part of the next
+  uint32_t closed = log.header.segment;
+  while (log.header.segment == closed ||
+         log.header.end < log.header.size / 3) {
+    if (!datalog_append(&log, DATALOG_RECORD_SAMPLE, SAMPLE_LINE,
+                        strlen(SAMPLE_LINE))) {
+      fprintf(stderr, "Append failed at record %u\n",
+              (unsigned)log.header.sequence);
+      return 1;
+    }
+  }
+  uint32_t open = log.header.segment;
+
+  WiFiServer::setHostPort(0);
+  httpserver_setup(&log);
+  uint32_t start = millis();
+  while (WiFiServer::hostPort() == 0 &&
+         millis() - start < SERVER_START_TIMEOUT_MS) {
+    delay(10);
+  }
+  if (WiFiServer::hostPort() == 0) {
+    fprintf(stderr, "The server did not start\n");
+    return 1;
+  }
+  printf("Serving segments %u..%u on port %u\n", (unsigned)closed,
+         (unsigned)open, (unsigned)WiFiServer::hostPort());
+
+  checkList(&log, closed, open);
+  checkSegment(closed, segmentBytes(fs, &log, closed));
+  checkSegment(open, segmentBytes(fs, &log, open));
+
+  char missing[32];
+  snprintf(missing, sizeof(missing), "/segments/%u", (unsigned)(open + 1));
+  checkStatus(missing, 404);
+  checkStatus("/segments/x", 404);
+  checkStatus("/nothing", 404);
+  checkStatus("/5m/segments", 404);
+  checkStatus("/metrics", 503);
+
+  printf("%d of %d checks failed\n", failures, checks);
+  return failures == 0 ? 0 : 1;
+}
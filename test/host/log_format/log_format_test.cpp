@@ -0,0 +1,178 @@
+/*
+ Host test of the binary log encoding and the log expander.
+
+ Build:
+   g++ -O2 -no-pie -I../../../src -o log_format_test log_format_test.cpp \
+       ../../../src/log_format.cpp ../../../src/crc32.cpp
+
+ Usage:
+   log_format_test [<log_expander>]
+
+ Encodes the formats used by the firmware and a set of edge cases, expands
+ them again and compares the text with vsnprintf. Truncated payloads must
+ end in "...". Given the path of a built tools/log_expander, the records are
+ also written as binary frames mixed with plain text into a capture file
+ and expanded by the tool, with this binary as the ELF file; its output
+ must match the expected text. Build without PIE so the format addresses
+ in the frames match the ones in the ELF file.
+*/
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "crc32.h"
+#include "log_format.h"
+#include "log_sink_protocol.h"
+
+#define PAYLOAD_LEN 88  // LOG_SINK_PAYLOAD_LEN
+#define LINE_LEN 192
+#define CAPTURE_PATH "/tmp/log_format_test.bin"
+
+static int failures = 0;
+static FILE *capture = nullptr;
+static std::string expected;
+
+static void writeFrame(const char *format, const uint8_t *payload,
+                       size_t length, bool truncated) {
+  uint8_t frame[LOG_SINK_HEADER_LEN + PAYLOAD_LEN + LOG_SINK_CRC_LEN];
+  uint32_t address = (uint32_t)(uintptr_t)format;
+  frame[0] = LOG_SINK_MAGIC0;
+  frame[1] = LOG_SINK_MAGIC1;
+  frame[2] = truncated ? LOG_SINK_FLAG_TRUNCATED : 0;
+  frame[3] = length;
+  memcpy(frame + 4, &address, sizeof(address));
+  memcpy(frame + LOG_SINK_HEADER_LEN, payload, length);
+  uint32_t crc = crc32_update(0, frame + 2, LOG_SINK_HEADER_LEN - 2 + length);
+  memcpy(frame + LOG_SINK_HEADER_LEN + length, &crc, sizeof(crc));
+  fwrite(frame, 1, LOG_SINK_HEADER_LEN + length + LOG_SINK_CRC_LEN, capture);
+}
+
+/*
+ Encodes and expands the arguments, compares the text with want and adds
+ the record to the capture file.
+*/
+static void checkRecord(const char *want, bool wantFits, const char *format,
+                        va_list args) {
+  uint8_t payload[PAYLOAD_LEN];
+  size_t length;
+  bool fits = logformat_encode(format, args, payload, sizeof(payload),
+                               &length);
+
+  char line[LINE_LEN];
+  logformat_expand(format, payload, length, !fits, line, sizeof(line));
+  if (fits != wantFits || strcmp(line, want) != 0) {
+    printf("FAIL %s: got '%s', expected '%s'\n", format, line, want);
+    failures++;
+  }
+
+  if (capture != nullptr) {
+    writeFrame(format, payload, length, !fits);
+    expected += line;
+    // Plain text between frames, like ESP_LOGx output
+    fputs("I (1234) Plain: between frames\n", capture);
+    expected += "I (1234) Plain: between frames\n";
+  }
+}
+
+static void check(const char *format, ...)
+    __attribute__((format(printf, 1, 2)));
+
+static void check(const char *format, ...) {
+  char want[LINE_LEN];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(want, sizeof(want), format, args);
+  va_end(args);
+
+  va_start(args, format);
+  checkRecord(want, true, format, args);
+  va_end(args);
+}
+
+static void checkTruncated(const char *want, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void checkTruncated(const char *want, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  checkRecord(want, false, format, args);
+  va_end(args);
+}
+
+int main(int argc, char **argv) {
+  const char *expander = argc > 1 ? argv[1] : nullptr;
+  if (expander != nullptr) {
+    capture = fopen(CAPTURE_PATH, "wb");
+    if (capture == nullptr) {
+      perror(CAPTURE_PATH);
+      return 1;
+    }
+  }
+
+  char longText[120];
+  memset(longText, 'x', sizeof(longText) - 1);
+  longText[sizeof(longText) - 1] = '\0';
+
+  check("BME680 not available, skipping measure cycle %d\n", 42);
+  check("%s boot to first sample: %u ms\n", "Cold", 1234u);
+  check("Stats %s %s: n %u, min %.2f, max %.2f, mean %.2f, sd %.3f\n",
+        "1h", "temperature", 60u, 19.5, 23.25, 21.125, 0.4321);
+  check("Task %s: core %d, prio %d, stack free %u\n", "Measure", 1, 5,
+        2048u);
+  check("Measure cycle %d at %s: %s C, %s %%, %s hPa, %s, IAQ %d (%s)\n", 7,
+        "12:00:00", "21.53", "45.21", "1013.25", "52.41", 87, "good");
+  check("SD benchmark finished after %lu ms\n", 4294967295ul);
+  check("SD %-10s %5u B x %4u: %7.3f MB/s, p50 %u us, p99 %u us, max %u us\n",
+        "write", 512u, 100u, 1.234, 200u, 900u, 1500u);
+  check("Unsigned %u and hex %08X and char %c\n", 4294967295u, 0xBEEFu, 'z');
+  check("Long %ld %lu %lx, long long %lld %llu\n", -5l, 3000000000ul, 0xabcul,
+        -9000000000ll, 18000000000000000000ull);
+  check("Exponent %e %g %G\n", 1.5e-7, 123456789.0, 1e-10);
+  check("Nothing to expand\n");
+  // Truncated: a string is cut at the end of the payload, the arguments
+  // behind it are left out
+  std::string cut = "Long " + std::string(PAYLOAD_LEN - 1, 'x') + " then ...\n";
+  checkTruncated(cut.c_str(), "Long %s then %d\n", longText, 1);
+  checkTruncated("Ints 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20 21 "
+                 "22 ...\n",
+                 "Ints %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d "
+                 "%d %d %d %d %d %d\n",
+                 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17,
+                 18, 19, 20, 21, 22, 23, 24);
+
+  if (capture != nullptr) {
+    // A corrupt frame must not stop the expander
+    fputc(LOG_SINK_MAGIC0, capture);
+    fputc(LOG_SINK_MAGIC1, capture);
+    fputs("\x00\x00garbage\n", capture);
+    fclose(capture);
+
+    std::string command = std::string(expander) + " " + argv[0] + " " +
+                          CAPTURE_PATH + " 2>/dev/null";
+    FILE *out = popen(command.c_str(), "r");
+    std::string got;
+    char buf[256];
+    size_t n;
+    while (out != nullptr && (n = fread(buf, 1, sizeof(buf), out)) > 0) {
+      got.append(buf, n);
+    }
+    int status = out != nullptr ? pclose(out) : -1;
+    // The corrupt frame is passed through as is
+    got = got.substr(0, expected.size());
+    if (got != expected) {
+      printf("FAIL expander output differs:\n%s\n--- expected ---\n%s\n",
+             got.c_str(), expected.c_str());
+      failures++;
+    } else if (status == 0) {
+      printf("FAIL expander did not report the corrupt frame\n");
+      failures++;
+    } else {
+      printf("Expander output matches (%zu bytes)\n", expected.size());
+    }
+  }
+
+  printf("%s, %d failures\n", failures == 0 ? "PASS" : "FAIL", failures);
+  return failures == 0 ? 0 : 1;
+}
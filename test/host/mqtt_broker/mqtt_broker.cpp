@@ -0,0 +1,567 @@
+/*
+ Local MQTT broker stand-in for the Adafruit IO session of the probe.
+
+ Build:
+   g++ -O2 -pthread -o mqtt_broker mqtt_broker.cpp
+
+ Usage:
+   mqtt_broker [-p port] [-d n]
+   mqtt_broker --self-test
+
+ Build the firmware with -DAIO_MQTT_HOST=\"<address of this host>\" (and
+ -DAIO_MQTT_PORT=<port> if not 1883), so the probe connects here in plain
+ TCP instead of to io.adafruit.com. Every session is logged with its client
+ id, clean session flag and keepalive, every PUBLISH with its QoS, DUP flag
+ and packet id. A session that stays silent for 1.5 keepalives is closed as
+ a real broker does, which shows whether the probe pings in time. Sessions
+ of clients connecting with clean session = 0 are kept, and CONNACK reports
+ them as present on the next connect.
+
+ With -d n every n-th QoS 1 PUBLISH is not acknowledged and the connection
+ is closed instead, like a link that drops before the PUBACK arrives. The
+ summary printed on SIGINT then shows whether every value still arrived
+ (resent after the reconnect) and how many arrived twice.
+
+ --self-test runs the broker on a free port and checks it with a scripted
+ client over loopback: CONNACK and session present, PUBACK ids, SUBACK,
+ PINGRESP, the dropped PUBLISH and the keepalive timeout.
+*/
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_PORT 1883
+#define MAX_CLIENTS 8
+#define MAX_PACKET_LEN (64 * 1024)
+
+#define PACKET_CONNECT 0x10
+#define PACKET_CONNACK 0x20
+#define PACKET_PUBLISH 0x30
+#define PACKET_PUBACK 0x40
+#define PACKET_SUBSCRIBE 0x80
+#define PACKET_SUBACK 0x90
+#define PACKET_PINGREQ 0xC0
+#define PACKET_PINGRESP 0xD0
+#define PACKET_DISCONNECT 0xE0
+
+#define CONNECT_FLAG_CLEAN_SESSION 0x02
+
+typedef struct {
+  int fd;
+  std::string clientId;
+  uint16_t keepalive;  // seconds, 0 = none
+  double lastPacket;
+  bool connected;
+  std::vector<uint8_t> input;
+} client_t;
+
+typedef struct {
+  unsigned sessions = 0;
+  unsigned cleanSessions = 0;
+  unsigned resumedSessions = 0;
+  unsigned publishes = 0;
+  unsigned duplicates = 0;  // same topic and payload as one before
+  unsigned dupFlagged = 0;
+  unsigned dropped = 0;
+  unsigned pings = 0;
+  unsigned keepaliveExpired = 0;
+} broker_stats_t;
+
+static std::atomic<bool> running(true);
+static broker_stats_t stats;
+static std::set<std::string> storedSessions;  // client ids, clean session 0
+static std::set<std::string> received;        // topic + '\0' + payload
+static unsigned dropEvery = 0;
+static bool quiet = false;
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void brokerLog(const char *format, ...)
+    __attribute__((format(printf, 1, 2)));
+
+static void brokerLog(const char *format, ...) {
+  if (quiet) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+  fflush(stdout);
+}
+
+static void sendPacket(int fd, const uint8_t *packet, size_t len) {
+  if (write(fd, packet, len) != (ssize_t)len) {
+    brokerLog("write failed on %d\n", fd);
+  }
+}
+
+static std::string readString(const uint8_t *p, size_t len, size_t *offset) {
+  if (*offset + 2 > len) {
+    return std::string();
+  }
+  size_t n = (p[*offset] << 8) | p[*offset + 1];
+  *offset += 2;
+  if (*offset + n > len) {
+    n = len - *offset;
+  }
+  std::string s((const char *)p + *offset, n);
+  *offset += n;
+  return s;
+}
+
+static void closeClient(client_t *client, const char *reason) {
+  brokerLog("[%s] closed: %s\n", client->clientId.c_str(), reason);
+  close(client->fd);
+  client->fd = -1;
+}
+
+static bool handleConnect(client_t *client, const uint8_t *p, size_t len) {
+  size_t offset = 0;
+  std::string protocol = readString(p, len, &offset);
+  if (offset + 4 > len) {
+    return false;
+  }
+  uint8_t level = p[offset];
+  uint8_t flags = p[offset + 1];
+  client->keepalive = (p[offset + 2] << 8) | p[offset + 3];
+  offset += 4;
+  client->clientId = readString(p, len, &offset);
+
+  bool clean = flags & CONNECT_FLAG_CLEAN_SESSION;
+  bool present = !clean && storedSessions.count(client->clientId) > 0;
+  if (clean) {
+    storedSessions.erase(client->clientId);
+    stats.cleanSessions++;
+  } else {
+    storedSessions.insert(client->clientId);
+    if (present) {
+      stats.resumedSessions++;
+    }
+  }
+  stats.sessions++;
+  client->connected = true;
+  brokerLog("[%s] CONNECT %s level %u, clean session %d, keepalive %u s, "
+      "session present %d\n",
+      client->clientId.c_str(), protocol.c_str(), level, clean,
+      client->keepalive, present);
+
+  uint8_t connack[] = {PACKET_CONNACK, 2, (uint8_t)(present ? 1 : 0), 0};
+  sendPacket(client->fd, connack, sizeof(connack));
+  return true;
+}
+
+static bool handlePublish(client_t *client, uint8_t header, const uint8_t *p,
+                          size_t len) {
+  uint8_t qos = (header >> 1) & 0x03;
+  bool dup = header & 0x08;
+  size_t offset = 0;
+  std::string topic = readString(p, len, &offset);
+  uint16_t id = 0;
+  if (qos > 0) {
+    if (offset + 2 > len) {
+      return false;
+    }
+    id = (p[offset] << 8) | p[offset + 1];
+    offset += 2;
+  }
+  std::string payload((const char *)p + offset, len - offset);
+
+  stats.publishes++;
+  if (dup) {
+    stats.dupFlagged++;
+  }
+  std::string key = topic + '\0' + payload;
+  bool again = received.count(key) > 0;
+  if (again) {
+    stats.duplicates++;
+  }
+  brokerLog("[%s] PUBLISH %s qos %u%s id %u: %s%s\n", client->clientId.c_str(),
+      topic.c_str(), qos, dup ? " dup" : "", id, payload.c_str(),
+      again ? " (again)" : "");
+
+  if (qos == 1 && dropEvery > 0 && stats.publishes % dropEvery == 0) {
+    // Not recorded as received, the client has to send it again
+    stats.dropped++;
+    closeClient(client, "dropped before PUBACK");
+    return true;
+  }
+  received.insert(key);
+  if (qos == 1) {
+    uint8_t puback[] = {PACKET_PUBACK, 2, (uint8_t)(id >> 8), (uint8_t)id};
+    sendPacket(client->fd, puback, sizeof(puback));
+  }
+  return true;
+}
+
+static void handleSubscribe(client_t *client, const uint8_t *p, size_t len) {
+  if (len < 2) {
+    return;
+  }
+  uint16_t id = (p[0] << 8) | p[1];
+  size_t offset = 2;
+  std::vector<uint8_t> suback = {PACKET_SUBACK, 2, (uint8_t)(id >> 8),
+                                 (uint8_t)id};
+  while (offset < len) {
+    std::string topic = readString(p, len, &offset);
+    uint8_t qos = offset < len ? p[offset++] : 0;
+    brokerLog("[%s] SUBSCRIBE %s qos %u\n", client->clientId.c_str(),
+        topic.c_str(), qos);
+    suback.push_back(qos > 1 ? 1 : qos);
+    suback[1]++;
+  }
+  sendPacket(client->fd, suback.data(), suback.size());
+}
+
+/*
+ Handles the complete packets in the input of the client. Returns false if
+ the client has to be closed.
+*/
+static bool handleInput(client_t *client) {
+  std::vector<uint8_t> &in = client->input;
+  while (!in.empty()) {
+    // Remaining length, 1 to 4 bytes of 7 bits
+    size_t length = 0;
+    size_t pos = 1;
+    int shift = 0;
+    while (true) {
+      if (pos >= in.size()) {
+        return true;
+      }
+      uint8_t b = in[pos++];
+      length |= (size_t)(b & 0x7f) << shift;
+      shift += 7;
+      if (!(b & 0x80)) {
+        break;
+      }
+      if (shift > 21) {
+        return false;
+      }
+    }
+    if (length > MAX_PACKET_LEN) {
+      return false;
+    }
+    if (in.size() < pos + length) {
+      return true;
+    }
+
+    uint8_t header = in[0];
+    const uint8_t *body = in.data() + pos;
+    client->lastPacket = now();
+    uint8_t type = header & 0xf0;
+    if (type != PACKET_CONNECT && !client->connected) {
+      return false;
+    }
+    switch (type) {
+      case PACKET_CONNECT:
+        if (!handleConnect(client, body, length)) {
+          return false;
+        }
+        break;
+      case PACKET_PUBLISH:
+        if (!handlePublish(client, header, body, length)) {
+          return false;
+        }
+        if (client->fd < 0) {
+          return true;
+        }
+        break;
+      case PACKET_SUBSCRIBE:
+        handleSubscribe(client, body, length);
+        break;
+      case PACKET_PINGREQ: {
+        stats.pings++;
+        uint8_t pingresp[] = {PACKET_PINGRESP, 0};
+        sendPacket(client->fd, pingresp, sizeof(pingresp));
+        break;
+      }
+      case PACKET_DISCONNECT:
+        closeClient(client, "DISCONNECT");
+        return true;
+      default:
+        brokerLog("[%s] ignoring packet 0x%02x\n", client->clientId.c_str(),
+            header);
+        break;
+    }
+    in.erase(in.begin(), in.begin() + pos + length);
+  }
+  return true;
+}
+
+static int listenOn(uint16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(fd, MAX_CLIENTS) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void serve(int listener) {
+  std::vector<client_t> clients;
+  while (running.load()) {
+    std::vector<struct pollfd> fds;
+    fds.push_back({listener, POLLIN, 0});
+    for (client_t &c : clients) {
+      fds.push_back({c.fd, POLLIN, 0});
+    }
+    if (poll(fds.data(), fds.size(), 100) < 0) {
+      continue;
+    }
+
+    // Only the clients that were polled, an accepted one is added behind
+    size_t polled = clients.size();
+    if (fds[0].revents & POLLIN) {
+      int fd = accept(listener, nullptr, nullptr);
+      if (fd >= 0) {
+        clients.push_back({fd, "?", 0, now(), false, {}});
+      }
+    }
+    for (size_t i = 0; i < polled; i++) {
+      client_t &c = clients[i];
+      if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+        uint8_t buf[1024];
+        ssize_t n = read(c.fd, buf, sizeof(buf));
+        if (n <= 0) {
+          closeClient(&c, "connection lost");
+          continue;
+        }
+        c.input.insert(c.input.end(), buf, buf + n);
+        if (!handleInput(&c) && c.fd >= 0) {
+          closeClient(&c, "protocol error");
+        }
+      }
+    }
+    for (client_t &c : clients) {
+      if (c.fd >= 0 && c.keepalive > 0 &&
+          now() - c.lastPacket > c.keepalive * 1.5) {
+        stats.keepaliveExpired++;
+        closeClient(&c, "keepalive expired");
+      }
+    }
+    for (size_t i = clients.size(); i-- > 0;) {
+      if (clients[i].fd < 0) {
+        clients.erase(clients.begin() + i);
+      }
+    }
+  }
+  for (client_t &c : clients) {
+    close(c.fd);
+  }
+}
+
+static void printSummary() {
+  printf("%u sessions (%u clean, %u resumed), %u publishes (%u distinct, "
+         "%u again, %u with DUP), %u dropped, %u pings, %u keepalive "
+         "expiries\n",
+         stats.sessions, stats.cleanSessions, stats.resumedSessions,
+         stats.publishes, (unsigned)received.size(), stats.duplicates,
+         stats.dupFlagged, stats.dropped, stats.pings,
+         stats.keepaliveExpired);
+}
+
+//-------- Self test
+
+static int failures = 0;
+
+static void expect(bool condition, const char *what) {
+  if (!condition) {
+    printf("FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+static int connectTo(uint16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void putString(std::vector<uint8_t> *p, const std::string &s) {
+  p->push_back(s.size() >> 8);
+  p->push_back(s.size() & 0xff);
+  p->insert(p->end(), s.begin(), s.end());
+}
+
+static void sendFramed(int fd, uint8_t header,
+                       const std::vector<uint8_t> &body) {
+  std::vector<uint8_t> packet = {header};
+  size_t len = body.size();
+  do {
+    uint8_t b = len & 0x7f;
+    len >>= 7;
+    packet.push_back(b | (len > 0 ? 0x80 : 0));
+  } while (len > 0);
+  packet.insert(packet.end(), body.begin(), body.end());
+  sendPacket(fd, packet.data(), packet.size());
+}
+
+// Reads one short packet, empty on timeout or a closed connection
+static std::vector<uint8_t> receive(int fd, int timeoutMs = 1000) {
+  struct pollfd pfd = {fd, POLLIN, 0};
+  uint8_t buf[64];
+  if (poll(&pfd, 1, timeoutMs) <= 0) {
+    return {};
+  }
+  ssize_t n = read(fd, buf, sizeof(buf));
+  return n > 0 ? std::vector<uint8_t>(buf, buf + n) : std::vector<uint8_t>();
+}
+
+static int sessionConnect(uint16_t port, bool clean, uint16_t keepalive,
+                          uint8_t *sessionPresent) {
+  int fd = connectTo(port);
+  std::vector<uint8_t> body;
+  putString(&body, "MQTT");
+  body.push_back(4);
+  body.push_back(clean ? CONNECT_FLAG_CLEAN_SESSION : 0);
+  body.push_back(keepalive >> 8);
+  body.push_back(keepalive & 0xff);
+  putString(&body, "probe");
+  sendFramed(fd, PACKET_CONNECT, body);
+  std::vector<uint8_t> connack = receive(fd);
+  expect(connack.size() == 4 && connack[0] == PACKET_CONNACK &&
+             connack[3] == 0,
+         "CONNACK accepted");
+  *sessionPresent = connack.size() == 4 ? connack[2] : 0xff;
+  return fd;
+}
+
+static std::vector<uint8_t> publish(int fd, const std::string &topic,
+                                    const std::string &payload, uint16_t id) {
+  std::vector<uint8_t> body;
+  putString(&body, topic);
+  body.push_back(id >> 8);
+  body.push_back(id & 0xff);
+  body.insert(body.end(), payload.begin(), payload.end());
+  sendFramed(fd, PACKET_PUBLISH | (1 << 1), body);
+  return receive(fd);
+}
+
+static int selfTest() {
+  quiet = true;
+  int listener = listenOn(0);
+  struct sockaddr_in addr;
+  socklen_t addrLen = sizeof(addr);
+  getsockname(listener, (struct sockaddr *)&addr, &addrLen);
+  uint16_t port = ntohs(addr.sin_port);
+  dropEvery = 3;
+  std::thread broker(serve, listener);
+
+  uint8_t present;
+  int fd = sessionConnect(port, false, 60, &present);
+  expect(present == 0, "no session on the first connect");
+
+  std::vector<uint8_t> ack = publish(fd, "user/feeds/temperature", "21.5", 7);
+  expect(ack == std::vector<uint8_t>({PACKET_PUBACK, 2, 0, 7}), "PUBACK 7");
+  ack = publish(fd, "user/feeds/humidity", "45.2", 8);
+  expect(ack == std::vector<uint8_t>({PACKET_PUBACK, 2, 0, 8}), "PUBACK 8");
+
+  std::vector<uint8_t> body = {0, 9};
+  putString(&body, "user/throttle");
+  body.push_back(1);
+  sendFramed(fd, PACKET_SUBSCRIBE | 0x02, body);
+  expect(receive(fd) == std::vector<uint8_t>({PACKET_SUBACK, 3, 0, 9, 1}),
+         "SUBACK 9");
+
+  sendFramed(fd, PACKET_PINGREQ, {});
+  expect(receive(fd) == std::vector<uint8_t>({PACKET_PINGRESP, 0}),
+         "PINGRESP");
+
+  // The third publish is dropped, the connection closes without PUBACK
+  ack = publish(fd, "user/feeds/pressure", "101325", 10);
+  expect(ack.empty(), "no PUBACK for the dropped publish");
+  close(fd);
+
+  fd = sessionConnect(port, false, 1, &present);
+  expect(present == 1, "session present after reconnect");
+  ack = publish(fd, "user/feeds/pressure", "101325", 11);
+  expect(ack == std::vector<uint8_t>({PACKET_PUBACK, 2, 0, 11}),
+         "PUBACK for the resent publish");
+  // Silent for longer than 1.5 keepalives
+  expect(receive(fd, 2500).empty(), "closed after the keepalive");
+  close(fd);
+
+  fd = sessionConnect(port, true, 60, &present);
+  expect(present == 0, "no session with clean session");
+  close(fd);
+
+  usleep(200 * 1000);
+  running.store(false);
+  broker.join();
+  close(listener);
+
+  expect(stats.sessions == 3, "3 sessions");
+  expect(stats.resumedSessions == 1, "1 resumed session");
+  expect(stats.dropped == 1, "1 dropped publish");
+  expect(received.size() == 3, "every value received once acknowledged");
+  expect(stats.keepaliveExpired == 1, "1 keepalive expiry");
+  printSummary();
+  printf("%s, %d failures\n", failures == 0 ? "PASS" : "FAIL", failures);
+  return failures == 0 ? 0 : 1;
+}
+
+static void stop(int) { running.store(false); }
+
+int main(int argc, char **argv) {
+  uint16_t port = DEFAULT_PORT;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--self-test") == 0) {
+      return selfTest();
+    } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+      dropEvery = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "Usage: %s [-p port] [-d n] | --self-test\n", argv[0]);
+      return 2;
+    }
+  }
+
+  int listener = listenOn(port);
+  if (listener < 0) {
+    perror("listen");
+    return 1;
+  }
+  signal(SIGINT, stop);
+  printf("Listening on port %u%s\n", port,
+         dropEvery > 0 ? ", dropping every n-th QoS 1 publish" : "");
+  serve(listener);
+  close(listener);
+  printSummary();
+  return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ Host side benchmark of SpscQueue and MpscQueue against a queue emulating
+ the FreeRTOS xQueueSend / xQueueReceive semantics.
+
+ Build:
+   g++ -O2 -std=c++11 -pthread -DCPP_UTILS_CACHE_LINE_SIZE=64 \
+       -I../../../lib/cpp_utils -o queues_bench queues_bench.cpp
+
+ Usage:
+   queues_bench [items per producer]
+
+ The emulated queue copies items in and out under a mutex and blocks on
+ condition variables like a FreeRTOS queue does with a critical section and
+ its event lists. The lock-free queues spin with a yield when full or empty.
+ Host numbers only give the ratio, measure on the probe for absolute values.
+*/
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MpscQueue.h"
+#include "SpscQueue.h"
+
+#define QUEUE_LEN 32
+#define PRODUCERS 4
+
+typedef struct {
+  const void *format;
+  uint8_t length;
+  uint8_t payload[88];
+} bench_item_t;
+
+class EmulatedFreeRtosQueue {
+ public:
+  EmulatedFreeRtosQueue() : m_head(0), m_count(0) {}
+
+  void send(const bench_item_t *pItem) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_notFull.wait(lock, [this]() { return m_count < QUEUE_LEN; });
+    memcpy(&m_items[(m_head + m_count) % QUEUE_LEN], pItem, sizeof(*pItem));
+    m_count++;
+    m_notEmpty.notify_one();
+  }
+
+  void receive(bench_item_t *pItem) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_notEmpty.wait(lock, [this]() { return m_count > 0; });
+    memcpy(pItem, &m_items[m_head], sizeof(*pItem));
+    m_head = (m_head + 1) % QUEUE_LEN;
+    m_count--;
+    m_notFull.notify_one();
+  }
+
+ private:
+  std::mutex m_mutex;
+  std::condition_variable m_notFull;
+  std::condition_variable m_notEmpty;
+  size_t m_head;
+  size_t m_count;
+  bench_item_t m_items[QUEUE_LEN];
+};
+
+static volatile uint32_t sink;
+
+template <typename Push, typename Pop>
+static double nsPerItem(uint32_t producers, uint32_t count, Push push,
+                        Pop pop) {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (uint32_t p = 0; p < producers; p++) {
+    threads.emplace_back([count, push]() {
+      bench_item_t item;
+      memset(&item, 0, sizeof(item));
+      for (uint32_t i = 0; i < count; i++) {
+        item.length = (uint8_t)i;
+        push(item);
+      }
+    });
+  }
+  bench_item_t item;
+  for (uint32_t i = 0; i < producers * count; i++) {
+    pop(item);
+    sink += item.length;
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         (producers * count);
+}
+
+int main(int argc, char **argv) {
+  uint32_t count = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : 1000000;
+  static EmulatedFreeRtosQueue rtosQueue;
+  static SpscQueue<bench_item_t, QUEUE_LEN> spscQueue;
+  static MpscQueue<bench_item_t, QUEUE_LEN> mpscQueue;
+
+  auto rtosPush = [](const bench_item_t &item) { rtosQueue.send(&item); };
+  auto rtosPop = [](bench_item_t &item) { rtosQueue.receive(&item); };
+  auto spscPush = [](const bench_item_t &item) {
+    while (!spscQueue.push(item)) {
+      std::this_thread::yield();
+    }
+  };
+  auto spscPop = [](bench_item_t &item) {
+    while (!spscQueue.pop(item)) {
+      std::this_thread::yield();
+    }
+  };
+  auto mpscPush = [](const bench_item_t &item) {
+    while (!mpscQueue.push(item)) {
+      std::this_thread::yield();
+    }
+  };
+  auto mpscPop = [](bench_item_t &item) {
+    while (!mpscQueue.pop(item)) {
+      std::this_thread::yield();
+    }
+  };
+
+  double rtosSingle = nsPerItem(1, count, rtosPush, rtosPop);
+  double spsc = nsPerItem(1, count, spscPush, spscPop);
+  double rtosMulti = nsPerItem(PRODUCERS, count, rtosPush, rtosPop);
+  double mpsc = nsPerItem(PRODUCERS, count, mpscPush, mpscPop);
+
+  printf("1 producer:  emulated FreeRTOS %.1f ns/item, SpscQueue %.1f "
+         "ns/item (%.1fx)\n",
+         rtosSingle, spsc, rtosSingle / spsc);
+  printf("%d producers: emulated FreeRTOS %.1f ns/item, MpscQueue %.1f "
+         "ns/item (%.1fx)\n",
+         PRODUCERS, rtosMulti, mpsc, rtosMulti / mpsc);
+  return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ Host side stress test of SpscQueue, MpscQueue and ObjectPool under
+ ThreadSanitizer.
+
+ Build:
+   g++ -O1 -g -std=c++11 -fsanitize=thread -pthread \
+       -DCPP_UTILS_CACHE_LINE_SIZE=64 -I../../../lib/cpp_utils \
+       -o queues_stress queues_stress.cpp
+
+ Usage:
+   queues_stress [items per producer]
+
+ Runs producers and consumers on separate threads with small capacities so
+ the full and empty paths are hit constantly. The items carry plain, non
+ atomic payloads, so a missing acquire or release shows up as a TSan data
+ race, and the consumers check order and checksums. Exits with 1 on a lost,
+ duplicated or reordered item.
+*/
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "MpscQueue.h"
+#include "ObjectPool.h"
+#include "SpscQueue.h"
+
+#define MPSC_PRODUCERS 4
+#define POOL_THREADS 4
+
+typedef struct {
+  uint32_t producer;
+  uint32_t sequence;
+  uint32_t payload[6];
+  uint32_t checksum;
+} stress_item_t;
+
+static std::atomic<int> failures(0);
+
+static void fill(stress_item_t *item, uint32_t producer, uint32_t sequence) {
+  item->producer = producer;
+  item->sequence = sequence;
+  item->checksum = producer ^ sequence;
+  for (uint32_t i = 0; i < 6; i++) {
+    item->payload[i] = sequence * 2654435761u + i;
+    item->checksum ^= item->payload[i];
+  }
+}
+
+static bool valid(const stress_item_t &item) {
+  uint32_t checksum = item.producer ^ item.sequence;
+  for (uint32_t i = 0; i < 6; i++) {
+    checksum ^= item.payload[i];
+  }
+  return checksum == item.checksum;
+}
+
+static void fail(const char *what, uint32_t producer, uint32_t sequence) {
+  if (failures++ < 10) {
+    printf("%s: producer %u, sequence %u\n", what, producer, sequence);
+  }
+}
+
+static void stressSpsc(uint32_t count) {
+  static SpscQueue<stress_item_t, 4> queue;
+
+  std::thread producer([count]() {
+    for (uint32_t i = 0; i < count; i++) {
+      if (i & 1) {
+        stress_item_t item;
+        fill(&item, 0, i);
+        while (!queue.push(item)) {
+          std::this_thread::yield();
+        }
+      } else {
+        stress_item_t *pSlot;
+        while ((pSlot = queue.beginPush()) == nullptr) {
+          std::this_thread::yield();
+        }
+        fill(pSlot, 0, i);
+        queue.endPush();
+      }
+    }
+  });
+
+  for (uint32_t expected = 0; expected < count; expected++) {
+    stress_item_t item;
+    if (expected & 2) {
+      while (!queue.pop(item)) {
+        std::this_thread::yield();
+      }
+    } else {
+      stress_item_t *pFront;
+      while ((pFront = queue.front()) == nullptr) {
+        std::this_thread::yield();
+      }
+      item = *pFront;
+      queue.popFront();
+    }
+    if (!valid(item)) {
+      fail("SPSC corrupt item", item.producer, item.sequence);
+    } else if (item.sequence != expected) {
+      fail("SPSC out of order", item.producer, item.sequence);
+    }
+  }
+  producer.join();
+  if (!queue.empty()) {
+    fail("SPSC not empty", 0, 0);
+  }
+  printf("SpscQueue: %u items\n", count);
+}
+
+static void stressMpsc(uint32_t count) {
+  static MpscQueue<stress_item_t, 8> queue;
+  std::vector<std::thread> producers;
+
+  for (uint32_t p = 0; p < MPSC_PRODUCERS; p++) {
+    producers.emplace_back([p, count]() {
+      for (uint32_t i = 0; i < count; i++) {
+        if (i & 1) {
+          stress_item_t item;
+          fill(&item, p, i);
+          while (!queue.push(item)) {
+            std::this_thread::yield();
+          }
+        } else {
+          size_t ticket;
+          stress_item_t *pSlot;
+          while ((pSlot = queue.beginPush(ticket)) == nullptr) {
+            std::this_thread::yield();
+          }
+          fill(pSlot, p, i);
+          queue.endPush(ticket);
+        }
+      }
+    });
+  }
+
+  uint32_t next[MPSC_PRODUCERS] = {0};
+  for (uint32_t received = 0; received < count * MPSC_PRODUCERS; received++) {
+    stress_item_t *pFront;
+    while ((pFront = queue.front()) == nullptr) {
+      std::this_thread::yield();
+    }
+    stress_item_t item = *pFront;
+    queue.popFront();
+    if (!valid(item) || item.producer >= MPSC_PRODUCERS) {
+      fail("MPSC corrupt item", item.producer, item.sequence);
+    } else if (item.sequence != next[item.producer]++) {
+      // a single producer's items must stay in order
+      fail("MPSC out of order", item.producer, item.sequence);
+      next[item.producer] = item.sequence + 1;
+    }
+  }
+  for (std::thread &producer : producers) {
+    producer.join();
+  }
+  if (!queue.empty()) {
+    fail("MPSC not empty", 0, 0);
+  }
+  printf("MpscQueue: %u producers, %u items each\n", MPSC_PRODUCERS, count);
+}
+
+static void stressPool(uint32_t count) {
+  static ObjectPool<stress_item_t, 3> pool;
+  std::vector<std::thread> threads;
+
+  for (uint32_t t = 0; t < POOL_THREADS; t++) {
+    threads.emplace_back([t, count]() {
+      for (uint32_t i = 0; i < count; i++) {
+        stress_item_t *pItem;
+        while ((pItem = pool.acquire()) == nullptr) {
+          std::this_thread::yield();
+        }
+        // a second owner of the same object would race on these writes
+        fill(pItem, t, i);
+        std::this_thread::yield();
+        if (!valid(*pItem) || pItem->producer != t || pItem->sequence != i) {
+          fail("ObjectPool object shared", t, i);
+        }
+        pool.release(pItem);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  if (pool.available() != pool.capacity()) {
+    fail("ObjectPool leaked objects", 0, (uint32_t)pool.available());
+  }
+  printf("ObjectPool: %u threads, %u cycles each\n", POOL_THREADS, count);
+}
+
+int main(int argc, char **argv) {
+  uint32_t count = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : 200000;
+
+  stressSpsc(count);
+  stressMpsc(count);
+  stressPool(count);
+
+  printf("%d failures\n", failures.load());
+  return failures == 0 ? 0 : 1;
+}
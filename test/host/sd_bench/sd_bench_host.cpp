@@ -0,0 +1,32 @@
+/*
+ Runs the SD card benchmark of the probe on the host against the file
+ backed fs::FS stand-in.
+
+ Build:
+   g++ -O2 -I../support -I../../../src -o sd_bench_host sd_bench_host.cpp \
+       ../support/Arduino.cpp ../support/FS.cpp ../../../src/sd_bench.cpp
+
+ Usage:
+   sd_bench_host [directory]
+
+ Benchmarks <directory>/bench.bin, the current directory by default. Point
+ it at a mounted card reader to compare card and host file system, or at a
+ tmpfs to see the overhead of the benchmark itself.
+*/
+#include <cstdio>
+
+#include "FS.h"
+#include "sd_bench.h"
+
+static void printResult(const sdbench_result_t &result) {
+  printf("%-10s %6u B x %4u: %8.2f MB/s, p50 %6u us, p99 %6u us, max %6u us\n",
+         sdbench_testName(result.test), (unsigned)result.blockSize,
+         (unsigned)result.ops, sdbench_megabytesPerSecond(result),
+         (unsigned)result.p50Micros, (unsigned)result.p99Micros,
+         (unsigned)result.maxMicros);
+}
+
+int main(int argc, char **argv) {
+  fs::FS fs(argc > 1 ? argv[1] : ".");
+  return sdbench_run(fs, "/bench.bin", printResult) ? 0 : 1;
+}
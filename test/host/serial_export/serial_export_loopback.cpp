@@ -0,0 +1,270 @@
+/*
+ Host side loopback of the serial export: serialexport_send() on one side
+ of a pty, tools/export_receiver on the other.
+
+ Build:
+   g++ -O2 -I../support -I../../../src -o serial_export_loopback \
+       serial_export_loopback.cpp ../support/Arduino.cpp \
+       ../support/HardwareSerial.cpp ../support/FS.cpp \
+       ../../../src/serial_export.cpp ../../../src/deflate.cpp \
+       ../../../src/crc32.cpp -lpthread
+   and tools/export_receiver as described there.
+
+ Usage:
+   serial_export_loopback <export_receiver> <file> [-z] [--throttle]
+       [--resume <bytes>] [--corrupt <wire offset>]
+
+ Starts the receiver on the pty for <file>, answers its "export" commands
+ like the console does and compares <file>.received with <file> once the
+ receiver exits. -z requests compressed frames. --throttle paces the device
+ side at the baud rate, 10 bits per byte, because a pty alone does not, so
+ the time comes close to the UART. --resume seeds the local file with the
+ first bytes of <file>, and --corrupt flips one byte on the wire once, which
+ makes the receiver request the rest again.
+*/
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Arduino.h"
+#include "FS.h"
+#include "log_sink.h"
+#include "serial_export.h"
+
+#define COMMAND_LEN 128
+
+static int master = -1;
+static int relayEnd = -1;   // socket pair between the relay thread
+static int deviceEnd = -1;  // and Serial
+static pid_t receiver = -1;
+static std::atomic<bool> receiverExited(false);
+static std::atomic<bool> stopRelay(false);
+static int receiverStatus = 0;
+static uint64_t wireBytes = 0;
+static int64_t corruptOffset = -1;
+static unsigned pauseCount = 0;
+
+// The log sink is not linked, serial_export.cpp only pauses it
+void logsink_pause(bool paused) {
+  if (paused) {
+    pauseCount++;
+  }
+}
+
+/*
+ Copies the device output to the pty and the commands back, counting the
+ bytes on the wire and flipping the one at corruptOffset. Once the receiver
+ exited, the rest of the device output is dropped so a transfer it gave up
+ on can finish.
+*/
+static void relay() {
+  uint8_t buf[4096];
+  size_t len = 0;
+  size_t pos = 0;
+
+  while (!stopRelay) {
+    bool toPty = !receiverExited;
+    struct pollfd pfds[2] = {
+        {relayEnd, (short)(pos == len ? POLLIN : 0), 0},
+        {master, (short)(toPty ? POLLIN | (pos < len ? POLLOUT : 0) : 0), 0}};
+    poll(pfds, 2, 100);
+
+    if (pfds[0].revents & POLLIN) {
+      ssize_t n = read(relayEnd, buf, sizeof(buf));
+      len = n > 0 ? n : 0;
+      pos = 0;
+      if (corruptOffset >= (int64_t)wireBytes &&
+          corruptOffset < (int64_t)(wireBytes + len)) {
+        buf[corruptOffset - wireBytes] ^= 0xFF;
+        corruptOffset = -1;
+      }
+      wireBytes += len;
+      if (!toPty) {
+        pos = len;
+      }
+    }
+    if (pfds[1].revents & POLLOUT) {
+      ssize_t n = write(master, buf + pos, len - pos);
+      pos += n > 0 ? n : 0;
+    }
+    if (pfds[1].revents & POLLIN) {
+      char command[COMMAND_LEN];
+      ssize_t n = read(master, command, sizeof(command));
+      if (n > 0 && write(relayEnd, command, n) != n) {
+        fprintf(stderr, "Lost a command\n");
+      }
+    }
+
+    if (!receiverExited && waitpid(receiver, &receiverStatus, WNOHANG) > 0) {
+      receiverExited = true;
+    }
+  }
+}
+
+// Reads a command line from Serial, false if none came in time
+static bool readCommand(char *line, size_t size) {
+  size_t len = 0;
+  while (!receiverExited) {
+    struct pollfd pfd = {deviceEnd, POLLIN, 0};
+    if (poll(&pfd, 1, 100) <= 0) {
+      continue;
+    }
+    int c = Serial.read();
+    if (c == '\n') {
+      line[len] = '\0';
+      return true;
+    }
+    if (c >= 0 && c != '\r' && len + 1 < size) {
+      line[len++] = c;
+    }
+  }
+  return false;
+}
+
+// The "export" console command, see sd_exportCommand()
+static void exportCommand(fs::FS &fs, const char *args) {
+  char path[64];
+  unsigned long offset = 0;
+  char mode[2] = "";
+
+  if (sscanf(args, "%63s %lu %1s", path, &offset, mode) < 1) {
+    Serial.println("Usage: export <path> [offset [z]]");
+    return;
+  }
+  serialexport_send(fs, path, offset, UINT32_MAX, mode[0] == 'z');
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> *data) {
+  FILE *file = fopen(path, "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  data->clear();
+  while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+    data->insert(data->end(), buf, buf + n);
+  }
+  fclose(file);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr,
+            "Usage: %s <export_receiver> <file> [-z] [--throttle] "
+            "[--resume <bytes>] [--corrupt <wire offset>]\n",
+            argv[0]);
+    return 2;
+  }
+  const char *receiverPath = argv[1];
+  std::string source = argv[2];
+  bool compress = false;
+  bool throttle = false;
+  size_t resume = 0;
+  for (int i = 3; i < argc; i++) {
+    if (strcmp(argv[i], "-z") == 0) {
+      compress = true;
+    } else if (strcmp(argv[i], "--throttle") == 0) {
+      throttle = true;
+    } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+      resume = strtoul(argv[++i], nullptr, 0);
+    } else if (strcmp(argv[i], "--corrupt") == 0 && i + 1 < argc) {
+      corruptOffset = strtoll(argv[++i], nullptr, 0);
+    }
+  }
+
+  std::vector<uint8_t> expected;
+  if (!readFile(source.c_str(), &expected)) {
+    perror(source.c_str());
+    return 1;
+  }
+  size_t slash = source.rfind('/');
+  std::string root =
+      slash == std::string::npos ? "." : source.substr(0, slash);
+  std::string remotePath =
+      "/" + (slash == std::string::npos ? source : source.substr(slash + 1));
+  fs::FS fs(root.c_str());
+
+  std::string local = source + ".received";
+  FILE *seed = fopen(local.c_str(), "wb");
+  if (seed == nullptr) {
+    perror(local.c_str());
+    return 1;
+  }
+  if (resume > expected.size()) {
+    resume = expected.size();
+  }
+  fwrite(expected.data(), 1, resume, seed);
+  fclose(seed);
+
+  master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    perror("pty");
+    return 1;
+  }
+  std::string slavePath = ptsname(master);
+  // Held open so the master does not hang up before the receiver opens it
+  int slave = open(slavePath.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+  int pair[2];
+  if (slave < 0 || socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+    perror("loopback");
+    return 1;
+  }
+  relayEnd = pair[0];
+  deviceEnd = pair[1];
+  Serial.attach(deviceEnd);
+  Serial.setThrottled(throttle);
+  Serial.begin(SERIAL_EXPORT_CONSOLE_BAUD);
+
+  auto start = std::chrono::steady_clock::now();
+  receiver = fork();
+  if (receiver == 0) {
+    close(pair[0]);
+    close(pair[1]);
+    execl(receiverPath, receiverPath, slavePath.c_str(), remotePath.c_str(),
+          local.c_str(), compress ? "-z" : nullptr, nullptr);
+    perror(receiverPath);
+    _exit(127);
+  }
+  std::thread relayThread(relay);
+
+  unsigned commands = 0;
+  char line[COMMAND_LEN];
+  while (readCommand(line, sizeof(line))) {
+    if (strncmp(line, "export ", 7) == 0) {
+      exportCommand(fs, line + 7);
+      commands++;
+    } else {
+      fprintf(stderr, "Unknown command '%s'\n", line);
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  stopRelay = true;
+  relayThread.join();
+  close(slave);
+  close(master);
+
+  std::vector<uint8_t> received;
+  bool identical = readFile(local.c_str(), &received) && received == expected;
+  printf("%s: %u export command(s), %u log pause(s), %llu bytes from the "
+         "device in %.2f s, %s\n",
+         remotePath.c_str(), commands, pauseCount,
+         (unsigned long long)wireBytes, elapsed.count(),
+         identical ? "identical" : "DIFFERENT");
+  bool receiverOk = WIFEXITED(receiverStatus) &&
+                    WEXITSTATUS(receiverStatus) == 0;
+  return identical && receiverOk ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+#include "Arduino.h"
+
+#include <chrono>
+#include <thread>
+
+static const std::chrono::steady_clock::time_point bootTime =
+    std::chrono::steady_clock::now();
+
+unsigned long millis() { return (unsigned long)(uint32_t)(micros() / 1000); }
+
+unsigned long micros() {
+  auto elapsed = std::chrono::steady_clock::now() - bootTime;
+  return (unsigned long)(uint32_t)std::chrono::duration_cast<
+      std::chrono::microseconds>(elapsed).count();
+}
+
+void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
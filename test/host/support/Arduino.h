@@ -0,0 +1,32 @@
+/*
+ Minimal Arduino core for host builds of the probe modules: the clock
+ functions, backed by std::chrono, the FreeRTOS critical sections as
+ spinlocks and Serial (see HardwareSerial.h, link HardwareSerial.cpp when
+ it is used).
+*/
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#include "HardwareSerial.h"
+
+typedef struct {
+  std::atomic_flag flag;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {ATOMIC_FLAG_INIT}
+#define portENTER_CRITICAL(mux)                                   \
+  while ((mux)->flag.test_and_set(std::memory_order_acquire)) { \
+  }
+#define portEXIT_CRITICAL(mux) (mux)->flag.clear(std::memory_order_release)
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+#endif
@@ -0,0 +1,173 @@
+#include "FS.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace fs {
+
+struct FileImpl {
+  FS *fs;
+  std::string path;  // path as seen by the probe
+  std::string hostPath;
+  FILE *file;
+  DIR *dir;
+
+  ~FileImpl() {
+    if (file != nullptr) {
+      if (fs->m_syncOnClose) {
+        fflush(file);
+        fsync(fileno(file));
+      }
+      fclose(file);
+    }
+    if (dir != nullptr) {
+      closedir(dir);
+    }
+  }
+};
+
+size_t File::write(uint8_t value) { return write(&value, 1); }
+
+size_t File::write(const uint8_t *buf, size_t len) {
+  if (!m_impl || m_impl->file == nullptr) {
+    return 0;
+  }
+  size_t written = fwrite(buf, 1, len, m_impl->file);
+  m_impl->fs->m_bytesWritten += written;
+  return written;
+}
+
+size_t File::read(uint8_t *buf, size_t len) {
+  if (!m_impl || m_impl->file == nullptr) {
+    return 0;
+  }
+  return fread(buf, 1, len, m_impl->file);
+}
+
+int File::read() {
+  uint8_t value;
+  return read(&value, 1) == 1 ? value : -1;
+}
+
+int File::available() { return (int)(size() - position()); }
+
+void File::flush() {
+  if (m_impl && m_impl->file != nullptr) {
+    fflush(m_impl->file);
+  }
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!m_impl || m_impl->file == nullptr) {
+    return false;
+  }
+  static const int whence[] = {SEEK_SET, SEEK_CUR, SEEK_END};
+  return fseek(m_impl->file, (long)pos, whence[mode]) == 0;
+}
+
+size_t File::position() const {
+  if (!m_impl || m_impl->file == nullptr) {
+    return 0;
+  }
+  long pos = ftell(m_impl->file);
+  return pos < 0 ? 0 : (size_t)pos;
+}
+
+size_t File::size() const {
+  if (!m_impl || m_impl->file == nullptr) {
+    return 0;
+  }
+  fflush(m_impl->file);
+  struct stat st;
+  if (fstat(fileno(m_impl->file), &st) != 0) {
+    return 0;
+  }
+  return (size_t)st.st_size;
+}
+
+void File::close() { m_impl.reset(); }
+
+File::operator bool() const { return (bool)m_impl; }
+
+const char *File::name() const {
+  return m_impl ? m_impl->path.c_str() : "";
+}
+
+bool File::isDirectory() const { return m_impl && m_impl->dir != nullptr; }
+
+File File::openNextFile(const char *mode) {
+  if (!isDirectory()) {
+    return File();
+  }
+  struct dirent *entry;
+  while ((entry = readdir(m_impl->dir)) != nullptr) {
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+      std::string path = m_impl->path;
+      if (path.empty() || path[path.size() - 1] != '/') {
+        path += '/';
+      }
+      path += entry->d_name;
+      return m_impl->fs->open(path.c_str(), mode);
+    }
+  }
+  return File();
+}
+
+void File::rewindDirectory() {
+  if (isDirectory()) {
+    rewinddir(m_impl->dir);
+  }
+}
+
+std::string FS::hostPath(const char *path) const {
+  return m_root + (path[0] == '/' ? "" : "/") + path;
+}
+
+File FS::open(const char *path, const char *mode) {
+  std::shared_ptr<FileImpl> impl(new FileImpl());
+  impl->fs = this;
+  impl->path = path;
+  impl->hostPath = hostPath(path);
+  impl->file = nullptr;
+  impl->dir = nullptr;
+
+  struct stat st;
+  if (stat(impl->hostPath.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    impl->dir = opendir(impl->hostPath.c_str());
+    return impl->dir != nullptr ? File(impl) : File();
+  }
+
+  const char *hostMode = strcmp(mode, "r+") == 0       ? "r+b"
+                         : strcmp(mode, FILE_WRITE) == 0  ? "wb"
+                         : strcmp(mode, FILE_APPEND) == 0 ? "ab"
+                                                          : "rb";
+  impl->file = fopen(impl->hostPath.c_str(), hostMode);
+  return impl->file != nullptr ? File(impl) : File();
+}
+
+bool FS::exists(const char *path) {
+  struct stat st;
+  return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char *path) {
+  return unlink(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *from, const char *to) {
+  return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char *path) {
+  return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+}
+
+bool FS::rmdir(const char *path) {
+  return ::rmdir(hostPath(path).c_str()) == 0;
+}
+
+}  // namespace fs
@@ -0,0 +1,87 @@
+/*
+ File backed stand-in for the fs::FS and fs::File classes of the Arduino
+ core, so the modules that only need a file system (sd_bench, datalog,
+ retention) run on the host. Paths are resolved below a root directory:
+
+   fs::FS fs("/tmp/sdcard");
+   File file = fs.open("/eprobe/00000001.log", FILE_WRITE);
+
+ Only the members the probe uses are provided, with the semantics of the
+ ESP32 SD and SPIFFS implementations: "w" truncates, "a" appends, "r+"
+ updates an existing file, and opening a directory allows openNextFile().
+ The bytes written through the FS are counted, and closing a file can be
+ made to fsync it, which brings write latencies closer to a card.
+*/
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct FileImpl;
+
+class File {
+ public:
+  File() {}
+  explicit File(std::shared_ptr<FileImpl> impl) : m_impl(impl) {}
+
+  size_t write(uint8_t value);
+  size_t write(const uint8_t *buf, size_t len);
+  size_t read(uint8_t *buf, size_t len);
+  int read();
+  int available();
+  void flush();
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  void close();
+  operator bool() const;
+  const char *name() const;
+  bool isDirectory() const;
+  File openNextFile(const char *mode = FILE_READ);
+  void rewindDirectory();
+
+ private:
+  std::shared_ptr<FileImpl> m_impl;
+};
+
+class FS {
+ public:
+  explicit FS(const char *root)
+      : m_root(root), m_bytesWritten(0), m_syncOnClose(false) {}
+
+  File open(const char *path, const char *mode = FILE_READ);
+  bool exists(const char *path);
+  bool remove(const char *path);
+  bool rename(const char *from, const char *to);
+  bool mkdir(const char *path);
+  bool rmdir(const char *path);
+
+  uint64_t bytesWritten() const { return m_bytesWritten; }
+  void setSyncOnClose(bool sync) { m_syncOnClose = sync; }
+
+ private:
+  friend class File;
+  friend struct FileImpl;
+  std::string hostPath(const char *path) const;
+
+  std::string m_root;
+  uint64_t m_bytesWritten;
+  bool m_syncOnClose;
+};
+
+}  // namespace fs
+
+using fs::File;
+
+#endif
@@ -0,0 +1,52 @@
+#include "HardwareSerial.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <thread>
+
+HardwareSerial Serial;
+
+void HardwareSerial::updateBaudRate(uint32_t baud) {
+  m_baud = baud;
+  m_paceStart = std::chrono::steady_clock::now();
+  m_pacedBytes = 0;
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t len) {
+  size_t written = 0;
+  while (written < len) {
+    ssize_t n = ::write(m_fd, buf + written, len - written);
+    if (n <= 0) {
+      break;
+    }
+    written += n;
+  }
+
+  if (m_throttled && m_baud > 0) {
+    m_pacedBytes += written;
+    std::this_thread::sleep_until(
+        m_paceStart +
+        std::chrono::microseconds(m_pacedBytes * 10 * 1000000 / m_baud));
+  }
+  return written;
+}
+
+size_t HardwareSerial::print(const char *text) {
+  return write((const uint8_t *)text, strlen(text));
+}
+
+size_t HardwareSerial::println(const char *text) {
+  return print(text) + print("\r\n");
+}
+
+int HardwareSerial::available() {
+  struct pollfd pfd = {m_fd, POLLIN, 0};
+  return poll(&pfd, 1, 0) > 0 ? 1 : 0;
+}
+
+int HardwareSerial::read() {
+  uint8_t value;
+  return ::read(m_fd, &value, 1) == 1 ? value : -1;
+}
@@ -0,0 +1,53 @@
+/*
+ Serial port stand-in for host builds, writing to and reading from a file
+ descriptor, e.g. the master side of a pty:
+
+   Serial.attach(master);
+   Serial.setThrottled(true);
+
+ With throttling on, write() sleeps so that the bytes leave at the current
+ baud rate (10 bits per byte), which a pty does not do by itself. flush() has
+ no FIFO to wait for and returns at once.
+*/
+#ifndef HOST_HARDWARE_SERIAL_H
+#define HOST_HARDWARE_SERIAL_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+class HardwareSerial {
+ public:
+  HardwareSerial()
+      : m_fd(-1), m_baud(115200), m_throttled(false), m_debugOutput(true),
+        m_pacedBytes(0) {}
+
+  void attach(int fd) { m_fd = fd; }
+  void setThrottled(bool throttled) { m_throttled = throttled; }
+
+  void begin(uint32_t baud) { updateBaudRate(baud); }
+  void updateBaudRate(uint32_t baud);
+  uint32_t baudRate() const { return m_baud; }
+  void setDebugOutput(bool enabled) { m_debugOutput = enabled; }
+  bool debugOutput() const { return m_debugOutput; }
+
+  size_t write(uint8_t value) { return write(&value, 1); }
+  size_t write(const uint8_t *buf, size_t len);
+  size_t print(const char *text);
+  size_t println(const char *text);
+  int available();
+  int read();
+  void flush() {}
+
+ private:
+  int m_fd;
+  uint32_t m_baud;
+  bool m_throttled;
+  bool m_debugOutput;
+  std::chrono::steady_clock::time_point m_paceStart;
+  uint64_t m_pacedBytes;
+};
+
+extern HardwareSerial Serial;
+
+#endif
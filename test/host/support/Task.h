@@ -0,0 +1,32 @@
+/*
+ Task class of lib/cpp_utils for host builds: start() runs run() on a
+ detached std::thread. Name, stack size, priority and core are ignored.
+*/
+#ifndef HOST_TASK_H
+#define HOST_TASK_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+class Task {
+ public:
+  Task(std::string taskName = "Task", uint32_t stackSize = 10000,
+       uint8_t priority = 5, int coreId = -1)
+      : m_taskName(taskName) {}
+  virtual ~Task() {}
+
+  void start(void *taskData = nullptr) {
+    std::thread(&Task::run, this, taskData).detach();
+  }
+  virtual void run(void *data) = 0;
+  void delay(int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+
+ private:
+  std::string m_taskName;
+};
+
+#endif
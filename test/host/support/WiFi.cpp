@@ -0,0 +1,125 @@
+#include "WiFi.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+int WiFiServer::s_hostPort = -1;
+std::atomic<uint16_t> WiFiServer::s_boundPort(0);
+
+WiFiClient::Socket::~Socket() {
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+WiFiClient::WiFiClient(int fd) : m_socket(std::make_shared<Socket>()) {
+  m_socket->fd = fd;
+}
+
+// Connected while the peer has not closed or unread data is left
+uint8_t WiFiClient::connected() {
+  if (!*this) {
+    return 0;
+  }
+  struct pollfd pfd = {m_socket->fd, POLLIN, 0};
+  if (poll(&pfd, 1, 0) <= 0) {
+    return 1;
+  }
+  char c;
+  return recv(m_socket->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) > 0 ? 1 : 0;
+}
+
+int WiFiClient::available() {
+  int count = 0;
+  if (!*this || ioctl(m_socket->fd, FIONREAD, &count) != 0) {
+    return 0;
+  }
+  return count;
+}
+
+int WiFiClient::read() {
+  uint8_t value;
+  if (!*this || recv(m_socket->fd, &value, 1, MSG_DONTWAIT) != 1) {
+    return -1;
+  }
+  return value;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t len) {
+  size_t written = 0;
+  while (*this && written < len) {
+    ssize_t n = send(m_socket->fd, buf + written, len - written, MSG_NOSIGNAL);
+    if (n <= 0) {
+      break;
+    }
+    written += n;
+  }
+  return written;
+}
+
+size_t WiFiClient::print(const char *text) {
+  return write((const uint8_t *)text, strlen(text));
+}
+
+size_t WiFiClient::printf(const char *format, ...) {
+  char text[512];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (len < 0) {
+    return 0;
+  }
+  return write((const uint8_t *)text,
+               (size_t)len < sizeof(text) ? len : sizeof(text) - 1);
+}
+
+void WiFiClient::setNoDelay(bool noDelay) {
+  int value = noDelay ? 1 : 0;
+  if (*this) {
+    setsockopt(m_socket->fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+  }
+}
+
+void WiFiClient::stop() {
+  if (*this) {
+    close(m_socket->fd);
+    m_socket->fd = -1;
+  }
+}
+
+void WiFiServer::begin() {
+  m_fd = socket(AF_INET, SOCK_STREAM, 0);
+  int reuse = 1;
+  setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(s_hostPort >= 0 ? s_hostPort : m_port);
+  socklen_t len = sizeof(addr);
+  if (bind(m_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(m_fd, 4) != 0 ||
+      getsockname(m_fd, (struct sockaddr *)&addr, &len) != 0) {
+    perror("WiFiServer");
+    return;
+  }
+  fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+  s_boundPort = ntohs(addr.sin_port);
+}
+
+WiFiClient WiFiServer::available() {
+  int fd = m_fd >= 0 ? accept(m_fd, nullptr, nullptr) : -1;
+  return fd >= 0 ? WiFiClient(fd) : WiFiClient();
+}
@@ -0,0 +1,63 @@
+/*
+ Socket backed WiFiServer and WiFiClient for host builds of the network
+ modules. The server listens on 127.0.0.1, and a test that should not need
+ the real port picks another one before begin():
+
+   WiFiServer::setHostPort(0);  // any free port
+   ...
+   uint16_t port = WiFiServer::hostPort();  // once begin() ran
+
+ Copies of a WiFiClient share the connection like on the ESP32, the last
+ one closes it unless stop() did before.
+*/
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class WiFiClient {
+ public:
+  WiFiClient() {}
+  explicit WiFiClient(int fd);
+
+  uint8_t connected();
+  int available();
+  int read();
+  size_t write(uint8_t value) { return write(&value, 1); }
+  size_t write(const uint8_t *buf, size_t len);
+  size_t print(const char *text);
+  size_t printf(const char *format, ...)
+      __attribute__((format(printf, 2, 3)));
+  void setNoDelay(bool noDelay);
+  void stop();
+  operator bool() const { return m_socket && m_socket->fd >= 0; }
+
+ private:
+  struct Socket {
+    int fd;
+    ~Socket();
+  };
+  std::shared_ptr<Socket> m_socket;
+};
+
+class WiFiServer {
+ public:
+  explicit WiFiServer(uint16_t port) : m_port(port), m_fd(-1) {}
+
+  void begin();
+  WiFiClient available();
+
+  static void setHostPort(uint16_t port) { s_hostPort = port; }
+  static uint16_t hostPort() { return s_boundPort; }
+
+ private:
+  uint16_t m_port;
+  int m_fd;
+  static int s_hostPort;  // -1 listens on the port given to the constructor
+  static std::atomic<uint16_t> s_boundPort;
+};
+
+#endif
@@ -0,0 +1,3 @@
+/*
+ Host builds have no credentials, see src/config.sample.h for the firmware.
+*/
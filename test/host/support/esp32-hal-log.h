@@ -0,0 +1,29 @@
+/*
+ ESP_LOGx for host builds, printed to stderr. Define HOST_LOG_QUIET to drop
+ everything below warnings.
+*/
+#ifndef HOST_ESP32_HAL_LOG_H
+#define HOST_ESP32_HAL_LOG_H
+
+#include <cstdio>
+
+#define HOST_LOG(level, tag, format, ...) \
+  fprintf(stderr, level " (%s) " format "\n", tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG("W", tag, format, ##__VA_ARGS__)
+#ifdef HOST_LOG_QUIET
+#define ESP_LOGI(tag, format, ...) \
+  do {                             \
+  } while (0)
+#else
+#define ESP_LOGI(tag, format, ...) HOST_LOG("I", tag, format, ##__VA_ARGS__)
+#endif
+#define ESP_LOGD(tag, format, ...) \
+  do {                             \
+  } while (0)
+#define ESP_LOGV(tag, format, ...) \
+  do {                             \
+  } while (0)
+
+#endif
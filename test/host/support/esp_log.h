@@ -0,0 +1,23 @@
+/*
+ The log output redirection of the IDF for host builds. ESP_LOGx of the
+ host builds prints to stderr directly (see esp32-hal-log.h), so the
+ function set here is only kept and handed back.
+*/
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#include <cstdarg>
+#include <cstdio>
+
+#include "esp32-hal-log.h"
+
+typedef int (*vprintf_like_t)(const char *, va_list);
+
+inline vprintf_like_t esp_log_set_vprintf(vprintf_like_t func) {
+  static vprintf_like_t current = vprintf;
+  vprintf_like_t previous = current;
+  current = func;
+  return previous;
+}
+
+#endif
@@ -0,0 +1,261 @@
+/*
+ Host replay of a datalog through the upload filter.
+
+ Build:
+   g++ -O2 -I../support -I../../../src -o upload_filter_replay \
+       upload_filter_replay.cpp ../support/Arduino.cpp ../support/FS.cpp \
+       ../../../src/upload_filter.cpp ../../../src/datalog.cpp \
+       ../../../src/crc32.cpp
+
+ Usage:
+   upload_filter_replay <directory> [<log dir>]
+
+ Replays the sample records of the datalog in <log dir> below <directory>
+ (e.g. a copy of the SD card or the segments received with
+ tools/export_receiver) through uploadfilter_add() with the configuration
+ of the firmware. Without <log dir> a synthetic week of 30 s samples (daily
+ cycles, sensor noise, steps, a gap and gas every tenth sample) is first
+ written to <directory>/sim with datalog_append() and replayed from there.
+
+ The series is rebuilt by linear interpolation between the uploaded points.
+ Every sample between the first and the last uploaded point of its feed must
+ lie within deadband + tolerance of it; the points sent, the points
+ suppressed and the worst error are printed per feed.
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include "Arduino.h"
+#include "FS.h"
+#include "datalog.h"
+#include "upload_filter.h"
+
+#define CHANNEL_COUNT 4
+#define MAX_SILENCE_S 900  // AIO_MAX_SILENCE_S
+#define SIM_DIR "/sim"
+#define SIM_INTERVAL_S 30
+#define SIM_SAMPLES (7 * 24 * 3600 / SIM_INTERVAL_S)
+// Slack for the float arithmetic of the filter
+#define ERROR_EPSILON 1e-4
+
+// As uploadFilterConfigs in sync_measure.cpp, in the units uploaded
+static const upload_filter_config_t configs[CHANNEL_COUNT] = {
+    {0.05f, 0.1f, MAX_SILENCE_S},     // temperature (*C)
+    {0.2f, 0.5f, MAX_SILENCE_S},      // humidity (%)
+    {5.0f, 10.0f, MAX_SILENCE_S},     // pressure (Pa)
+    {500.0f, 1000.0f, MAX_SILENCE_S}  // gas resistance (Ohm)
+};
+static const char *channelNames[CHANNEL_COUNT] = {"temperature", "humidity",
+                                                  "pressure", "gas"};
+
+typedef struct {
+  uint32_t time;
+  float values[CHANNEL_COUNT];
+} sample_t;
+
+static double noise(double sd) {
+  // Sum of uniforms, close enough to a normal distribution
+  double sum = 0;
+  for (int i = 0; i < 12; i++) {
+    sum += rand() / (double)RAND_MAX;
+  }
+  return (sum - 6.0) * sd;
+}
+
+// Writes a synthetic recording in the datalog line format of the firmware
+static bool simulate(fs::FS &fs) {
+  static datalog_t log;
+  if (!datalog_open(&log, fs, SIM_DIR)) {
+    return false;
+  }
+
+  srand(42);
+  time_t time = 1790000000;
+  double gas = 50000;
+  for (int i = 0; i < SIM_SAMPLES; i++) {
+    double day = 2 * M_PI * (time % 86400) / 86400.0;
+    double week = 2 * M_PI * (time % (7 * 86400)) / (7 * 86400.0);
+    double temperature = 21.0 + 1.5 * sin(day) + noise(0.02);
+    // The heating switches on and off
+    if ((i / 700) % 3 == 0) {
+      temperature += 1.2;
+    }
+    double humidity = 45.0 - 5.0 * sin(day) + noise(0.15);
+    double pressure = 101325 + 300 * sin(week) + noise(3.0);
+    // A front passing through
+    if (i % 5000 == 2500) {
+      pressure -= 150;
+    }
+    gas = std::max(5000.0, gas * (1 + noise(0.002)) + 20 * sin(day));
+
+    char timeText[64];
+    char line[DATALOG_MAX_PAYLOAD];
+    struct tm tm;
+    gmtime_r(&time, &tm);
+    strftime(timeText, sizeof(timeText), "%c", &tm);
+    // Gas is measured every MULTIRATE_GAS_INTERVAL_S (300 s)
+    char gasText[16] = "";
+    if (i % 10 == 0) {
+      snprintf(gasText, sizeof(gasText), "%.4f", gas / 1000.0);
+    }
+    int n = snprintf(line, sizeof(line), "'%s',%.2f,%.2f,%.2f,%s\n",
+                     timeText, temperature, humidity, pressure / 100.0,
+                     gasText);
+    if (!datalog_append(&log, DATALOG_RECORD_SAMPLE, line, n)) {
+      return false;
+    }
+    datalog_prepare(&log, DATALOG_PREPARE_CHUNK);
+
+    // An hour without samples, e.g. a flat battery
+    time += i == SIM_SAMPLES / 2 ? 3600 : SIM_INTERVAL_S;
+  }
+  return true;
+}
+
+// Parses a datalog sample line into the units of the feeds
+static bool parseLine(const char *line, sample_t *sample) {
+  struct tm tm;
+  memset(&tm, 0, sizeof(tm));
+  const char *end = strptime(line + 1, "%a %b %d %H:%M:%S %Y", &tm);
+  double temperature, humidity, pressure;
+  double gas = NAN;  // empty between gas measurements
+  if (line[0] != '\'' || end == nullptr ||
+      sscanf(end, "',%lf,%lf,%lf,%lf", &temperature, &humidity, &pressure,
+             &gas) < 3) {
+    return false;
+  }
+  sample->time = (uint32_t)timegm(&tm);
+  sample->values[0] = temperature;
+  sample->values[1] = humidity;
+  sample->values[2] = pressure * 100;
+  sample->values[3] = gas * 1000;
+  return true;
+}
+
+static bool collectSegment(uint32_t segment, void *context) {
+  ((std::vector<uint32_t> *)context)->push_back(segment);
+  return true;
+}
+
+static bool readSamples(fs::FS &fs, const char *dir,
+                        std::vector<sample_t> *samples) {
+  static datalog_t log;
+  if (!datalog_open(&log, fs, dir)) {
+    return false;
+  }
+  std::vector<uint32_t> segments;
+  datalog_forEachSegment(&log, collectSegment, &segments);
+  std::sort(segments.begin(), segments.end());
+
+  for (uint32_t segment : segments) {
+    char path[DATALOG_PATH_LEN];
+    datalog_segmentPath(&log, segment, path, sizeof(path));
+    File file = fs.open(path, FILE_READ);
+    datalog_segment_header_t header;
+    if (!file || !datalog_readSegmentHeader(file, &header)) {
+      continue;
+    }
+
+    // Follow the records like recovery does, the header may lag behind
+    uint32_t offset = DATALOG_SEGMENT_HEADER_LEN;
+    datalog_record_t record;
+    uint8_t payload[DATALOG_MAX_PAYLOAD + 1];
+    while (datalog_readRecord(file, offset, &record, payload)) {
+      offset += DATALOG_HEADER_LEN + record.length + DATALOG_CRC_LEN;
+      payload[record.length] = '\0';
+      sample_t sample;
+      if (record.type == DATALOG_RECORD_SAMPLE &&
+          parseLine((const char *)payload, &sample)) {
+        samples->push_back(sample);
+      }
+    }
+    file.close();
+  }
+  return true;
+}
+
+// Replays one feed, returns false if a sample is not reconstructed closely
+static bool replay(const std::vector<sample_t> &samples, int c) {
+  const upload_filter_config_t &config = configs[c];
+  upload_filter_t filter;
+  memset(&filter, 0, sizeof(filter));
+  std::vector<upload_point_t> uploaded;
+  for (const sample_t &sample : samples) {
+    upload_point_t point;
+    if (uploadfilter_add(&filter, config, sample.time, sample.values[c],
+                         &point)) {
+      uploaded.push_back(point);
+    }
+  }
+
+  double limit = config.deadband + config.tolerance;
+  double worst = 0;
+  uint32_t worstTime = 0;
+  size_t checked = 0;
+  size_t next = 0;
+  for (const sample_t &sample : samples) {
+    if (std::isnan(sample.values[c])) {
+      continue;
+    }
+    while (next < uploaded.size() && uploaded[next].time < sample.time) {
+      next++;
+    }
+    if (next == 0 || next == uploaded.size()) {
+      // Before the first or behind the last uploaded point
+      continue;
+    }
+    const upload_point_t &a = uploaded[next - 1];
+    const upload_point_t &b = uploaded[next];
+    double rebuilt = a.value + (double)(b.value - a.value) *
+                                   (sample.time - a.time) / (b.time - a.time);
+    double error = fabs(sample.values[c] - rebuilt);
+    if (error > worst) {
+      worst = error;
+      worstTime = sample.time;
+    }
+    checked++;
+  }
+
+  bool ok = worst <= limit * (1 + ERROR_EPSILON);
+  printf("%-12s sent %6u, suppressed %6u (%5.1f%%), checked %6zu, "
+         "worst error %8.3f of %8.3f at %u %s\n",
+         channelNames[c], (unsigned)filter.sent, (unsigned)filter.suppressed,
+         100.0 * filter.suppressed / (filter.sent + filter.suppressed),
+         checked, worst, limit,
+         (unsigned)worstTime, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <directory> [<log dir>]\n", argv[0]);
+    return 2;
+  }
+  fs::FS fs(argv[1]);
+  const char *dir = argc > 2 ? argv[2] : SIM_DIR;
+  if (argc <= 2 && !simulate(fs)) {
+    fprintf(stderr, "Failed to write the synthetic datalog\n");
+    return 1;
+  }
+
+  std::vector<sample_t> samples;
+  if (!readSamples(fs, dir, &samples) || samples.empty()) {
+    fprintf(stderr, "No samples in %s%s\n", argv[1], dir);
+    return 1;
+  }
+  printf("Replaying %zu samples from %s%s\n", samples.size(), argv[1], dir);
+
+  int failures = 0;
+  for (int c = 0; c < CHANNEL_COUNT; c++) {
+    if (!replay(samples, c)) {
+      failures++;
+    }
+  }
+  printf("%d failures\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+/*
+ Host side decoder for the batch payloads of the probe.
+
+ Build:
+   g++ -O2 -I../../src -o batch_decoder batch_decoder.cpp
+
+ Usage:
+   batch_decoder < payloads.txt > samples.csv
+
+ Reads one base64 payload per line, e.g. the values of the batch feed
+ exported from Adafruit IO, and writes the rows as CSV, an aggregate with
+ the time of its first sample, its span in seconds and the number of
+ samples merged into it. The payload format is described in upload_batch.h.
+ A summary with the bytes per sample goes to stderr.
+*/
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "upload_batch.h"
+
+#define LINE_LEN 4096
+
+typedef struct {
+  const uint8_t *p;
+  const uint8_t *end;
+} cbor_reader_t;
+
+static int base64Value(char c) {
+  const char *alphabet =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  const char *p = c != '\0' ? strchr(alphabet, c) : nullptr;
+  return p != nullptr ? p - alphabet : -1;
+}
+
+// Decodes base64 up to the first character outside the alphabet, e.g. the
+// padding or the end of the line
+static size_t base64Decode(const char *in, uint8_t *out, size_t len) {
+  uint32_t bits = 0;
+  int count = 0;
+  size_t length = 0;
+  for (; base64Value(*in) >= 0; in++) {
+    bits = (bits << 6) | base64Value(*in);
+    count += 6;
+    if (count >= 8) {
+      count -= 8;
+      if (length == len) {
+        return 0;
+      }
+      out[length++] = bits >> count;
+    }
+  }
+  return length;
+}
+
+// Reads a head and returns its major type, false at the end or for a
+// length encoding the probe does not write
+static bool readHead(cbor_reader_t *r, uint8_t *major, uint32_t *value) {
+  if (r->p >= r->end) {
+    return false;
+  }
+  uint8_t initial = *r->p++;
+  *major = initial & 0xe0;
+  uint8_t info = initial & 0x1f;
+  if (info < 24) {
+    *value = info;
+    return true;
+  }
+  size_t n = info == 24 ? 1 : info == 25 ? 2 : info == 26 ? 4 : 0;
+  if (n == 0 || r->p + n > r->end) {
+    return false;
+  }
+  *value = 0;
+  for (size_t i = 0; i < n; i++) {
+    *value = (*value << 8) | *r->p++;
+  }
+  return true;
+}
+
+// Reads an integer, NaN for null
+static bool readNumber(cbor_reader_t *r, double *number) {
+  if (r->p < r->end && *r->p == 0xf6) {
+    r->p++;
+    *number = NAN;
+    return true;
+  }
+  uint8_t major;
+  uint32_t value;
+  if (!readHead(r, &major, &value)) {
+    return false;
+  }
+  if (major == 0x00) {
+    *number = value;
+  } else if (major == 0x20) {
+    *number = -1.0 - value;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static const double channelScales[UPLOAD_BATCH_CHANNELS] = {
+    UPLOAD_BATCH_TEMPERATURE_SCALE, UPLOAD_BATCH_HUMIDITY_SCALE,
+    UPLOAD_BATCH_PRESSURE_SCALE, UPLOAD_BATCH_GAS_SCALE,
+    UPLOAD_BATCH_IAQ_SCALE};
+static const int channelDecimals[UPLOAD_BATCH_CHANNELS] = {2, 2, 0, 0, 0};
+
+static void printValue(double value, int c) {
+  if (std::isnan(value)) {
+    printf(",");
+  } else {
+    printf(",%.*f", channelDecimals[c], value / channelScales[c]);
+  }
+}
+
+// Prints the rows of a payload and returns the samples they stand for, -1
+// if it is malformed
+static long decodeBatch(const uint8_t *data, size_t len) {
+  cbor_reader_t r = {data, data + len};
+  uint8_t major;
+  uint32_t value;
+  double version, firstTime;
+  uint32_t rows;
+  if (!readHead(&r, &major, &value) || major != 0x80 || value != 3 ||
+      !readNumber(&r, &version) || version != UPLOAD_BATCH_VERSION ||
+      !readNumber(&r, &firstTime) || !readHead(&r, &major, &rows) ||
+      major != 0x80) {
+    return -1;
+  }
+
+  long samples = 0;
+  double time = firstTime;
+  for (uint32_t i = 0; i < rows; i++) {
+    double fields[UPLOAD_BATCH_AGGREGATE_FIELDS];
+    if (!readHead(&r, &major, &value) || major != 0x80 ||
+        (value != UPLOAD_BATCH_SAMPLE_FIELDS &&
+         value != UPLOAD_BATCH_AGGREGATE_FIELDS)) {
+      return -1;
+    }
+    bool aggregate = value == UPLOAD_BATCH_AGGREGATE_FIELDS;
+    for (uint32_t f = 0; f < value; f++) {
+      if (!readNumber(&r, &fields[f])) {
+        return -1;
+      }
+    }
+    time += fields[0];
+
+    char date[32];
+    time_t t = (time_t)time;
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+    double span = aggregate ? fields[1] : 0;
+    double count = aggregate ? fields[2] : 1;
+    printf("%s,%.0f,%.0f", date, span, count);
+    // Means first, then min and max
+    const double *values = aggregate ? fields + 3 : fields + 1;
+    int stride = aggregate ? 3 : 1;
+    for (int c = 0; c < UPLOAD_BATCH_CHANNELS; c++) {
+      printValue(values[c * stride + (aggregate ? 2 : 0)], c);
+    }
+    for (int c = 0; c < UPLOAD_BATCH_CHANNELS; c++) {
+      printValue(values[c * stride], c);
+      printValue(values[c * stride + (aggregate ? 1 : 0)], c);
+    }
+    printf("\n");
+    samples += count;
+  }
+  return samples;
+}
+
+int main() {
+  static char line[LINE_LEN];
+  static uint8_t data[LINE_LEN];
+  unsigned long payloads = 0, samples = 0, bytes = 0, textBytes = 0;
+
+  printf(
+      "time,span,samples,temperature,humidity,pressure,airquality,iaq,"
+      "temperature_min,temperature_max,humidity_min,humidity_max,"
+      "pressure_min,pressure_max,airquality_min,airquality_max,iaq_min,"
+      "iaq_max\n");
+  while (fgets(line, sizeof(line), stdin) != nullptr) {
+    const char *text = line;
+    while (*text == ' ' || *text == '"') {
+      text++;
+    }
+    if (base64Value(*text) < 0) {
+      continue;
+    }
+    size_t len = base64Decode(text, data, sizeof(data));
+    long count = decodeBatch(data, len);
+    if (count < 0) {
+      fprintf(stderr, "Malformed payload: %s", line);
+      continue;
+    }
+    payloads++;
+    samples += count;
+    bytes += len;
+    textBytes += (len + 2) / 3 * 4;
+  }
+
+  if (samples > 0) {
+    fprintf(stderr,
+            "%lu samples in %lu payloads: %.1f bytes per sample, %.1f as "
+            "base64\n",
+            samples, payloads, (double)bytes / samples,
+            (double)textBytes / samples);
+  }
+  return 0;
+}
@@ -0,0 +1,290 @@
+/*
+ Host side receiver for the framed serial export of the probe.
+
+ Build (Linux, needs zlib):
+   g++ -O2 -I../../src -o export_receiver export_receiver.cpp \
+       ../../src/crc32.cpp -lz
+
+ Usage:
+   export_receiver <tty> <remote path> <local file> [-z]
+
+ Requests <remote path> with the "export" console command and appends it to
+ <local file>. An existing local file is resumed at its current size, and a
+ transfer that breaks off (bad CRC, lost bytes, timeout) is requested again
+ from the last complete frame.
+*/
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <termios.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "crc32.h"
+#include "serial_export_protocol.h"
+
+#define CONSOLE_BAUD 115200
+#define READ_TIMEOUT_MS 3000
+#define MAX_RETRIES 5
+
+static int tty = -1;
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static speed_t baudConstant(uint32_t baud) {
+  switch (baud) {
+    case 115200:
+      return B115200;
+    case 230400:
+      return B230400;
+    case 460800:
+      return B460800;
+    case 921600:
+      return B921600;
+    case 1500000:
+      return B1500000;
+    case 2000000:
+      return B2000000;
+  }
+  return B0;
+}
+
+static bool setBaud(uint32_t baud) {
+  struct termios tio;
+  if (tcgetattr(tty, &tio) != 0) {
+    return false;
+  }
+  cfmakeraw(&tio);
+  speed_t speed = baudConstant(baud);
+  if (speed == B0) {
+    fprintf(stderr, "Unsupported baud rate %u\n", baud);
+    return false;
+  }
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+  return tcsetattr(tty, TCSANOW, &tio) == 0;
+}
+
+// Reads exactly len bytes, false on timeout or error
+static bool readFully(uint8_t *buf, size_t len) {
+  while (len > 0) {
+    struct pollfd pfd = {tty, POLLIN, 0};
+    if (poll(&pfd, 1, READ_TIMEOUT_MS) <= 0) {
+      return false;
+    }
+    ssize_t n = read(tty, buf, len);
+    if (n <= 0) {
+      return false;
+    }
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+typedef struct {
+  uint8_t type;
+  uint8_t flags;
+  uint32_t offset;
+  uint16_t rawLength;
+  uint16_t length;
+  uint8_t payload[SERIAL_EXPORT_CHUNK];
+} frame_t;
+
+/*
+ Skips everything up to the next frame magic, e.g. console output, and reads
+ the frame behind it. Returns false on timeout or a CRC mismatch.
+*/
+static bool readFrame(frame_t *frame) {
+  uint8_t header[SERIAL_EXPORT_HEADER_LEN];
+  uint8_t previous = 0;
+
+  while (true) {
+    if (!readFully(header + 1, 1)) {
+      return false;
+    }
+    if (previous == SERIAL_EXPORT_MAGIC0 &&
+        header[1] == SERIAL_EXPORT_MAGIC1) {
+      break;
+    }
+    previous = header[1];
+  }
+  header[0] = SERIAL_EXPORT_MAGIC0;
+  if (!readFully(header + 2, SERIAL_EXPORT_HEADER_LEN - 2)) {
+    return false;
+  }
+
+  frame->type = header[2];
+  frame->flags = header[3];
+  memcpy(&frame->offset, header + 4, sizeof(frame->offset));
+  memcpy(&frame->rawLength, header + 8, sizeof(frame->rawLength));
+  memcpy(&frame->length, header + 10, sizeof(frame->length));
+  if (frame->length > SERIAL_EXPORT_CHUNK) {
+    fprintf(stderr, "Frame too long (%u bytes)\n", frame->length);
+    return false;
+  }
+
+  uint32_t storedCrc;
+  if (!readFully(frame->payload, frame->length) ||
+      !readFully((uint8_t *)&storedCrc, sizeof(storedCrc))) {
+    return false;
+  }
+  uint32_t crc = crc32_update(0, header + 2, SERIAL_EXPORT_HEADER_LEN - 2);
+  crc = crc32_update(crc, frame->payload, frame->length);
+  if (crc != storedCrc) {
+    fprintf(stderr, "CRC mismatch in frame at offset %u\n", frame->offset);
+    return false;
+  }
+  return true;
+}
+
+static bool inflateRaw(const frame_t &frame, uint8_t *out) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit2(&stream, -15) != Z_OK) {
+    return false;
+  }
+  stream.next_in = (Bytef *)frame.payload;
+  stream.avail_in = frame.length;
+  stream.next_out = out;
+  stream.avail_out = frame.rawLength;
+  int result = inflate(&stream, Z_FINISH);
+  bool success = result == Z_STREAM_END && stream.total_out == frame.rawLength;
+  inflateEnd(&stream);
+  return success;
+}
+
+// Discards input until the line stayed silent for a while, e.g. the rest of
+// an aborted transfer
+static void waitForQuiet() {
+  uint8_t buf[256];
+  struct pollfd pfd = {tty, POLLIN, 0};
+  while (poll(&pfd, 1, 500) > 0 && read(tty, buf, sizeof(buf)) > 0) {
+  }
+}
+
+typedef enum { TRANSFER_DONE, TRANSFER_FAILED, TRANSFER_RETRY } transfer_t;
+
+static transfer_t transfer(const char *remotePath, FILE *out, uint32_t *offset,
+                           bool compress, uint64_t *wireBytes) {
+  tcflush(tty, TCIOFLUSH);
+  setBaud(CONSOLE_BAUD);
+
+  char command[128];
+  snprintf(command, sizeof(command), "export %s %u%s\n", remotePath, *offset,
+           compress ? " z" : "");
+  if (write(tty, command, strlen(command)) < 0) {
+    return TRANSFER_FAILED;
+  }
+
+  static frame_t frame;
+  static uint8_t raw[SERIAL_EXPORT_CHUNK];
+  while (readFrame(&frame)) {
+    *wireBytes += SERIAL_EXPORT_HEADER_LEN + frame.length +
+                  SERIAL_EXPORT_CRC_LEN;
+
+    switch (frame.type) {
+      case SERIAL_EXPORT_FRAME_START: {
+        uint32_t start[2];
+        memcpy(start, frame.payload, sizeof(start));
+        printf("Receiving %s: %u of %u bytes at %u baud\n", remotePath,
+               start[0] - *offset, start[0], start[1]);
+        tcdrain(tty);
+        if (!setBaud(start[1])) {
+          return TRANSFER_FAILED;
+        }
+        break;
+      }
+
+      case SERIAL_EXPORT_FRAME_DATA: {
+        if (frame.offset != *offset) {
+          fprintf(stderr, "Expected offset %u, got %u\n", *offset,
+                  frame.offset);
+          return TRANSFER_RETRY;
+        }
+        const uint8_t *data = frame.payload;
+        if (frame.flags & SERIAL_EXPORT_FLAG_DEFLATE) {
+          if (!inflateRaw(frame, raw)) {
+            fprintf(stderr, "Corrupt deflate stream at offset %u\n",
+                    frame.offset);
+            return TRANSFER_RETRY;
+          }
+          data = raw;
+        }
+        fwrite(data, 1, frame.rawLength, out);
+        *offset += frame.rawLength;
+        break;
+      }
+
+      case SERIAL_EXPORT_FRAME_END:
+        fflush(out);
+        return TRANSFER_DONE;
+
+      case SERIAL_EXPORT_FRAME_ERROR:
+        fprintf(stderr, "Device error: %.*s\n", frame.length, frame.payload);
+        return TRANSFER_FAILED;
+    }
+  }
+  fflush(out);
+  return TRANSFER_RETRY;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 4) {
+    fprintf(stderr, "Usage: %s <tty> <remote path> <local file> [-z]\n",
+            argv[0]);
+    return 2;
+  }
+  bool compress = argc > 4 && strcmp(argv[4], "-z") == 0;
+
+  tty = open(argv[1], O_RDWR | O_NOCTTY);
+  if (tty < 0 || !setBaud(CONSOLE_BAUD)) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  FILE *out = fopen(argv[3], "ab");
+  if (out == nullptr) {
+    perror(argv[3]);
+    return 1;
+  }
+  fseek(out, 0, SEEK_END);
+  uint32_t offset = ftell(out);
+  uint32_t firstOffset = offset;
+  if (offset > 0) {
+    printf("Resuming %s at %u\n", argv[3], offset);
+  }
+
+  uint64_t wireBytes = 0;
+  double start = now();
+  transfer_t result = TRANSFER_RETRY;
+  for (int attempt = 0; attempt <= MAX_RETRIES && result == TRANSFER_RETRY;
+       attempt++) {
+    if (attempt > 0) {
+      fprintf(stderr, "Retrying at offset %u\n", offset);
+      waitForQuiet();
+    }
+    result = transfer(argv[2], out, &offset, compress, &wireBytes);
+  }
+  double elapsed = now() - start;
+  fclose(out);
+  setBaud(CONSOLE_BAUD);
+  close(tty);
+
+  if (result != TRANSFER_DONE) {
+    fprintf(stderr, "Transfer failed at offset %u\n", offset);
+    return 1;
+  }
+  uint32_t received = offset - firstOffset;
+  printf("Received %u bytes (%llu on the wire) in %.2f s: %.1f KiB/s\n",
+         received, (unsigned long long)wireBytes, elapsed,
+         elapsed > 0 ? received / 1024.0 / elapsed : 0.0);
+  return 0;
+}
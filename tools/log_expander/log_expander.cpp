@@ -0,0 +1,206 @@
+/*
+ Host side expander for the binary serial log of the probe.
+
+ Build:
+   g++ -O2 -I../../src -o log_expander log_expander.cpp \
+       ../../src/log_format.cpp ../../src/crc32.cpp
+
+ Usage:
+   log_expander <firmware.elf> [<tty> | <capture file>]
+
+ Reads the output of a firmware built without LOG_SINK_TEXT from the serial
+ port (at 115200 baud), a captured file or stdin, and writes it as text to
+ stdout. Frames (see log_sink_protocol.h) are expanded with the format
+ strings looked up in the ELF file of the same build; everything else,
+ e.g. ESP_LOGx output, is passed through unchanged. A frame with a bad CRC
+ or an unknown format address is passed through as is and counted.
+*/
+#include <elf.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "crc32.h"
+#include "log_format.h"
+#include "log_sink_protocol.h"
+
+#define CONSOLE_BAUD B115200
+#define LINE_LEN 512
+
+typedef struct {
+  uint64_t address;
+  uint64_t size;
+  uint64_t offset;
+} section_t;
+
+static std::vector<uint8_t> image;
+static std::vector<section_t> sections;
+
+template <typename Ehdr, typename Shdr>
+static bool loadSections() {
+  Ehdr header;
+  if (image.size() < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, image.data(), sizeof(header));
+  for (unsigned i = 0; i < header.e_shnum; i++) {
+    Shdr section;
+    uint64_t at = header.e_shoff + (uint64_t)i * header.e_shentsize;
+    if (at + sizeof(section) > image.size()) {
+      return false;
+    }
+    memcpy(&section, image.data() + at, sizeof(section));
+    // Only sections with contents in the file can hold format strings
+    if ((section.sh_flags & SHF_ALLOC) && section.sh_type == SHT_PROGBITS &&
+        section.sh_offset + section.sh_size <= image.size()) {
+      sections.push_back({section.sh_addr, section.sh_size,
+                          section.sh_offset});
+    }
+  }
+  return true;
+}
+
+static bool loadElf(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (f == nullptr) {
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  image.resize(ftell(f));
+  fseek(f, 0, SEEK_SET);
+  bool success = fread(image.data(), 1, image.size(), f) == image.size();
+  fclose(f);
+
+  if (!success || image.size() < EI_NIDENT ||
+      memcmp(image.data(), ELFMAG, SELFMAG) != 0) {
+    return false;
+  }
+  if (image[EI_CLASS] == ELFCLASS32) {
+    return loadSections<Elf32_Ehdr, Elf32_Shdr>();
+  }
+  return loadSections<Elf64_Ehdr, Elf64_Shdr>();
+}
+
+// Returns the NUL terminated string at address, nullptr if there is none
+static const char *lookupFormat(uint32_t address) {
+  for (const section_t &s : sections) {
+    if (address >= s.address && address < s.address + s.size) {
+      const char *text = (const char *)image.data() + s.offset +
+                         (address - s.address);
+      size_t room = s.address + s.size - address;
+      return memchr(text, '\0', room) != nullptr ? text : nullptr;
+    }
+  }
+  return nullptr;
+}
+
+static FILE *openInput(const char *path) {
+  if (path == nullptr || strcmp(path, "-") == 0) {
+    return stdin;
+  }
+  int fd = open(path, O_RDONLY | O_NOCTTY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct termios tio;
+  if (isatty(fd) && tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, CONSOLE_BAUD);
+    cfsetospeed(&tio, CONSOLE_BAUD);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  return fdopen(fd, "rb");
+}
+
+/*
+ Reads the rest of a frame behind its magic into frame. Returns the number
+ of bytes read, which is short at the end of the input.
+*/
+static size_t readFrame(FILE *in, uint8_t *frame) {
+  size_t len = 2;
+  len += fread(frame + len, 1, LOG_SINK_HEADER_LEN - len, in);
+  if (len < LOG_SINK_HEADER_LEN) {
+    return len;
+  }
+  size_t rest = frame[3] + LOG_SINK_CRC_LEN;
+  return len + fread(frame + len, 1, rest, in);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <firmware.elf> [<tty> | <capture file>]\n",
+            argv[0]);
+    return 2;
+  }
+  if (!loadElf(argv[1])) {
+    fprintf(stderr, "%s: not a readable ELF file\n", argv[1]);
+    return 1;
+  }
+  FILE *in = openInput(argc > 2 ? argv[2] : nullptr);
+  if (in == nullptr) {
+    perror(argv[2]);
+    return 1;
+  }
+
+  uint8_t frame[LOG_SINK_HEADER_LEN + 255 + LOG_SINK_CRC_LEN];
+  char line[LINE_LEN];
+  unsigned expanded = 0, corrupt = 0, unknown = 0;
+  int c;
+  int previous = EOF;
+  while ((c = getc(in)) != EOF) {
+    if (previous != LOG_SINK_MAGIC0 || c != LOG_SINK_MAGIC1) {
+      if (previous != EOF) {
+        putchar(previous);
+      }
+      previous = c;
+      if (c == '\n') {
+        putchar(c);
+        fflush(stdout);
+        previous = EOF;
+      }
+      continue;
+    }
+    previous = EOF;
+
+    frame[0] = LOG_SINK_MAGIC0;
+    frame[1] = LOG_SINK_MAGIC1;
+    size_t len = readFrame(in, frame);
+    size_t length = LOG_SINK_HEADER_LEN + frame[3];
+    uint32_t storedCrc = 0;
+    if (len == length + LOG_SINK_CRC_LEN) {
+      memcpy(&storedCrc, frame + length, sizeof(storedCrc));
+    }
+    if (len != length + LOG_SINK_CRC_LEN ||
+        crc32_update(0, frame + 2, length - 2) != storedCrc) {
+      corrupt++;
+      fwrite(frame, 1, len, stdout);
+      continue;
+    }
+
+    uint32_t address;
+    memcpy(&address, frame + 4, sizeof(address));
+    const char *format = lookupFormat(address);
+    if (format == nullptr) {
+      unknown++;
+      printf("[unknown format 0x%08x]\n", address);
+      continue;
+    }
+    size_t n = logformat_expand(format, frame + LOG_SINK_HEADER_LEN, frame[3],
+                                frame[2] & LOG_SINK_FLAG_TRUNCATED, line,
+                                sizeof(line));
+    fwrite(line, 1, n, stdout);
+    fflush(stdout);
+    expanded++;
+  }
+  if (previous != EOF) {
+    putchar(previous);
+  }
+
+  fprintf(stderr, "%u records expanded, %u corrupt, %u unknown formats\n",
+          expanded, corrupt, unknown);
+  return corrupt + unknown > 0 ? 1 : 0;
+}